@@ -18,6 +18,320 @@
 // VTK includes
 #include <vtkByteSwap.h>
 
+// STD includes
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <new>
+#include <sstream>
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace
+{
+/// Number of values decoded per fread, or encoded per write, when a staging
+/// buffer is needed.
+const size_t FS_IO_CHUNK_SIZE = 4096;
+
+/// Size of the zlib input and output buffers for compressed files, and of
+/// the stdio buffer of plain output files.
+const unsigned int FS_IO_GZ_BUFFER_SIZE = 256 * 1024;
+
+/// Largest single gzread or gzwrite call.
+const size_t FS_IO_GZ_MAX_READ = 1u << 30;
+
+/// Largest ratio between inflated and deflated sizes, about 1032:1 for
+/// deflate streams.
+const size_t FS_IO_GZ_MAX_RATIO = 1032;
+
+/// Name offset of color table entries that are not in use.
+const size_t FS_COLOR_TABLE_UNUSED_ENTRY = static_cast<size_t>(-1);
+
+/// Largest color table, far above the 14176 entries of FreeSurferColorLUT.
+/// Sparse tables can announce many more entries than they fill, so their
+/// size can't be checked against the file.
+const int FS_COLOR_TABLE_MAX_ENTRIES = 1 << 20;
+
+//------------------------------------------------------------------------------
+bool IsBigEndianHost()
+{
+  const unsigned int one = 1;
+  return *reinterpret_cast<const unsigned char*>(&one) == 0;
+}
+
+//------------------------------------------------------------------------------
+// Swap every 4 byte word of the buffer. The loop only uses shifts and masks on
+// a local copy of each word so that the compiler can turn it into vector byte
+// shuffles.
+void SwapWordsInPlace(void* ioBuffer, size_t count)
+{
+  unsigned char* bytes = static_cast<unsigned char*>(ioBuffer);
+  for (size_t i = 0; i < count; ++i)
+    {
+    unsigned int w;
+    memcpy(&w, bytes + 4*i, 4);
+    w = (w >> 24) | ((w >> 8) & 0x0000ff00u) | ((w << 8) & 0x00ff0000u) | (w << 24);
+    memcpy(bytes + 4*i, &w, 4);
+    }
+}
+
+//------------------------------------------------------------------------------
+void SwapHalfWordsInPlace(void* ioBuffer, size_t count)
+{
+  unsigned char* bytes = static_cast<unsigned char*>(ioBuffer);
+  for (size_t i = 0; i < count; ++i)
+    {
+    unsigned short h;
+    memcpy(&h, bytes + 2*i, 2);
+    h = static_cast<unsigned short>((h >> 8) | (h << 8));
+    memcpy(bytes + 2*i, &h, 2);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Read count records of recordSize bytes through a staging buffer, for the
+// formats whose on-disk size differs from their in-memory size. read(buffer,
+// n) reads n records and returns the number of complete records read,
+// decode(buffer, first, n) converts them into the output.
+template <size_t recordSize, class TRead, class TDecode>
+size_t ReadStagedRecords(size_t count, TRead read, TDecode decode)
+{
+  unsigned char buffer[recordSize * FS_IO_CHUNK_SIZE];
+  size_t result = 0;
+  while (result < count)
+    {
+    size_t chunk = count - result < FS_IO_CHUNK_SIZE ? count - result : FS_IO_CHUNK_SIZE;
+    size_t numRead = read (buffer, chunk);
+    decode (buffer, result, numRead);
+    result += numRead;
+    if (numRead != chunk)
+      {
+      break;
+      }
+    }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Write count records of recordSize bytes through a staging buffer, the
+// counterpart of ReadStagedRecords. encode(buffer, first, n) converts n
+// values into the buffer, write(buffer, n) writes n records and returns
+// whether they were all written.
+template <size_t recordSize, class TEncode, class TWrite>
+size_t WriteStagedRecords(size_t count, TEncode encode, TWrite write)
+{
+  unsigned char buffer[recordSize * FS_IO_CHUNK_SIZE];
+  size_t result = 0;
+  while (result < count)
+    {
+    size_t chunk = count - result < FS_IO_CHUNK_SIZE ? count - result : FS_IO_CHUNK_SIZE;
+    encode (buffer, result, chunk);
+    if (!write (buffer, chunk))
+      {
+      break;
+      }
+    result += chunk;
+    }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+bool IsSpaceOrTab(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+//------------------------------------------------------------------------------
+bool IsTokenEnd(const char* text, const char* end)
+{
+  return text == end || isspace(static_cast<unsigned char>(*text));
+}
+
+//------------------------------------------------------------------------------
+// Parse a decimal number, with optional fraction and exponent, the way
+// strtod does in the "C" locale. Numbers whose significant digits fit
+// exactly in a double are kept in an integer, which is then scaled by an
+// exactly representable power of ten. Anything else (long mantissas, large
+// exponents, nan, inf) goes through a classic locale stream.
+bool ParseReal(const char*& ioText, const char* end, double& oValue)
+{
+  static const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+    1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+    1e20, 1e21, 1e22 };
+
+  const char* p = ioText;
+  while (p < end && IsSpaceOrTab(*p))
+    {
+    ++p;
+    }
+  const char* start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    {
+    negative = *p == '-';
+    ++p;
+    }
+  const unsigned long long maxExactMantissa = 1ULL << 53;
+  unsigned long long mantissa = 0;
+  int exponent = 0;
+  bool hasDigits = false;
+  bool exact = true;
+  for (; p < end && isdigit(static_cast<unsigned char>(*p)); ++p)
+    {
+    hasDigits = true;
+    mantissa = mantissa * 10 + (*p - '0');
+    exact = exact && mantissa <= maxExactMantissa;
+    if (!exact)
+      {
+      mantissa = 0;
+      }
+    }
+  if (p < end && *p == '.')
+    {
+    for (++p; p < end && isdigit(static_cast<unsigned char>(*p)); ++p)
+      {
+      hasDigits = true;
+      mantissa = mantissa * 10 + (*p - '0');
+      --exponent;
+      exact = exact && mantissa <= maxExactMantissa;
+      if (!exact)
+        {
+        mantissa = 0;
+        }
+      }
+    }
+  if (hasDigits && p < end && (*p == 'e' || *p == 'E'))
+    {
+    const char* q = p + 1;
+    bool negativeExponent = false;
+    if (q < end && (*q == '-' || *q == '+'))
+      {
+      negativeExponent = *q == '-';
+      ++q;
+      }
+    if (q < end && isdigit(static_cast<unsigned char>(*q)))
+      {
+      int value = 0;
+      for (; q < end && isdigit(static_cast<unsigned char>(*q)); ++q)
+        {
+        value = value < 10000 ? value * 10 + (*q - '0') : value;
+        }
+      exponent += negativeExponent ? -value : value;
+      p = q;
+      }
+    }
+
+  if (hasDigits && exact && IsTokenEnd(p, end) && exponent >= -22 && exponent <= 22)
+    {
+    double value = static_cast<double>(mantissa);
+    value = exponent < 0 ? value / powersOfTen[-exponent] : value * powersOfTen[exponent];
+    oValue = negative ? -value : value;
+    ioText = p;
+    return true;
+    }
+
+  // Slow path.
+  const char* tokenEnd = start;
+  while (!IsTokenEnd(tokenEnd, end))
+    {
+    ++tokenEnd;
+    }
+  if (tokenEnd == start)
+    {
+    return false;
+    }
+  std::string token(start, tokenEnd);
+  std::string name = token.substr(token[0] == '-' || token[0] == '+' ? 1 : 0);
+  std::transform(name.begin(), name.end(), name.begin(),
+    [](unsigned char c) { return static_cast<char>(tolower(c)); });
+  double value = 0.0;
+  if (name == "nan" || name == "inf" || name == "infinity")
+    {
+    value = name == "nan" ? std::numeric_limits<double>::quiet_NaN() : std::numeric_limits<double>::infinity();
+    value = token[0] == '-' ? -value : value;
+    }
+  else
+    {
+    std::istringstream stream(token);
+    stream.imbue(std::locale::classic());
+    if (!(stream >> value) || stream.peek() != std::char_traits<char>::eof())
+      {
+      return false;
+      }
+    }
+  oValue = value;
+  ioText = tokenEnd;
+  return true;
+}
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::ParseInt (const char*& ioText, const char* end, int& oValue)
+{
+  const char* p = ioText;
+  while (p < end && IsSpaceOrTab(*p))
+    {
+    ++p;
+    }
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    {
+    negative = *p == '-';
+    ++p;
+    }
+  if (p == end || !isdigit(static_cast<unsigned char>(*p)))
+    {
+    return false;
+    }
+  long long value = 0;
+  for (; p < end && isdigit(static_cast<unsigned char>(*p)); ++p)
+    {
+    value = value * 10 + (*p - '0');
+    if (value > 2147483648LL)
+      {
+      return false;
+      }
+    }
+  value = negative ? -value : value;
+  if (!IsTokenEnd(p, end) || value > 2147483647LL)
+    {
+    return false;
+    }
+  oValue = static_cast<int>(value);
+  ioText = p;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::ParseFloat (const char*& ioText, const char* end, float& oValue)
+{
+  double value = 0.0;
+  if (!ParseReal (ioText, end, value))
+    {
+    return false;
+    }
+  oValue = static_cast<float>(value);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::ParseDouble (const char*& ioText, const char* end, double& oValue)
+{
+  return ParseReal (ioText, end, oValue);
+}
+
 //------------------------------------------------------------------------------
 int vtkFSIO::ReadShort (FILE* iFile, short& oShort) {
 
@@ -94,7 +408,7 @@ int vtkFSIO::ReadInt3Z (gzFile iFile, int& oInt) {
 
   // Read three bytes. Swap if we need to. Stuff into a full sized int
   // and return.
-  result = gzread (iFile, &i, 3*sizeof(int));
+  result = gzread (iFile, &i, 3);
   vtkByteSwap::Swap4BE (&i);
   oInt = ((i>>8) & 0xffffff);
 
@@ -104,13 +418,13 @@ int vtkFSIO::ReadInt3Z (gzFile iFile, int& oInt) {
 //------------------------------------------------------------------------------
 int vtkFSIO::ReadInt2 (FILE* iFile, int& oInt) {
 
-  int i = 0;
+  short s = 0;
   int result ;
 
   // Read two bytes. Swap if we need to. Return the value
-  result = fread (&i, 2, 1, iFile);
-  vtkByteSwap::Swap4BE (&i);
-  oInt = i;
+  result = fread (&s, 2, 1, iFile);
+  vtkByteSwap::Swap2BE (&s);
+  oInt = s;
 
   return result;
 }
@@ -118,13 +432,13 @@ int vtkFSIO::ReadInt2 (FILE* iFile, int& oInt) {
 //------------------------------------------------------------------------------
 int vtkFSIO::ReadInt2Z (gzFile iFile, int& oInt) {
 
-  int i = 0;
+  short s = 0;
   int result ;
 
   // Read two bytes. Swap if we need to. Return the value
-  result = gzread (iFile, &i, 2*sizeof(int));
-  vtkByteSwap::Swap4BE (&i);
-  oInt = i;
+  result = gzread (iFile, &s, 2);
+  vtkByteSwap::Swap2BE (&s);
+  oInt = s;
 
   return result;
 }
@@ -158,7 +472,314 @@ int vtkFSIO::ReadFloatZ (gzFile iFile, float& oFloat) {
 }
 
 //------------------------------------------------------------------------------
-// Utility methods for writing test files
+void vtkFSIO::DecodeShortArray (const void* iBuffer, short* oValues, size_t count)
+{
+  if (iBuffer != oValues)
+    {
+    memmove (oValues, iBuffer, count * sizeof(short));
+    }
+  if (!IsBigEndianHost())
+    {
+    SwapHalfWordsInPlace (oValues, count);
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::DecodeIntArray (const void* iBuffer, int* oValues, size_t count)
+{
+  if (iBuffer != oValues)
+    {
+    memmove (oValues, iBuffer, count * sizeof(int));
+    }
+  if (!IsBigEndianHost())
+    {
+    SwapWordsInPlace (oValues, count);
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::DecodeInt3Array (const void* iBuffer, int* oValues, size_t count)
+{
+  // Assembling the value from its bytes gives the same result on any host.
+  const unsigned char* bytes = static_cast<const unsigned char*>(iBuffer);
+  for (size_t i = 0; i < count; ++i)
+    {
+    const unsigned char* b = bytes + 3*i;
+    oValues[i] = (b[0] << 16) | (b[1] << 8) | b[2];
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::DecodeFloatArray (const void* iBuffer, float* oValues, size_t count)
+{
+  if (iBuffer != oValues)
+    {
+    memmove (oValues, iBuffer, count * sizeof(float));
+    }
+  if (!IsBigEndianHost())
+    {
+    SwapWordsInPlace (oValues, count);
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::DecodeInt3FloatPairs (const void* iBuffer, int* oIndices, float* oValues, size_t count)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(iBuffer);
+  for (size_t i = 0; i < count; ++i)
+    {
+    const unsigned char* b = bytes + 7*i;
+    oIndices[i] = (b[0] << 16) | (b[1] << 8) | b[2];
+    unsigned int w = (static_cast<unsigned int>(b[3]) << 24) | (b[4] << 16) | (b[5] << 8) | b[6];
+    memcpy (&oValues[i], &w, sizeof(float));
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::EncodeShortArray (const short* iValues, void* oBuffer, size_t count)
+{
+  if (iValues != oBuffer)
+    {
+    memmove (oBuffer, iValues, count * sizeof(short));
+    }
+  if (!IsBigEndianHost())
+    {
+    SwapHalfWordsInPlace (oBuffer, count);
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::EncodeIntArray (const int* iValues, void* oBuffer, size_t count)
+{
+  if (iValues != oBuffer)
+    {
+    memmove (oBuffer, iValues, count * sizeof(int));
+    }
+  if (!IsBigEndianHost())
+    {
+    SwapWordsInPlace (oBuffer, count);
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::EncodeInt3Array (const int* iValues, void* oBuffer, size_t count)
+{
+  unsigned char* bytes = static_cast<unsigned char*>(oBuffer);
+  for (size_t i = 0; i < count; ++i)
+    {
+    unsigned char* b = bytes + 3*i;
+    b[0] = static_cast<unsigned char>(iValues[i] >> 16);
+    b[1] = static_cast<unsigned char>(iValues[i] >> 8);
+    b[2] = static_cast<unsigned char>(iValues[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::EncodeFloatArray (const float* iValues, void* oBuffer, size_t count)
+{
+  if (iValues != oBuffer)
+    {
+    memmove (oBuffer, iValues, count * sizeof(float));
+    }
+  if (!IsBigEndianHost())
+    {
+    SwapWordsInPlace (oBuffer, count);
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::EncodeInt3FloatPairs (const int* iIndices, const float* iValues, void* oBuffer, size_t count)
+{
+  unsigned char* bytes = static_cast<unsigned char*>(oBuffer);
+  for (size_t i = 0; i < count; ++i)
+    {
+    unsigned char* b = bytes + 7*i;
+    unsigned int w;
+    memcpy (&w, &iValues[i], sizeof(float));
+    b[0] = static_cast<unsigned char>(iIndices[i] >> 16);
+    b[1] = static_cast<unsigned char>(iIndices[i] >> 8);
+    b[2] = static_cast<unsigned char>(iIndices[i]);
+    b[3] = static_cast<unsigned char>(w >> 24);
+    b[4] = static_cast<unsigned char>(w >> 16);
+    b[5] = static_cast<unsigned char>(w >> 8);
+    b[6] = static_cast<unsigned char>(w);
+    }
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadShortArray (FILE* iFile, short* oValues, size_t count)
+{
+  // Same size on disk and in memory, read straight into the output.
+  size_t result = fread (oValues, sizeof(short), count, iFile);
+  vtkFSIO::DecodeShortArray (oValues, oValues, result);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadIntArray (FILE* iFile, int* oValues, size_t count)
+{
+  size_t result = fread (oValues, sizeof(int), count, iFile);
+  vtkFSIO::DecodeIntArray (oValues, oValues, result);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadInt3Array (FILE* iFile, int* oValues, size_t count)
+{
+  // Three bytes on disk, so go through a staging buffer.
+  return ReadStagedRecords<3> (count,
+    [iFile](unsigned char* buffer, size_t n) { return fread (buffer, 3, n, iFile); },
+    [oValues](const unsigned char* buffer, size_t first, size_t n)
+      { vtkFSIO::DecodeInt3Array (buffer, oValues + first, n); });
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadFloatArray (FILE* iFile, float* oValues, size_t count)
+{
+  size_t result = fread (oValues, sizeof(float), count, iFile);
+  vtkFSIO::DecodeFloatArray (oValues, oValues, result);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadIntPairs (FILE* iFile, int* oPairs, size_t count)
+{
+  return vtkFSIO::ReadIntArray (iFile, oPairs, 2 * count) / 2;
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadInt3FloatPairs (FILE* iFile, int* oIndices, float* oValues, size_t count)
+{
+  return ReadStagedRecords<7> (count,
+    [iFile](unsigned char* buffer, size_t n) { return fread (buffer, 7, n, iFile); },
+    [oIndices, oValues](const unsigned char* buffer, size_t first, size_t n)
+      { vtkFSIO::DecodeInt3FloatPairs (buffer, oIndices + first, oValues + first, n); });
+}
+
+//------------------------------------------------------------------------------
+int vtkFSIO::ReadInt (InputStream& iStream, int& oInt)
+{
+  return static_cast<int>(vtkFSIO::ReadIntArray (iStream, &oInt, 1));
+}
+
+//------------------------------------------------------------------------------
+int vtkFSIO::ReadInt3 (InputStream& iStream, int& oInt)
+{
+  return static_cast<int>(vtkFSIO::ReadInt3Array (iStream, &oInt, 1));
+}
+
+//------------------------------------------------------------------------------
+int vtkFSIO::ReadInt2 (InputStream& iStream, int& oInt)
+{
+  short s = 0;
+  int result = static_cast<int>(vtkFSIO::ReadShortArray (iStream, &s, 1));
+  oInt = s;
+  return result;
+}
+
+//------------------------------------------------------------------------------
+int vtkFSIO::ReadFloat (InputStream& iStream, float& oFloat)
+{
+  return static_cast<int>(vtkFSIO::ReadFloatArray (iStream, &oFloat, 1));
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadShortArray (InputStream& iStream, short* oValues, size_t count)
+{
+  size_t result = iStream.Read (oValues, count * sizeof(short)) / sizeof(short);
+  vtkFSIO::DecodeShortArray (oValues, oValues, result);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadIntArray (InputStream& iStream, int* oValues, size_t count)
+{
+  size_t result = iStream.Read (oValues, count * sizeof(int)) / sizeof(int);
+  vtkFSIO::DecodeIntArray (oValues, oValues, result);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadInt3Array (InputStream& iStream, int* oValues, size_t count)
+{
+  return ReadStagedRecords<3> (count,
+    [&iStream](unsigned char* buffer, size_t n) { return iStream.Read (buffer, 3 * n) / 3; },
+    [oValues](const unsigned char* buffer, size_t first, size_t n)
+      { vtkFSIO::DecodeInt3Array (buffer, oValues + first, n); });
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadFloatArray (InputStream& iStream, float* oValues, size_t count)
+{
+  size_t result = iStream.Read (oValues, count * sizeof(float)) / sizeof(float);
+  vtkFSIO::DecodeFloatArray (oValues, oValues, result);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadIntPairs (InputStream& iStream, int* oPairs, size_t count)
+{
+  return vtkFSIO::ReadIntArray (iStream, oPairs, 2 * count) / 2;
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::ReadInt3FloatPairs (InputStream& iStream, int* oIndices, float* oValues, size_t count)
+{
+  return ReadStagedRecords<7> (count,
+    [&iStream](unsigned char* buffer, size_t n) { return iStream.Read (buffer, 7 * n) / 7; },
+    [oIndices, oValues](const unsigned char* buffer, size_t first, size_t n)
+      { vtkFSIO::DecodeInt3FloatPairs (buffer, oIndices + first, oValues + first, n); });
+}
+
+//------------------------------------------------------------------------------
+int vtkFSIO::WriteInt (OutputStream& oStream, int iInt)
+{
+  return static_cast<int>(vtkFSIO::WriteIntArray (oStream, &iInt, 1));
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::WriteShortArray (OutputStream& oStream, const short* iValues, size_t count)
+{
+  return WriteStagedRecords<2> (count,
+    [iValues](unsigned char* buffer, size_t first, size_t n) { vtkFSIO::EncodeShortArray (iValues + first, buffer, n); },
+    [&oStream](const unsigned char* buffer, size_t n) { return oStream.Write (buffer, 2 * n); });
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::WriteIntArray (OutputStream& oStream, const int* iValues, size_t count)
+{
+  return WriteStagedRecords<4> (count,
+    [iValues](unsigned char* buffer, size_t first, size_t n) { vtkFSIO::EncodeIntArray (iValues + first, buffer, n); },
+    [&oStream](const unsigned char* buffer, size_t n) { return oStream.Write (buffer, 4 * n); });
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::WriteInt3Array (OutputStream& oStream, const int* iValues, size_t count)
+{
+  return WriteStagedRecords<3> (count,
+    [iValues](unsigned char* buffer, size_t first, size_t n) { vtkFSIO::EncodeInt3Array (iValues + first, buffer, n); },
+    [&oStream](const unsigned char* buffer, size_t n) { return oStream.Write (buffer, 3 * n); });
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::WriteFloatArray (OutputStream& oStream, const float* iValues, size_t count)
+{
+  return WriteStagedRecords<4> (count,
+    [iValues](unsigned char* buffer, size_t first, size_t n) { vtkFSIO::EncodeFloatArray (iValues + first, buffer, n); },
+    [&oStream](const unsigned char* buffer, size_t n) { return oStream.Write (buffer, 4 * n); });
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::WriteInt3FloatPairs (OutputStream& oStream, const int* iIndices, const float* iValues, size_t count)
+{
+  return WriteStagedRecords<7> (count,
+    [iIndices, iValues](unsigned char* buffer, size_t first, size_t n)
+      { vtkFSIO::EncodeInt3FloatPairs (iIndices + first, iValues + first, buffer, n); },
+    [&oStream](const unsigned char* buffer, size_t n) { return oStream.Write (buffer, 7 * n); });
+}
+
+//------------------------------------------------------------------------------
+// Single value writers
 
 //------------------------------------------------------------------------------
 int vtkFSIO::WriteInt (FILE* iFile, int iInt)
@@ -176,14 +797,14 @@ int vtkFSIO::WriteInt (FILE* iFile, int iInt)
 //------------------------------------------------------------------------------
 int vtkFSIO::WriteInt3 (FILE* oFile, int iInt)
 {
-    // swap if we need to, then write three bytes
-    int i = iInt;
+    // keep the low three bytes, swap if we need to, then write the last
+    // three bytes of the big-endian int
+    int i = iInt & 0xffffff;
     int result;
 
-    i = ((i>>8) & 0xffffff);
     vtkByteSwap::Swap4BE(&i);
 
-    result = fwrite(&i, 3, 1, oFile);
+    result = fwrite(reinterpret_cast<unsigned char*>(&i) + 1, 3, 1, oFile);
     return result;
 }
 
@@ -191,13 +812,554 @@ int vtkFSIO::WriteInt3 (FILE* oFile, int iInt)
 int vtkFSIO::WriteInt2 (FILE* oFile, int iInt)
 {
 
-    int i;
+    short s;
     int result;
 
     // swap if we need to, write two bytes, return the result
-    i = iInt;
-    vtkByteSwap::Swap4BE(&i);
-    result = fread(&i, 2, 1, oFile);
+    s = static_cast<short>(iInt);
+    vtkByteSwap::Swap2BE(&s);
+    result = fwrite(&s, 2, 1, oFile);
 
     return result;
 }
+
+//------------------------------------------------------------------------------
+vtkFSIO::InputStream::InputStream()
+  : File(nullptr)
+  , GzFile(nullptr)
+  , FileSize(0)
+{
+}
+
+//------------------------------------------------------------------------------
+vtkFSIO::InputStream::~InputStream()
+{
+  this->Close();
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::InputStream::Open (const char* fileName)
+{
+  this->Close();
+  if (fileName == nullptr)
+    {
+    return false;
+    }
+
+  this->File = fopen (fileName, "rb");
+  if (this->File == nullptr)
+    {
+    return false;
+    }
+  // ftell fails past 2 GiB on some platforms, the size is then unknown.
+  long fileSize = -1;
+  if (fseek (this->File, 0, SEEK_END) == 0)
+    {
+    fileSize = ftell (this->File);
+    }
+  this->FileSize = fileSize >= 0 ? static_cast<size_t>(fileSize) : std::numeric_limits<size_t>::max();
+  rewind (this->File);
+
+  // Look for the gzip magic bytes. If they are there, reopen the file
+  // through zlib, otherwise rewind and read it directly.
+  unsigned char magic[2] = { 0, 0 };
+  size_t numRead = fread (magic, 1, 2, this->File);
+  if (numRead == 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    {
+    fclose (this->File);
+    this->File = nullptr;
+    this->GzFile = gzopen (fileName, "rb");
+    if (this->GzFile == nullptr)
+      {
+      return false;
+      }
+    gzbuffer (this->GzFile, FS_IO_GZ_BUFFER_SIZE);
+    return true;
+    }
+  rewind (this->File);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::InputStream::Close ()
+{
+  if (this->File != nullptr)
+    {
+    fclose (this->File);
+    this->File = nullptr;
+    }
+  if (this->GzFile != nullptr)
+    {
+    gzclose (this->GzFile);
+    this->GzFile = nullptr;
+    }
+  this->FileSize = 0;
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::InputStream::Read (void* oBuffer, size_t size)
+{
+  if (this->File != nullptr)
+    {
+    return fread (oBuffer, 1, size, this->File);
+    }
+  if (this->GzFile == nullptr)
+    {
+    return 0;
+    }
+
+  // gzread takes an unsigned int length, so split very large blocks.
+  unsigned char* buffer = static_cast<unsigned char*>(oBuffer);
+  size_t result = 0;
+  while (result < size)
+    {
+    size_t chunk = size - result < FS_IO_GZ_MAX_READ ? size - result : FS_IO_GZ_MAX_READ;
+    int numRead = gzread (this->GzFile, buffer + result, static_cast<unsigned int>(chunk));
+    if (numRead <= 0)
+      {
+      break;
+      }
+    result += static_cast<size_t>(numRead);
+    if (static_cast<size_t>(numRead) != chunk)
+      {
+      break;
+      }
+    }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+size_t vtkFSIO::InputStream::GetMaximumRemainingSize ()
+{
+  const size_t unknown = std::numeric_limits<size_t>::max();
+  if (this->FileSize == unknown)
+    {
+    return unknown;
+    }
+  if (this->File != nullptr)
+    {
+    long position = ftell (this->File);
+    return position >= 0 && static_cast<size_t>(position) <= this->FileSize ?
+      this->FileSize - static_cast<size_t>(position) : this->FileSize;
+    }
+  if (this->GzFile == nullptr)
+    {
+    return 0;
+    }
+  if (this->FileSize > unknown / FS_IO_GZ_MAX_RATIO)
+    {
+    return unknown;
+    }
+  const size_t inflatedSize = this->FileSize * FS_IO_GZ_MAX_RATIO;
+  z_off_t position = gztell (this->GzFile);
+  return position >= 0 && static_cast<size_t>(position) <= inflatedSize ?
+    inflatedSize - static_cast<size_t>(position) : inflatedSize;
+}
+
+//------------------------------------------------------------------------------
+char* vtkFSIO::InputStream::GetLine (char* oLine, int size)
+{
+  if (this->File != nullptr)
+    {
+    return fgets (oLine, size, this->File);
+    }
+  if (this->GzFile != nullptr)
+    {
+    return gzgets (this->GzFile, oLine, size);
+    }
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::InputStream::SkipWhitespace ()
+{
+  int c;
+  if (this->File != nullptr)
+    {
+    while ((c = fgetc (this->File)) != EOF && isspace (c))
+      {
+      }
+    if (c != EOF)
+      {
+      ungetc (c, this->File);
+      }
+    }
+  else if (this->GzFile != nullptr)
+    {
+    while ((c = gzgetc (this->GzFile)) != -1 && isspace (c))
+      {
+      }
+    if (c != -1)
+      {
+      gzungetc (c, this->GzFile);
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::InputStream::EndOfFile ()
+{
+  if (this->File != nullptr)
+    {
+    return feof (this->File) != 0;
+    }
+  if (this->GzFile != nullptr)
+    {
+    return gzeof (this->GzFile) != 0;
+    }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::InputStream::ReadToEnd (std::string& oData)
+{
+  char buffer[64 * 1024];
+  size_t numRead = 0;
+  while ((numRead = this->Read (buffer, sizeof(buffer))) > 0)
+    {
+    oData.append (buffer, numRead);
+    }
+  if (this->File != nullptr)
+    {
+    return ferror (this->File) == 0;
+    }
+  if (this->GzFile != nullptr)
+    {
+    int errorNumber = Z_OK;
+    gzerror (this->GzFile, &errorNumber);
+    return errorNumber == Z_OK || errorNumber == Z_STREAM_END;
+    }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+vtkFSIO::OutputStream::OutputStream()
+  : File(nullptr)
+  , GzFile(nullptr)
+  , Failed(false)
+{
+}
+
+//------------------------------------------------------------------------------
+vtkFSIO::OutputStream::~OutputStream()
+{
+  this->Close();
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::OutputStream::Open (const char* fileName, bool compress)
+{
+  this->Close();
+  this->Failed = false;
+  if (fileName == nullptr)
+    {
+    return false;
+    }
+
+  if (compress)
+    {
+    this->GzFile = gzopen (fileName, "wb");
+    if (this->GzFile == nullptr)
+      {
+      return false;
+      }
+    gzbuffer (this->GzFile, FS_IO_GZ_BUFFER_SIZE);
+    return true;
+    }
+  this->File = fopen (fileName, "wb");
+  if (this->File == nullptr)
+    {
+    return false;
+    }
+  setvbuf (this->File, nullptr, _IOFBF, FS_IO_GZ_BUFFER_SIZE);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::OutputStream::Close ()
+{
+  if (this->File != nullptr)
+    {
+    if (fclose (this->File) != 0)
+      {
+      this->Failed = true;
+      }
+    this->File = nullptr;
+    }
+  if (this->GzFile != nullptr)
+    {
+    if (gzclose (this->GzFile) != Z_OK)
+      {
+      this->Failed = true;
+      }
+    this->GzFile = nullptr;
+    }
+  return !this->Failed;
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::OutputStream::Write (const void* iBuffer, size_t size)
+{
+  if (this->Failed || !this->IsOpen())
+    {
+    this->Failed = true;
+    return false;
+    }
+  if (this->File != nullptr)
+    {
+    this->Failed = fwrite (iBuffer, 1, size, this->File) != size;
+    return !this->Failed;
+    }
+
+  // gzwrite takes an unsigned int length, so split very large blocks.
+  const unsigned char* buffer = static_cast<const unsigned char*>(iBuffer);
+  size_t result = 0;
+  while (result < size)
+    {
+    size_t chunk = size - result < FS_IO_GZ_MAX_READ ? size - result : FS_IO_GZ_MAX_READ;
+    int numWritten = gzwrite (this->GzFile, buffer + result, static_cast<unsigned int>(chunk));
+    if (numWritten <= 0 || static_cast<size_t>(numWritten) != chunk)
+      {
+      this->Failed = true;
+      return false;
+      }
+    result += chunk;
+    }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::ColorTable::Clear ()
+{
+  this->NameOffsets.clear();
+  this->RGBs.clear();
+  this->Names.clear();
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::ColorTable::SetNumberOfEntries (int numEntries)
+{
+  numEntries = std::max (numEntries, 0);
+  if (numEntries > FS_COLOR_TABLE_MAX_ENTRIES)
+    {
+    this->Clear();
+    return false;
+    }
+  try
+    {
+    this->NameOffsets.resize (numEntries, FS_COLOR_TABLE_UNUSED_ENTRY);
+    this->RGBs.resize (3 * static_cast<size_t>(numEntries), 0);
+    }
+  catch (const std::bad_alloc&)
+    {
+    this->Clear();
+    return false;
+    }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::ColorTable::SetEntry (int index, const char* name, size_t nameLength,
+                                    int r, int g, int b)
+{
+  if (index < 0 || index >= this->GetNumberOfEntries() || this->IsEntryUsed (index))
+    {
+    return false;
+    }
+  nameLength = std::find (name, name + nameLength, '\0') - name;
+  this->NameOffsets[index] = this->Names.size();
+  this->Names.insert (this->Names.end(), name, name + nameLength);
+  this->Names.push_back ('\0');
+  int* rgb = &this->RGBs[3 * static_cast<size_t>(index)];
+  rgb[0] = r;
+  rgb[1] = g;
+  rgb[2] = b;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::ColorTable::IsEntryUsed (int index) const
+{
+  return index >= 0 && index < this->GetNumberOfEntries() &&
+    this->NameOffsets[index] != FS_COLOR_TABLE_UNUSED_ENTRY;
+}
+
+//------------------------------------------------------------------------------
+const char* vtkFSIO::ColorTable::GetName (int index) const
+{
+  return this->IsEntryUsed (index) ? &this->Names[this->NameOffsets[index]] : nullptr;
+}
+
+//------------------------------------------------------------------------------
+const int* vtkFSIO::ColorTable::GetRGB (int index) const
+{
+  return this->IsEntryUsed (index) ? &this->RGBs[3 * static_cast<size_t>(index)] : nullptr;
+}
+
+//------------------------------------------------------------------------------
+int vtkFSIO::ColorTable::ParseText (const char* text, size_t size)
+{
+  this->Clear();
+  // The names can't take more room than the text itself.
+  this->Names.reserve (size);
+
+  const char* end = text + size;
+  int lineNumber = 0;
+  for (const char* line = text; line < end; )
+    {
+    const char* lineEnd = std::find (line, end, '\n');
+    const char* next = lineEnd < end ? lineEnd + 1 : end;
+    lineNumber++;
+
+    const char* p = line;
+    while (p < lineEnd && isspace (static_cast<unsigned char>(*p)))
+      {
+      ++p;
+      }
+    if (p == lineEnd || *p == '#')
+      {
+      line = next;
+      continue;
+      }
+
+    int index = 0;
+    int rgb[3] = { 0, 0, 0 };
+    if (!vtkFSIO::ParseInt (p, lineEnd, index) || index < 0)
+      {
+      return lineNumber;
+      }
+    while (p < lineEnd && IsSpaceOrTab (*p))
+      {
+      ++p;
+      }
+    const char* name = p;
+    while (p < lineEnd && !isspace (static_cast<unsigned char>(*p)))
+      {
+      ++p;
+      }
+    const char* nameEnd = p;
+    if (name == nameEnd ||
+        !vtkFSIO::ParseInt (p, lineEnd, rgb[0]) ||
+        !vtkFSIO::ParseInt (p, lineEnd, rgb[1]) ||
+        !vtkFSIO::ParseInt (p, lineEnd, rgb[2]))
+      {
+      return lineNumber;
+      }
+
+    if (index >= this->GetNumberOfEntries() && !this->SetNumberOfEntries (index + 1))
+      {
+      return lineNumber;
+      }
+    if (!this->SetEntry (index, name, nameEnd - name, rgb[0], rgb[1], rgb[2]))
+      {
+      return lineNumber;
+      }
+    line = next;
+    }
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+vtkFSIO::MappedFile::MappedFile()
+  : Data(nullptr)
+  , Size(0)
+#ifdef _WIN32
+  , FileHandle(nullptr)
+  , MappingHandle(nullptr)
+#endif
+{
+}
+
+//------------------------------------------------------------------------------
+vtkFSIO::MappedFile::~MappedFile()
+{
+  this->Close();
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSIO::MappedFile::Open (const char* fileName)
+{
+  this->Close();
+  if (fileName == nullptr)
+    {
+    return false;
+    }
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    {
+    return false;
+    }
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+    {
+    CloseHandle(file);
+    return false;
+    }
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr)
+    {
+    CloseHandle(file);
+    return false;
+    }
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr)
+    {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+    }
+  this->FileHandle = file;
+  this->MappingHandle = mapping;
+  this->Data = static_cast<const unsigned char*>(view);
+  this->Size = static_cast<size_t>(fileSize.QuadPart);
+#else
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0)
+    {
+    return false;
+    }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0)
+    {
+    close(fd);
+    return false;
+    }
+  size_t size = static_cast<size_t>(fileStat.st_size);
+  void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  if (view == MAP_FAILED)
+    {
+    return false;
+    }
+# ifdef MADV_SEQUENTIAL
+  madvise(view, size, MADV_SEQUENTIAL);
+# endif
+  this->Data = static_cast<const unsigned char*>(view);
+  this->Size = size;
+#endif
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkFSIO::MappedFile::Close ()
+{
+  if (this->Data == nullptr)
+    {
+    return;
+    }
+#ifdef _WIN32
+  UnmapViewOfFile(this->Data);
+  CloseHandle(this->MappingHandle);
+  CloseHandle(this->FileHandle);
+  this->MappingHandle = nullptr;
+  this->FileHandle = nullptr;
+#else
+  munmap(const_cast<unsigned char*>(this->Data), this->Size);
+#endif
+  this->Data = nullptr;
+  this->Size = 0;
+}
@@ -16,7 +16,10 @@
 #include <vtk_zlib.h>
 
 // STD includes
+#include <cstddef>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 /// \brief Some IO functions for irregular FreeSurface files.
 ///
@@ -38,7 +41,225 @@ namespace vtkFSIO {
   int VTK_FreeSurfer_EXPORT ReadInt2Z (gzFile iFile, int& oInt);
   int VTK_FreeSurfer_EXPORT ReadFloatZ (gzFile iFile, float& oFloat);
 
-  /// For testing purposes
+  /// Block decoding of big-endian data already in memory. Each function
+  /// converts \a count values from the byte stream at \a iBuffer into host
+  /// order in \a oValues. The short, int and float variants may decode in
+  /// place (iBuffer == oValues).
+  void VTK_FreeSurfer_EXPORT DecodeShortArray (const void* iBuffer, short* oValues, size_t count);
+  void VTK_FreeSurfer_EXPORT DecodeIntArray (const void* iBuffer, int* oValues, size_t count);
+  void VTK_FreeSurfer_EXPORT DecodeInt3Array (const void* iBuffer, int* oValues, size_t count);
+  void VTK_FreeSurfer_EXPORT DecodeFloatArray (const void* iBuffer, float* oValues, size_t count);
+  /// Decode \a count packed (three byte int, float) pairs, as stored in w files.
+  void VTK_FreeSurfer_EXPORT DecodeInt3FloatPairs (const void* iBuffer, int* oIndices, float* oValues, size_t count);
+
+  /// Block encoding, the reverse of the decoding functions above: convert
+  /// \a count host order values at \a iValues into big-endian bytes at
+  /// \a oBuffer. Three byte ints keep the low 24 bits of each value. The
+  /// short, int and float variants may encode in place.
+  void VTK_FreeSurfer_EXPORT EncodeShortArray (const short* iValues, void* oBuffer, size_t count);
+  void VTK_FreeSurfer_EXPORT EncodeIntArray (const int* iValues, void* oBuffer, size_t count);
+  void VTK_FreeSurfer_EXPORT EncodeInt3Array (const int* iValues, void* oBuffer, size_t count);
+  void VTK_FreeSurfer_EXPORT EncodeFloatArray (const float* iValues, void* oBuffer, size_t count);
+  void VTK_FreeSurfer_EXPORT EncodeInt3FloatPairs (const int* iIndices, const float* iValues, void* oBuffer, size_t count);
+
+  /// Block reading versions of the functions above. These read \a count
+  /// values with as few fread calls as possible and return the number of
+  /// complete values read, which is less than \a count on a short read.
+  size_t VTK_FreeSurfer_EXPORT ReadShortArray (FILE* iFile, short* oValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT ReadIntArray (FILE* iFile, int* oValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT ReadInt3Array (FILE* iFile, int* oValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT ReadFloatArray (FILE* iFile, float* oValues, size_t count);
+  /// Read \a count (int, int) pairs into \a oPairs, which must hold 2*count ints.
+  size_t VTK_FreeSurfer_EXPORT ReadIntPairs (FILE* iFile, int* oPairs, size_t count);
+  size_t VTK_FreeSurfer_EXPORT ReadInt3FloatPairs (FILE* iFile, int* oIndices, float* oValues, size_t count);
+
+  /// \brief Sequential input from a plain or gzip compressed file.
+  ///
+  /// Compression is detected from the gzip magic bytes at the start of
+  /// the file, not from the file name, so readers can use the same code
+  /// for both. Compressed files are inflated in large blocks.
+  class VTK_FreeSurfer_EXPORT InputStream
+  {
+  public:
+    InputStream();
+    ~InputStream();
+
+    /// Open \a fileName for reading. Returns false if it can't be opened.
+    bool Open (const char* fileName);
+    void Close ();
+
+    bool IsOpen () const { return this->File != nullptr || this->GzFile != nullptr; }
+    bool IsCompressed () const { return this->GzFile != nullptr; }
+
+    /// Read up to \a size bytes and return the number of bytes read.
+    size_t Read (void* oBuffer, size_t size);
+    /// Read a line of at most \a size - 1 characters, like fgets.
+    char* GetLine (char* oLine, int size);
+    /// Skip any whitespace, like fscanf (file, "\n").
+    void SkipWhitespace ();
+    bool EndOfFile ();
+    /// Append everything left in the file to \a oData. Returns false on
+    /// a read error.
+    bool ReadToEnd (std::string& oData);
+
+    /// Upper bound of the number of bytes left to read, to check counts
+    /// read from the file before allocating for them. Exact for plain
+    /// files; compressed files are bounded by the maximum deflate ratio.
+    size_t GetMaximumRemainingSize ();
+
+  private:
+    InputStream(const InputStream&) = delete;
+    void operator=(const InputStream&) = delete;
+
+    FILE* File;
+    gzFile GzFile;
+    /// size of the file on disk, SIZE_MAX if unknown
+    size_t FileSize;
+  };
+
+  /// InputStream versions of the single value readers. They return the
+  /// number of values read, like their FILE counterparts.
+  int VTK_FreeSurfer_EXPORT ReadInt (InputStream& iStream, int& oInt);
+  int VTK_FreeSurfer_EXPORT ReadInt3 (InputStream& iStream, int& oInt);
+  int VTK_FreeSurfer_EXPORT ReadInt2 (InputStream& iStream, int& oInt);
+  int VTK_FreeSurfer_EXPORT ReadFloat (InputStream& iStream, float& oFloat);
+
+  /// InputStream versions of the block readers.
+  size_t VTK_FreeSurfer_EXPORT ReadShortArray (InputStream& iStream, short* oValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT ReadIntArray (InputStream& iStream, int* oValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT ReadInt3Array (InputStream& iStream, int* oValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT ReadFloatArray (InputStream& iStream, float* oValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT ReadIntPairs (InputStream& iStream, int* oPairs, size_t count);
+  size_t VTK_FreeSurfer_EXPORT ReadInt3FloatPairs (InputStream& iStream, int* oIndices, float* oValues, size_t count);
+
+  /// \brief Sequential output to a plain or gzip compressed file.
+  ///
+  /// The counterpart of InputStream. Writes go through a large buffer, and
+  /// the first failed write makes the stream fail: further writes do
+  /// nothing and Close returns false, so writers can check once at the end.
+  class VTK_FreeSurfer_EXPORT OutputStream
+  {
+  public:
+    OutputStream();
+    ~OutputStream();
+
+    /// Create or truncate \a fileName, compressed with gzip if \a compress
+    /// is set. Returns false if it can't be opened.
+    bool Open (const char* fileName, bool compress = false);
+    /// Flush and close the file. Returns false if a write failed.
+    bool Close ();
+
+    bool IsOpen () const { return this->File != nullptr || this->GzFile != nullptr; }
+    bool IsCompressed () const { return this->GzFile != nullptr; }
+    bool HasFailed () const { return this->Failed; }
+
+    /// Write \a size bytes. Returns false on error.
+    bool Write (const void* iBuffer, size_t size);
+
+  private:
+    OutputStream(const OutputStream&) = delete;
+    void operator=(const OutputStream&) = delete;
+
+    FILE* File;
+    gzFile GzFile;
+    bool Failed;
+  };
+
+  /// OutputStream version of WriteInt.
+  int VTK_FreeSurfer_EXPORT WriteInt (OutputStream& oStream, int iInt);
+
+  /// Block writers, the counterparts of the block readers. They encode
+  /// \a count values a block at a time and return the number of values
+  /// written.
+  size_t VTK_FreeSurfer_EXPORT WriteShortArray (OutputStream& oStream, const short* iValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT WriteIntArray (OutputStream& oStream, const int* iValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT WriteInt3Array (OutputStream& oStream, const int* iValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT WriteFloatArray (OutputStream& oStream, const float* iValues, size_t count);
+  size_t VTK_FreeSurfer_EXPORT WriteInt3FloatPairs (OutputStream& oStream, const int* iIndices, const float* iValues, size_t count);
+
+  /// Locale independent parsing of ASCII numbers, for the text formats
+  /// (labels, color tables). Each function skips leading spaces and tabs,
+  /// parses one number ending at \a end, a whitespace or a newline, and
+  /// advances \a ioText past it. They return false, leaving \a ioText
+  /// unchanged, if there is no valid number there.
+  bool VTK_FreeSurfer_EXPORT ParseInt (const char*& ioText, const char* end, int& oValue);
+  bool VTK_FreeSurfer_EXPORT ParseFloat (const char*& ioText, const char* end, float& oValue);
+  bool VTK_FreeSurfer_EXPORT ParseDouble (const char*& ioText, const char* end, double& oValue);
+
+  /// \brief FreeSurfer color table, indexed by structure number.
+  ///
+  /// Names are stored back to back in a single character arena and colors
+  /// in one int array, so a table takes a few allocations whatever its size
+  /// and is released with the object. Indices without an entry, as found in
+  /// sparse tables, are unused: they have no name and no color.
+  class VTK_FreeSurfer_EXPORT ColorTable
+  {
+  public:
+    void Clear ();
+
+    /// Resize the table. Entries added this way are unused. Returns
+    /// false, with an empty table, if the table would have more than 2^20
+    /// entries or the memory can't be allocated.
+    bool SetNumberOfEntries (int numEntries);
+    int GetNumberOfEntries () const { return static_cast<int>(this->NameOffsets.size()); }
+
+    /// Fill entry \a index with the first \a nameLength characters of
+    /// \a name (or up to a null character) and an rgb color. Returns false
+    /// if the index is out of range or already used.
+    bool SetEntry (int index, const char* name, size_t nameLength, int r, int g, int b);
+
+    bool IsEntryUsed (int index) const;
+    /// Name and r, g, b of entry \a index, or nullptr if the entry is
+    /// unused. The pointers are valid until the table is modified.
+    const char* GetName (int index) const;
+    const int* GetRGB (int index) const;
+
+    /// Parse a text color table, with lines of "index name r g b [a]", in
+    /// a single pass. Blank lines and lines starting with '#' are skipped
+    /// and the table grows to the highest index found. Returns 0 on
+    /// success, otherwise the (1-based) number of the first malformed
+    /// line; duplicate indices are malformed.
+    int ParseText (const char* text, size_t size);
+
+  private:
+    std::vector<size_t> NameOffsets;
+    std::vector<int> RGBs;
+    std::vector<char> Names;
+  };
+
+  /// \brief Read-only memory mapping of a whole file.
+  ///
+  /// Lets readers decode data blocks straight from the page cache
+  /// without copying them through stdio buffers first. The mapping is
+  /// released when the object is destroyed.
+  class VTK_FreeSurfer_EXPORT MappedFile
+  {
+  public:
+    MappedFile();
+    ~MappedFile();
+
+    /// Map \a fileName. Returns false if the file could not be opened
+    /// or mapped, or is empty.
+    bool Open (const char* fileName);
+    void Close ();
+
+    const unsigned char* GetData () const { return this->Data; }
+    size_t GetSize () const { return this->Size; }
+
+  private:
+    MappedFile(const MappedFile&) = delete;
+    void operator=(const MappedFile&) = delete;
+
+    const unsigned char* Data;
+    size_t Size;
+#ifdef _WIN32
+    void* FileHandle;
+    void* MappingHandle;
+#endif
+  };
+
+  /// Single value writers, the counterparts of ReadInt, ReadInt3 and
+  /// ReadInt2. They return the number of values written.
   int VTK_FreeSurfer_EXPORT WriteInt (FILE* iFile, int iInt);
   int VTK_FreeSurfer_EXPORT WriteInt3 (FILE* iFile, int iInt);
   int VTK_FreeSurfer_EXPORT WriteInt2 (FILE* iFile, int iInt);
@@ -16,7 +16,147 @@
 #include "vtkFSLookupTable.h"
 
 // VTK includes
+#include <vtkDataArray.h>
 #include <vtkObjectFactory.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkUnsignedCharArray.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+/// The GreenRed and RedGreen scales use tanh(Slope*(val-FMid)), which is 1
+/// in float precision once its argument is past this value.
+const double FS_TANH_SATURATION = 10.0;
+
+/// Minimum number of values coloured by one thread.
+const vtkIdType FS_LUT_GRAIN_SIZE = 16 * 1024;
+
+/// Relative margin by which the flat parts of the heat scales are narrowed
+/// before a cached colour is kept, the scale is evaluated in float precision.
+const double FS_FLAT_BAND_MARGIN = 1.0e-6;
+
+/// Index of the parameters of GetScaleParameters that an incremental update
+/// depends on.
+enum
+{
+  FS_PARAMETER_LUT_TYPE = 0,
+  FS_PARAMETER_OFFSET = 5,
+  FS_PARAMETER_REVERSE = 7,
+  FS_PARAMETER_TRUNCATE = 8,
+  FS_PARAMETER_ALPHA = 9,
+  FS_PARAMETER_USE_RAMP_TABLE = 10,
+};
+
+//------------------------------------------------------------------------------
+// Maps one value to a colour, through the ramp table where it applies and
+// with the exact scale otherwise. Only reads its table, so one mapper can be
+// used from several threads.
+struct ScaleMapper
+{
+  const vtkFSLookupTable *Table = nullptr;
+  /// RGB ramp, or nullptr to evaluate every value.
+  const unsigned char *Ramp = nullptr;
+  double RampMin = 0.0;
+  double RampScale = 0.0;
+  /// Values with a magnitude up to this are evaluated. The heat scales
+  /// switch from red to blue at 0.
+  double ExactBand = -1.0;
+  /// The heat scales have the same colour on either side of their ramp, so
+  /// values past its ends use the end colours.
+  bool ClampToRamp = false;
+  unsigned char Alpha = 255;
+  int OutputIncrement = VTK_RGBA;
+
+  void operator()(double val, unsigned char *out) const
+  {
+    double position = (val - this->RampMin) * this->RampScale;
+    if (this->ClampToRamp)
+      {
+      // keeps nan
+      position = std::min(std::max(position, 0.0), vtkFSLookupTable::FS_RAMP_TABLE_SIZE - 1.0);
+      }
+    // false for nan
+    if (this->Ramp != nullptr && position >= 0.0 &&
+        position <= vtkFSLookupTable::FS_RAMP_TABLE_SIZE - 1 &&
+        std::abs(val) > this->ExactBand)
+      {
+      const unsigned char *rgb8 = this->Ramp + 3*static_cast<vtkIdType>(position + 0.5);
+      out[0] = rgb8[0];
+      out[1] = rgb8[1];
+      out[2] = rgb8[2];
+      }
+    else
+      {
+      unsigned char rgba[4];
+      this->Table->ComputeColor(val, rgba);
+      out[0] = rgba[0];
+      out[1] = rgba[1];
+      out[2] = rgba[2];
+      }
+    if (this->OutputIncrement == VTK_RGBA)
+      {
+      // opacity set to be always 1
+      out[3] = this->Alpha;
+      }
+  }
+};
+
+//------------------------------------------------------------------------------
+template <class T>
+void MapScalarsThroughMapper(const ScaleMapper& mapper, const T *input, unsigned char *output,
+                             vtkIdType numberOfValues, int inputIncrement,
+                             const double *updateBand)
+{
+  vtkSMPTools::For(0, numberOfValues, FS_LUT_GRAIN_SIZE,
+    [&mapper, input, output, inputIncrement, updateBand](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType n = begin; n < end; n++)
+      {
+      const double val = static_cast<double>(input[n*inputIncrement]);
+      // true for nan
+      if (updateBand == nullptr ||
+          (!(std::abs(val) < updateBand[0]) && !(std::abs(val) > updateBand[1])))
+        {
+        mapper(val, output + n*mapper.OutputIncrement);
+        }
+      }
+    });
+}
+}
+
+//------------------------------------------------------------------------------
+// Colours of the last mapped scalar arrays, least recently used ones are
+// replaced first.
+class vtkFSLookupTable::vtkColorCache
+{
+public:
+  struct Entry
+  {
+    /// Identify the mapped array, the address alone could be reused by a new
+    /// array but its modification time would be newer.
+    const void *Array = nullptr;
+    vtkMTimeType ArrayMTime = 0;
+    int DataType = 0;
+    vtkIdType NumberOfValues = 0;
+    int OutputFormat = 0;
+    /// GetScaleParameters the colours were mapped with
+    std::vector<double> Parameters;
+    /// Magnitudes below and above which the heat scales have a constant
+    /// colour, -1 if there is no such range
+    double FlatBand[2] = {-1.0, -1.0};
+    /// Colours of the lowest and highest values
+    unsigned char FlatColors[2][4] = {{0, 0, 0, 0}, {0, 0, 0, 0}};
+    vtkSmartPointer<vtkUnsignedCharArray> Colors;
+    unsigned long LastUse = 0;
+  };
+
+  std::vector<Entry> Entries;
+  unsigned long UseCount = 0;
+};
 
 //------------------------------------------------------------------------------
 vtkStandardNewMacro(vtkFSLookupTable);
@@ -34,12 +174,18 @@ vtkFSLookupTable::vtkFSLookupTable()
     this->Blufact = 1.0;
     this->FMid = 0.0;
     this->NumberOfColors = 256;
+    this->UseRampTable = 0;
+    this->RampTableRange[0] = 0.0;
+    this->RampTableRange[1] = 0.0;
+    this->ColorCache = new vtkColorCache;
+    this->ColorCacheSize = 8;
 }
 
 //------------------------------------------------------------------------------
 vtkFSLookupTable::~vtkFSLookupTable()
 {
     // delete any allocated memory
+    delete this->ColorCache;
 }
 
 //------------------------------------------------------------------------------
@@ -56,6 +202,8 @@ void vtkFSLookupTable::PrintSelf(ostream& os, vtkIndent indent)
     os << indent << "Slope: " << this->Slope << endl;
     os << indent << "Blufact: " << this->Blufact << endl;
     os << indent << "Slope mid point FMid: " << this->FMid << endl;
+    os << indent << "UseRampTable: " << this->UseRampTable << endl;
+    os << indent << "ColorCacheSize: " << this->ColorCacheSize << endl;
 }
 
 //------------------------------------------------------------------------------
@@ -189,7 +337,7 @@ void vtkFSLookupTable::SetRange(double /*lo*/, double /*hi*/)
 }
 
 //------------------------------------------------------------------------------
-const unsigned char *vtkFSLookupTable::MapValue(double val)
+void vtkFSLookupTable::ComputeColor(double val, unsigned char rgba[4]) const
 {
     /// variables for the heat colour scale
     float f, ftmp, c1, c2, fcurv;
@@ -208,15 +356,10 @@ const unsigned char *vtkFSLookupTable::MapValue(double val)
     case FSLUTHEAT:
     case FSLUTBLUERED:
     case FSLUTREDBLUE:
-      // temp solution for red/blue, blue/red
-      if (this->LutType == FSLUTREDBLUE)
-        {
-        this->ReverseOn();
-        }
-        /// functional overlay heat scale
+        /// functional overlay heat scale, red/blue is always reversed
         f = val;
         fcurv = this->Slope;
-        if (this->Reverse)
+        if (this->Reverse || this->LutType == FSLUTREDBLUE)
         {
             f = -f;
         }
@@ -263,10 +406,12 @@ const unsigned char *vtkFSLookupTable::MapValue(double val)
                 this->Offset*((f < this->LowThresh)?1:(f < this->FMid)?1 - (f - this->LowThresh)/(this->FMid - this->LowThresh):0);
         }
 
-        this->RGBA[0] = (unsigned char)(r * 255.0);
-        this->RGBA[1] = (unsigned char)(g * 255.0);
-        this->RGBA[2] = (unsigned char)(b * 255.0);
-        this->RGBA[3] = (unsigned char)(a * 255.0);
+        // the offset can push the colour over 1, clamp so that it doesn't
+        // wrap around when converted
+        rgba[0] = (unsigned char)(std::min(std::max(r, 0.0f), 1.0f) * 255.0);
+        rgba[1] = (unsigned char)(std::min(std::max(g, 0.0f), 1.0f) * 255.0);
+        rgba[2] = (unsigned char)(std::min(std::max(b, 0.0f), 1.0f) * 255.0);
+        rgba[3] = (unsigned char)(a * 255.0);
 
         break;
     case FSLUTGREENRED:
@@ -296,10 +441,10 @@ const unsigned char *vtkFSLookupTable::MapValue(double val)
             b = 255 * (this->Offset*this->Blufact*(1 - fabs(f)));
         }
 
-        this->RGBA[0] = (unsigned char)(r);
-        this->RGBA[1] = (unsigned char)(g);
-        this->RGBA[2] = (unsigned char)(b);
-        this->RGBA[3] = (unsigned char)(a * 255.0);
+        rgba[0] = (unsigned char)(std::min(std::max(r, 0.0f), 255.0f));
+        rgba[1] = (unsigned char)(std::min(std::max(g, 0.0f), 255.0f));
+        rgba[2] = (unsigned char)(std::min(std::max(b, 0.0f), 255.0f));
+        rgba[3] = (unsigned char)(a * 255.0);
 
         break;
     case FSLUTREDGREEN:
@@ -330,10 +475,10 @@ const unsigned char *vtkFSLookupTable::MapValue(double val)
             b = 255 * (this->Offset*this->Blufact*(1 - fabs(f)));
         }
 
-        this->RGBA[0] = (unsigned char)(r);
-        this->RGBA[1] = (unsigned char)(g);
-        this->RGBA[2] = (unsigned char)(b);
-        this->RGBA[3] = (unsigned char)(a * 255.0);
+        rgba[0] = (unsigned char)(std::min(std::max(r, 0.0f), 255.0f));
+        rgba[1] = (unsigned char)(std::min(std::max(g, 0.0f), 255.0f));
+        rgba[2] = (unsigned char)(std::min(std::max(b, 0.0f), 255.0f));
+        rgba[3] = (unsigned char)(a * 255.0);
 
         break;
         /*
@@ -345,18 +490,30 @@ const unsigned char *vtkFSLookupTable::MapValue(double val)
         break;
         */
     default:
-        vtkErrorMacro(<<"Unknown look up table type " << this->LutType);
+        // labels or unknown type
+        rgba[0] = 0;
+        rgba[1] = 0;
+        rgba[2] = 0;
+        rgba[3] = (unsigned char)(a * 255.0);
     }
+}
 
-//    vtkDebugMacro(<<"R = " << this->RGBA[1] << ", G = " <<  this->RGBA[2] << ", B = " <<  this->RGBA[3] << endl);
-
+//------------------------------------------------------------------------------
+const unsigned char *vtkFSLookupTable::MapValue(double val)
+{
+    if (this->LutType < FSLUTHEAT || this->LutType > FSLUTGREENRED)
+      {
+      vtkErrorMacro(<<"Unknown look up table type " << this->LutType);
+      }
+    this->ComputeColor(val, this->RGBA);
     return this->RGBA;
 }
 
 //------------------------------------------------------------------------------
 void vtkFSLookupTable::GetColor(double val, double rgb[3])
 {
-    const unsigned char *rgb8 = this->MapValue(val);
+    unsigned char rgb8[4];
+    this->ComputeColor(val, rgb8);
 
     rgb[0] = rgb8[0]/255.0;
     rgb[1] = rgb8[1]/255.0;
@@ -368,11 +525,6 @@ void vtkFSLookupTable::MapScalarsThroughTable2(void *input, unsigned char *outpu
                                int inputDataType, int numberOfValues,
                                int inputIncrement, int outputIncrement)
 {
-    int n;
-    double rgb[3];
-    double val;
-    const unsigned char alpha = (unsigned char)(this->Alpha * 255.0);
-
     vtkDebugMacro( << "MapScalarsThroughTable2:\n");
     vtkDebugMacro( << "\tinputDataType = " << inputDataType << ", number of vals = " << numberOfValues << ", input incr = " << inputIncrement << ",\noutput incr = " << outputIncrement << ", VTK_RGBA data type = "<< VTK_RGBA << ", lut type = " << this->LutType << endl);
 
@@ -403,141 +555,273 @@ void vtkFSLookupTable::MapScalarsThroughTable2(void *input, unsigned char *outpu
       }
 
 
+    this->MapScalarsThroughScale(input, output, inputDataType, numberOfValues,
+                                 inputIncrement, outputIncrement, nullptr);
+}
+
+//------------------------------------------------------------------------------
+void vtkFSLookupTable::MapScalarsThroughScale(void *input, unsigned char *output,
+                               int inputDataType, vtkIdType numberOfValues,
+                               int inputIncrement, int outputIncrement,
+                               const double *updateBand)
+{
+    ScaleMapper mapper;
+    mapper.Table = this;
+    mapper.Alpha = (unsigned char)(this->Alpha * 255.0);
+    mapper.OutputIncrement = outputIncrement;
+    if (this->UseRampTable && this->UpdateRampTable())
+      {
+      mapper.Ramp = this->RampTable.data();
+      mapper.RampMin = this->RampTableRange[0];
+      mapper.RampScale = (FS_RAMP_TABLE_SIZE - 1) / (this->RampTableRange[1] - this->RampTableRange[0]);
+      if (this->LutType == FSLUTHEAT || this->LutType == FSLUTBLUERED || this->LutType == FSLUTREDBLUE)
+        {
+        mapper.ExactBand = 1.0 / mapper.RampScale;
+        mapper.ClampToRamp = true;
+        }
+      }
+
     switch (inputDataType)
       {
-      case VTK_DOUBLE:
-        vtkDebugMacro(<<"Input data type is double.");
-        for (n = 0; n < numberOfValues; n++)
-          {
-          double *inPtr;
-          inPtr = static_cast<double *>(input);
-          inPtr += n*inputIncrement;
-          val = *inPtr;
-          this->GetColor(val, rgb);
-          if (n < 100) // (n % 10000 == 0)
-            {
-            vtkDebugMacro( << n << ": val = " << val << ", rgb = " << rgb[0] << "," << rgb[1] << "," << rgb[2] << "\noutput array index = " << n*outputIncrement*sizeof(unsigned char));
-            }
-          if (rgb[0] < 0.0 || rgb[0] > 1.0 ||
-              rgb[1] < 0.0 || rgb[1] > 1.0 ||
-              rgb[2] < 0.0 || rgb[2] > 1.0)
-            {
-            // invalid colour values, use 0
-            vtkDebugMacro(<<"Val " << val << " resulted in invalid rgb, out of range 0-1, using 0 0 0 instead of " << rgb[0] << " " << rgb[1] << " " << rgb[2] );
-            rgb[0] = 0.0;
-            rgb[1] = 0.0;
-            rgb[2] = 0.0;
-            }
-          // now save it to the output - should loop 0 to
-          // outputIncrement
+      vtkTemplateMacro(MapScalarsThroughMapper(mapper, static_cast<const VTK_TT*>(input),
+                                               output, numberOfValues, inputIncrement, updateBand));
+      default:
+        vtkErrorMacro(<<"MapScalarsThroughTable2: Have no idea how to deal with this input type " << inputDataType);
+      }
+}
 
-          output[n*outputIncrement*sizeof(unsigned char)] = (unsigned char)(rgb[0]*255.0);
-          output[n*outputIncrement*sizeof(unsigned char) + 1] = (unsigned char)(rgb[1]*255.0);
-          output[n*outputIncrement*sizeof(unsigned char) + 2] = (unsigned char)(rgb[2]*255.0);
-          if (outputIncrement == VTK_RGBA)
-            {
-            // opacity set to be always 1
-            output[n*outputIncrement*sizeof(unsigned char) + 3] = alpha;
-            }
-          }
-        break;
-      case VTK_FLOAT:
-        vtkDebugMacro(<<"Input data type is float.");
-        for (n = 0; n < numberOfValues; n++)
-          {
-          float *inPtr;
-          inPtr = static_cast<float *>(input);
-          inPtr += n*inputIncrement;
-          val = *inPtr;
-          this->GetColor(val, rgb);
-          if (n < 100) // (n % 10000 == 0)
-            {
-            vtkDebugMacro( << n << ": val = " << val << ", rgb = " << rgb[0] << "," << rgb[1] << "," << rgb[2] << "\noutput array index = " << n*outputIncrement*sizeof(unsigned char));
-            }
-          if (rgb[0] < 0.0 || rgb[0] > 1.0 ||
-              rgb[1] < 0.0 || rgb[1] > 1.0 ||
-              rgb[2] < 0.0 || rgb[2] > 1.0)
-            {
-            // invalid colour values, use 0
-            vtkDebugMacro(<<"Val " << val << " resulted in invalid rgb, out of range 0-1, using 0 0 0 instead of " << rgb[0] << " " << rgb[1] << " " << rgb[2] );
-            rgb[0] = 0.0;
-            rgb[1] = 0.0;
-            rgb[2] = 0.0;
-            }
-          // now save it to the output - should loop 0 to
-          // outputIncrement
+//------------------------------------------------------------------------------
+#if VTK_MAJOR_VERSION >= 9
+vtkUnsignedCharArray *vtkFSLookupTable::MapScalars(vtkAbstractArray *abstractScalars, int colorMode,
+                                                   int component, int outputFormat)
+{
+#else
+vtkUnsignedCharArray *vtkFSLookupTable::MapScalars(vtkAbstractArray *abstractScalars, int colorMode,
+                                                   int component)
+{
+    // VTK 8 always maps to RGBA
+    const int outputFormat = VTK_RGBA;
+#endif
+    vtkDataArray *scalars = vtkDataArray::SafeDownCast(abstractScalars);
+    if (scalars == nullptr || this->ColorCacheSize <= 0 ||
+        this->LutType < FSLUTHEAT || this->LutType > FSLUTGREENRED ||
+        this->IndexedLookup || scalars->GetNumberOfComponents() != 1 ||
+        (outputFormat != VTK_RGBA && outputFormat != VTK_RGB) ||
+        !(colorMode == VTK_COLOR_MODE_MAP_SCALARS ||
+          (colorMode == VTK_COLOR_MODE_DEFAULT && scalars->GetDataType() != VTK_UNSIGNED_CHAR)))
+      {
+      // direct colours, labels, vectors, ...
+#if VTK_MAJOR_VERSION >= 9
+      return this->Superclass::MapScalars(abstractScalars, colorMode, component, outputFormat);
+#else
+      return this->Superclass::MapScalars(abstractScalars, colorMode, component);
+#endif
+      }
 
-          output[n*outputIncrement*sizeof(unsigned char)] = (unsigned char)(rgb[0]*255.0);
-          output[n*outputIncrement*sizeof(unsigned char) + 1] = (unsigned char)(rgb[1]*255.0);
-          output[n*outputIncrement*sizeof(unsigned char) + 2] = (unsigned char)(rgb[2]*255.0);
-          if (outputIncrement == VTK_RGBA)
-            {
-            // opacity set to be always 1
-            output[n*outputIncrement*sizeof(unsigned char) + 3] = alpha;
-            }
-          }
+    vtkColorCache::Entry key;
+    key.Array = scalars;
+    key.ArrayMTime = scalars->GetMTime();
+    key.DataType = scalars->GetDataType();
+    key.NumberOfValues = scalars->GetNumberOfTuples();
+    key.OutputFormat = outputFormat;
+    key.Parameters = this->GetScaleParameters();
+    double range[2];
+    if ((this->LutType == FSLUTHEAT || this->LutType == FSLUTBLUERED || this->LutType == FSLUTREDBLUE) &&
+        !this->Truncate && this->GetRampTableRange(range))
+      {
+      // grey below both the threshold and the mid point
+      key.FlatBand[0] = std::min(this->LowThresh, this->FMid);
+      key.FlatBand[1] = range[1];
+      if (this->UseRampTable)
+        {
+        // the ramp can round to the first sample past the grey part
+        key.FlatBand[0] -= 2.0 * (range[1] - range[0]) / (FS_RAMP_TABLE_SIZE - 1);
+        }
+      }
+    double extremes[2] = { -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX };
+    unsigned char extremeColors[8];
+    this->MapScalarsThroughScale(extremes, extremeColors, VTK_DOUBLE, 2, 1, 4, nullptr);
+    std::copy(extremeColors, extremeColors + 4, key.FlatColors[0]);
+    std::copy(extremeColors + 4, extremeColors + 8, key.FlatColors[1]);
+
+    std::vector<vtkColorCache::Entry>& entries = this->ColorCache->Entries;
+    vtkColorCache::Entry *hit = nullptr;
+    vtkColorCache::Entry *update = nullptr;
+    for (vtkColorCache::Entry& entry : entries)
+      {
+      if (entry.Array != key.Array || entry.ArrayMTime != key.ArrayMTime ||
+          entry.DataType != key.DataType || entry.NumberOfValues != key.NumberOfValues ||
+          entry.OutputFormat != key.OutputFormat)
+        {
+        continue;
+        }
+      if (entry.Parameters == key.Parameters)
+        {
+        hit = &entry;
         break;
-      case VTK_INT:
-        vtkDebugMacro(<<"Input data type is int.");
-        for (n = 0; n < numberOfValues; n++)
-          {
-          int *inPtr;
-          inPtr = static_cast<int *>(input);
-          inPtr += n*inputIncrement;
-          val = *inPtr;
-          this->GetColor(val, rgb);
-          if (n < 100) // (n % 10000 == 0)
-            {
-            vtkDebugMacro( << n << ": val = " << val << ", rgb = " << rgb[0] << "," << rgb[1] << "," << rgb[2] << "\noutput array index = " << n*outputIncrement*sizeof(unsigned char));
-            }
-          if (rgb[0] < 0.0 || rgb[0] > 1.0 ||
-              rgb[1] < 0.0 || rgb[1] > 1.0 ||
-              rgb[2] < 0.0 || rgb[2] > 1.0)
-            {
-            // invalid colour values, use 0
-            vtkDebugMacro(<<"Val " << val << " resulted in invalid rgb, out of range 0-1, using 0 0 0 instead of " << rgb[0] << " " << rgb[1] << " " << rgb[2] );
-            rgb[0] = 0.0;
-            rgb[1] = 0.0;
-            rgb[2] = 0.0;
-            }
-          // now save it to the output - should loop 0 to
-          // outputIncrement
+        }
+      // a heat scale threshold change keeps the colours of the values that
+      // are flat with both the old and the new thresholds
+      if (entry.FlatBand[1] >= 0.0 && key.FlatBand[1] >= 0.0 &&
+          entry.Parameters[FS_PARAMETER_LUT_TYPE] == key.Parameters[FS_PARAMETER_LUT_TYPE] &&
+          entry.Parameters[FS_PARAMETER_REVERSE] == key.Parameters[FS_PARAMETER_REVERSE] &&
+          entry.Parameters[FS_PARAMETER_TRUNCATE] == key.Parameters[FS_PARAMETER_TRUNCATE] &&
+          entry.Parameters[FS_PARAMETER_ALPHA] == key.Parameters[FS_PARAMETER_ALPHA] &&
+          entry.Parameters[FS_PARAMETER_USE_RAMP_TABLE] == key.Parameters[FS_PARAMETER_USE_RAMP_TABLE] &&
+          std::equal(&entry.FlatColors[0][0], &entry.FlatColors[0][0] + 8, &key.FlatColors[0][0]) &&
+          (update == nullptr || entry.LastUse > update->LastUse))
+        {
+        update = &entry;
+        }
+      }
 
-          output[n*outputIncrement*sizeof(unsigned char)] = (unsigned char)(rgb[0]*255.0);
-          output[n*outputIncrement*sizeof(unsigned char) + 1] = (unsigned char)(rgb[1]*255.0);
-          output[n*outputIncrement*sizeof(unsigned char) + 2] = (unsigned char)(rgb[2]*255.0);
-          if (outputIncrement == VTK_RGBA)
-            {
-            // opacity set to be always 1
-            output[n*outputIncrement*sizeof(unsigned char) + 3] = alpha;
-            }
+    if (hit == nullptr)
+      {
+      double band[2];
+      const double *updateBand = nullptr;
+      vtkColorCache::Entry *entry = update;
+      if (entry != nullptr)
+        {
+        // the grey part only stays if the offset didn't change
+        band[0] = -1.0;
+        if (entry->Parameters[FS_PARAMETER_OFFSET] == key.Parameters[FS_PARAMETER_OFFSET])
+          {
+          band[0] = std::min(entry->FlatBand[0], key.FlatBand[0]);
+          band[0] -= std::abs(band[0]) * FS_FLAT_BAND_MARGIN;
           }
-        break;
-      case VTK_UNSIGNED_CHAR:
-        vtkDebugMacro("Input data type is unsigned char.");
-        unsigned char *ucPtr;
-        unsigned char ucVal;
-        for (n = 0; n < numberOfValues; n++)
+        band[1] = std::max(entry->FlatBand[1], key.FlatBand[1]);
+        band[1] += band[1] * FS_FLAT_BAND_MARGIN;
+        updateBand = band;
+        }
+      else if (entries.size() < static_cast<size_t>(this->ColorCacheSize))
+        {
+        entries.emplace_back();
+        entry = &entries.back();
+        }
+      else
+        {
+        entry = &*std::min_element(entries.begin(), entries.end(),
+          [](const vtkColorCache::Entry& a, const vtkColorCache::Entry& b)
+          { return a.LastUse < b.LastUse; });
+        }
+
+      vtkSmartPointer<vtkUnsignedCharArray> colors;
+      if (entry->Colors != nullptr && entry->Colors->GetReferenceCount() == 1)
+        {
+        colors = entry->Colors;
+        }
+      else
+        {
+        // the previous colours are still used, don't change them
+        colors = vtkSmartPointer<vtkUnsignedCharArray>::New();
+        if (updateBand != nullptr)
           {
-          ucPtr = static_cast<unsigned char*>(input);
-          ucPtr += n*inputIncrement;
-          ucVal = *ucPtr;
-          const unsigned char *rgb8 = this->MapValue((double)ucVal);
-
-          // now save it to the output - unsigned char return guarantees it's 0-255
-          output[n*outputIncrement*sizeof(unsigned char)] = rgb8[0];
-          output[n*outputIncrement*sizeof(unsigned char) + 1] = rgb8[1];
-          output[n*outputIncrement*sizeof(unsigned char) + 2] = (unsigned char)rgb8[2];
-          if (outputIncrement == VTK_RGBA)
-            {
-            // opacity set to be always 1
-            output[n*outputIncrement*sizeof(unsigned char) + 3] = alpha;
-            }
+          colors->DeepCopy(entry->Colors);
           }
+        }
+      if (updateBand == nullptr)
+        {
+        colors->SetNumberOfComponents(outputFormat);
+        colors->SetNumberOfTuples(key.NumberOfValues);
+        }
+      vtkDebugMacro(<< "MapScalars: " << (updateBand == nullptr ? "mapping" : "updating")
+                    << " " << key.NumberOfValues << " values");
+      this->MapScalarsThroughScale(scalars->GetVoidPointer(0), colors->GetPointer(0),
+                                   key.DataType, key.NumberOfValues, 1, outputFormat,
+                                   updateBand);
+      key.Colors = colors;
+      *entry = key;
+      hit = entry;
+      }
+
+    hit->LastUse = ++this->ColorCache->UseCount;
+    // the caller owns the returned reference
+    hit->Colors->Register(this);
+    return hit->Colors;
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSLookupTable::GetRampTableRange(double range[2]) const
+{
+    if (!(this->Slope > 0.0) || !std::isfinite(this->Slope))
+      {
+      return false;
+      }
+    switch (this->LutType)
+      {
+      case FSLUTHEAT:
+      case FSLUTBLUERED:
+      case FSLUTREDBLUE:
+        {
+        // the colour doesn't change any more once |val| is above the low
+        // threshold, the mid point and the end of the slope
+        double limit = std::max(this->FMid + 1.0/this->Slope,
+                                std::max(static_cast<double>(this->FMid),
+                                         static_cast<double>(this->LowThresh)));
+        range[0] = -limit;
+        range[1] = limit;
+        break;
+        }
+      case FSLUTGREENRED:
+      case FSLUTREDGREEN:
+        // flat below the low threshold, above the high one, and where the
+        // tanh has saturated
+        range[0] = std::max(static_cast<double>(this->LowThresh),
+                            this->FMid - FS_TANH_SATURATION/this->Slope);
+        range[1] = std::min(static_cast<double>(this->HiThresh),
+                            this->FMid + FS_TANH_SATURATION/this->Slope);
         break;
       default:
-        vtkErrorMacro(<<"MapScalarsThroughTable2: Have no idea how to deal with this input type " << inputDataType);
+        return false;
+      }
+    return std::isfinite(range[0]) && std::isfinite(range[1]) && range[0] < range[1];
+}
+
+//------------------------------------------------------------------------------
+std::vector<double> vtkFSLookupTable::GetScaleParameters() const
+{
+    return {
+      static_cast<double>(this->LutType), this->LowThresh, this->HiThresh,
+      this->FMid, this->Slope, this->Offset, this->Blufact,
+      static_cast<double>(this->Reverse), static_cast<double>(this->Truncate),
+      this->Alpha, static_cast<double>(this->UseRampTable) };
+}
+
+//------------------------------------------------------------------------------
+bool vtkFSLookupTable::UpdateRampTable()
+{
+    std::vector<double> parameters = this->GetScaleParameters();
+    if (!this->RampTable.empty() && parameters == this->RampTableParameters)
+      {
+      return true;
+      }
+
+    this->RampTable.clear();
+    this->RampTableParameters.clear();
+    double range[2];
+    if (!this->GetRampTableRange(range))
+      {
+      return false;
       }
+
+    vtkDebugMacro(<< "UpdateRampTable: sampling " << this->GetLutTypeString() << " over " << range[0] << " to " << range[1]);
+    this->RampTable.resize(3 * static_cast<size_t>(FS_RAMP_TABLE_SIZE));
+    const double step = (range[1] - range[0]) / (FS_RAMP_TABLE_SIZE - 1);
+    unsigned char *ramp = this->RampTable.data();
+    vtkSMPTools::For(0, FS_RAMP_TABLE_SIZE, FS_LUT_GRAIN_SIZE,
+      [this, ramp, &range, step](vtkIdType begin, vtkIdType end)
+      {
+      unsigned char rgba[4];
+      for (vtkIdType i = begin; i < end; i++)
+        {
+        this->ComputeColor(range[0] + i*step, rgba);
+        std::copy(rgba, rgba + 3, ramp + 3*i);
+        }
+      });
+    this->RampTableRange[0] = range[0];
+    this->RampTableRange[1] = range[1];
+    this->RampTableParameters = parameters;
+    return true;
 }
 
 //----------------------------------------------------------------------------
@@ -576,6 +860,11 @@ void vtkFSLookupTable::DeepCopy(vtkScalarsToColors *obj)
   this->RGBA[1] = lut->RGBA[1];
   this->RGBA[2] = lut->RGBA[2];
   this->RGBA[3] = lut->RGBA[3];
+  this->UseRampTable = lut->UseRampTable;
+  this->RampTable.clear();
+  this->RampTableParameters.clear();
+  this->ColorCacheSize = lut->ColorCacheSize;
+  this->ColorCache->Entries.clear();
 
   this->Superclass::DeepCopy(obj);
 }
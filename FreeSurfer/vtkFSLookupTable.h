@@ -15,6 +15,10 @@
 
 // VTK includes
 #include <vtkLookupTable.h>
+#include <vtkVersion.h>
+
+// STD includes
+#include <vector>
 
 /// \brief A look up table for FreeSurfer colour scales.
 ///
@@ -70,6 +74,25 @@ public:
     vtkGetMacro(FMid,float);
     vtkSetMacro(FMid,float);
 
+    ///
+    /// If on, MapScalarsThroughTable2 samples the colour scale into a dense
+    /// table of FS_RAMP_TABLE_SIZE colours and maps each value with an index
+    /// computation instead of evaluating the scale. The table is rebuilt
+    /// when the scale parameters change. Values outside of the tabulated
+    /// range, where the scale is flat, are still evaluated. Off by default.
+    vtkGetMacro(UseRampTable,int);
+    vtkSetMacro(UseRampTable,int);
+    vtkBooleanMacro(UseRampTable,int);
+
+    ///
+    /// Number of mapped colour arrays MapScalars keeps, 0 to disable the
+    /// cache. Models sharing this table reuse the colours of an array that
+    /// was already mapped with the current parameters, and a heat scale
+    /// threshold change only recomputes the values between the old and new
+    /// flat parts of the scale. 8 by default.
+    vtkGetMacro(ColorCacheSize,int);
+    vtkSetMacro(ColorCacheSize,int);
+
     ///
     /// from vtkScalarsToColors
     double *GetRange() override;
@@ -80,15 +103,29 @@ public:
     void SetRange(double, double) override;
     ///
     /// Given a scalar value val, return an rgba color value
-    /// returns array of length 3, 0-255
+    /// returns array of length 3, 0-255. The array is overwritten by the
+    /// next call, use ComputeColor from several threads.
     const unsigned char *MapValue(double val) override;
     ///
+    /// Compute the rgba colour, 0-255, of val. Doesn't modify the table,
+    /// so it can be called from several threads at once.
+    void ComputeColor(double val, unsigned char rgba[4]) const;
+    ///
     /// passes val to MapValue
     void GetColor(double, double[3]) override;
     ///
-    /// take input scalars and push them through the calculation to get colours
-    /// to put int the output array
+    /// take input scalars of any type and push them through the calculation
+    /// to get colours to put int the output array, using several threads
     void MapScalarsThroughTable2(void* input, unsigned char* output, int inputDataType, int numberOfValues, int inputIncrement, int outputIncrement) override;
+    ///
+    /// Map single component scalars through the colour cache, see
+    /// ColorCacheSize. Other scalars are mapped by the superclass.
+    using Superclass::MapScalars;
+#if VTK_MAJOR_VERSION >= 9
+    vtkUnsignedCharArray *MapScalars(vtkAbstractArray *scalars, int colorMode, int component, int outputFormat = VTK_RGBA) override;
+#else
+    vtkUnsignedCharArray *MapScalars(vtkAbstractArray *scalars, int colorMode, int component) override;
+#endif
 
     ///
     /// Type constant, can have different types of colour scales
@@ -102,6 +139,13 @@ public:
       FSLUTGREENRED = 5,
     };
 
+    ///
+    /// Number of colours in the precomputed ramp table
+    enum
+    {
+      FS_RAMP_TABLE_SIZE = 65536,
+    };
+
     // Description:
     // Get the number of available colors for mapping to.
     vtkIdType GetNumberOfAvailableColors() override;
@@ -153,9 +197,48 @@ protected:
     float FMid;
 
     ///
-    /// output of colour computation
+    /// output of MapValue
     unsigned char RGBA[4];
 
+    ///
+    /// map values through the precomputed ramp table
+    int UseRampTable;
+
+    ///
+    /// RGB colours of FS_RAMP_TABLE_SIZE evenly spaced values over
+    /// RampTableRange, and the scale parameters they were computed with
+    std::vector<unsigned char> RampTable;
+    double RampTableRange[2];
+    std::vector<double> RampTableParameters;
+
+    ///
+    /// Rebuild the ramp table if the scale parameters changed since it was
+    /// last built. Returns false if the current scale can't be tabulated.
+    bool UpdateRampTable();
+
+    ///
+    /// Values outside of which the current scale is flat, or false if it
+    /// has no such finite range.
+    bool GetRampTableRange(double range[2]) const;
+
+    ///
+    /// Parameters the colour of a value depends on, to detect changes
+    std::vector<double> GetScaleParameters() const;
+
+    ///
+    /// Map numberOfValues scalars to colours. If updateBand isn't null,
+    /// only the values whose magnitude is within it are written.
+    void MapScalarsThroughScale(void* input, unsigned char* output,
+                                int inputDataType, vtkIdType numberOfValues,
+                                int inputIncrement, int outputIncrement,
+                                const double* updateBand);
+
+    ///
+    /// colours of the last mapped arrays
+    class vtkColorCache;
+    vtkColorCache *ColorCache;
+    int ColorCacheSize;
+
 private:
   vtkFSLookupTable(const vtkFSLookupTable&) = delete;
   void operator=(const vtkFSLookupTable&) = delete;
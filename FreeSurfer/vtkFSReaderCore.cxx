@@ -0,0 +1,1781 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2006 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include "vtkFSReaderCore.h"
+#include "vtkFSSurfaceHelper.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSMPTools.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <locale>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+/// Number of scalar values decoded at once by one thread, small enough for
+/// the values to stay in cache between the byte swap and the range update.
+const size_t FS_SCALAR_CHUNK_SIZE = 16 * 1024;
+
+/// Size in bytes of one w-file index/value pair: a three byte int and a
+/// float.
+const size_t FS_W_PAIR_SIZE = 7;
+
+/// Minimum number of w-file pairs decoded by one thread.
+const vtkIdType FS_W_DECODE_GRAIN_SIZE = 16 * 1024;
+
+/// Minimum number of label rows parsed by one thread.
+const vtkIdType FS_LABEL_PARSE_GRAIN_SIZE = 4096;
+
+/// Minimum number of surface values decoded by one thread.
+const vtkIdType FS_DECODE_GRAIN_SIZE = 64 * 1024;
+
+/// Minimum number of annotation vertices looked up by one thread.
+const vtkIdType FS_ANNOTATION_GRAIN_SIZE = 16 * 1024;
+
+/// Number of parsed text color tables kept by GetSharedColorTable. A
+/// session rarely uses more than the default LUT and a few annotation
+/// tables.
+const size_t FS_SHARED_COLOR_TABLE_COUNT = 4;
+
+//----------------------------------------------------------------------------
+vtkFSIO::ReadStatus MakeError(int errorCode, const std::string& message)
+{
+  vtkFSIO::ReadStatus status;
+  status.ErrorCode = errorCode;
+  status.Message = message;
+  return status;
+}
+
+//----------------------------------------------------------------------------
+// Open fileName, which may be gzip compressed.
+bool OpenStream(const char* fileName, vtkFSIO::InputStream& stream, vtkFSIO::ReadStatus& status)
+{
+  if (fileName == nullptr)
+    {
+    status = MakeError(vtkFSIO::FS_READ_ERROR_NO_FILENAME, "FileName not specified.");
+    return false;
+    }
+  if (!stream.Open(fileName))
+    {
+    status = MakeError(vtkFSIO::FS_READ_ERROR_OPEN, std::string("Could not open file ") + fileName);
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Check that count values of valueSize bytes may still be in the stream,
+// before allocating for a count read from the file.
+bool FitsInStream(vtkFSIO::InputStream& stream, size_t count, size_t valueSize)
+{
+  return count <= stream.GetMaximumRemainingSize() / valueSize;
+}
+
+//----------------------------------------------------------------------------
+// Byte swap a block of big-endian floats in place and compute its range
+// (NaN values are ignored) in the same pass over each chunk. Chunks are
+// decoded concurrently.
+void DecodeScalarBlock(float* values, size_t numValues, float range[2])
+{
+  const vtkIdType numChunks =
+    static_cast<vtkIdType>((numValues + FS_SCALAR_CHUNK_SIZE - 1) / FS_SCALAR_CHUNK_SIZE);
+  std::vector<float> chunkRanges(2 * numChunks);
+  float* chunkRange = chunkRanges.data();
+  vtkSMPTools::For(0, numChunks, 1, [=](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType chunk = begin; chunk < end; chunk++)
+      {
+      const size_t offset = static_cast<size_t>(chunk) * FS_SCALAR_CHUNK_SIZE;
+      float* first = values + offset;
+      const size_t count = std::min(FS_SCALAR_CHUNK_SIZE, numValues - offset);
+      vtkFSIO::DecodeFloatArray (first, first, count);
+      float minValue = std::numeric_limits<float>::infinity();
+      float maxValue = -std::numeric_limits<float>::infinity();
+      for (size_t i = 0; i < count; i++)
+        {
+        minValue = first[i] < minValue ? first[i] : minValue;
+        maxValue = first[i] > maxValue ? first[i] : maxValue;
+        }
+      chunkRange[2 * chunk] = minValue;
+      chunkRange[2 * chunk + 1] = maxValue;
+      }
+    });
+  range[0] = std::numeric_limits<float>::infinity();
+  range[1] = -std::numeric_limits<float>::infinity();
+  for (vtkIdType chunk = 0; chunk < numChunks; chunk++)
+    {
+    range[0] = std::min(range[0], chunkRange[2 * chunk]);
+    range[1] = std::max(range[1], chunkRange[2 * chunk + 1]);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Skip whitespace, including newlines, the way fscanf does between values.
+const char* SkipWhitespace(const char* text, const char* end)
+{
+  while (text < end && isspace(static_cast<unsigned char>(*text)))
+    {
+    ++text;
+    }
+  return text;
+}
+
+//----------------------------------------------------------------------------
+bool IsSurfaceMagicNumber(int magicNumber)
+{
+  return magicNumber == vtkFSIO::FS_QUAD_FILE_MAGIC_NUMBER ||
+         magicNumber == vtkFSIO::FS_NEW_QUAD_FILE_MAGIC_NUMBER ||
+         magicNumber == vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER;
+}
+
+//----------------------------------------------------------------------------
+std::string WrongSurfaceTypeMessage(const char* fileName, int magicNumber)
+{
+  std::ostringstream message;
+  message << "Wrong file type when loading " << fileName << "\n magic number = " << magicNumber
+          << ". Supported are " << vtkFSIO::FS_QUAD_FILE_MAGIC_NUMBER << ", "
+          << vtkFSIO::FS_NEW_QUAD_FILE_MAGIC_NUMBER << ", and "
+          << vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER;
+  return message.str();
+}
+
+//----------------------------------------------------------------------------
+bool IsGzipData(const unsigned char* data, size_t size)
+{
+  return size >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
+
+//----------------------------------------------------------------------------
+// If quad files, there are four vertices per face, in tri files,
+// there are three.
+int GetNumberOfVerticesPerFace(int magicNumber)
+{
+  return magicNumber == vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER ?
+    vtkFSIO::FS_NUM_VERTS_IN_TRI_FACE :
+    vtkFSIO::FS_NUM_VERTS_IN_QUAD_FACE;
+}
+
+//----------------------------------------------------------------------------
+// Size in bytes of one stored vertex coordinate and one stored face index.
+size_t GetVertexValueSize(int magicNumber)
+{
+  return magicNumber == vtkFSIO::FS_QUAD_FILE_MAGIC_NUMBER ? 2 : 4;
+}
+
+size_t GetFaceValueSize(int magicNumber)
+{
+  return magicNumber == vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER ? 4 : 3;
+}
+
+//----------------------------------------------------------------------------
+// Decode numVertices consecutive raw big-endian x y z tuples into
+// locations, applying transform (a 3x4 row major affine) if given. The new
+// quad and triangle formats may be decoded in place (raw == locations).
+void DecodeVertices(bool oldQuad, const unsigned char* raw, float* locations,
+                    vtkIdType numVertices, const double* transform)
+{
+  float* p = locations;
+  const vtkIdType numValues = 3 * numVertices;
+  if (oldQuad)
+    {
+    // Old quad files store two byte ints in hundredths of millimeters.
+    const unsigned char* b = raw;
+    for (vtkIdType i = 0; i < numValues; i++, b += 2)
+      {
+      p[i] = static_cast<short>((b[0] << 8) | b[1]) / 100.0f;
+      }
+    }
+  else
+    {
+    vtkFSIO::DecodeFloatArray(raw, p, numValues);
+    }
+  if (transform)
+    {
+    const double* m = transform;
+    for (vtkIdType i = 0; i < numValues; i += 3)
+      {
+      const double x = p[i];
+      const double y = p[i + 1];
+      const double z = p[i + 2];
+      p[i]     = static_cast<float>(m[0] * x + m[1] * y + m[2]  * z + m[3]);
+      p[i + 1] = static_cast<float>(m[4] * x + m[5] * y + m[6]  * z + m[7]);
+      p[i + 2] = static_cast<float>(m[8] * x + m[9] * y + m[10] * z + m[11]);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Decode a raw big-endian vertex block of numVertices x y z tuples into
+// locations. Every vertex is independent of the others, so the block is
+// split into chunks that are decoded concurrently.
+void DecodeVertexBlock(int magicNumber, const unsigned char* raw,
+                       float* locations, size_t numVertices,
+                       const double* transform = nullptr)
+{
+  const bool oldQuad = vtkFSIO::FS_QUAD_FILE_MAGIC_NUMBER == magicNumber;
+  const size_t vertexSize = 3 * GetVertexValueSize(magicNumber);
+  vtkSMPTools::For(0, static_cast<vtkIdType>(numVertices), FS_DECODE_GRAIN_SIZE / 3,
+    [raw, locations, oldQuad, vertexSize, transform](vtkIdType begin, vtkIdType end)
+    {
+    DecodeVertices(oldQuad, raw + vertexSize * begin, locations + 3 * begin, end - begin, transform);
+    });
+}
+
+//----------------------------------------------------------------------------
+// Decode a raw big-endian face block into faceData, in parallel chunks.
+// Triangle files may be decoded in place (raw == faceData).
+void DecodeFaceBlock(int magicNumber, const unsigned char* raw,
+                     int* faceData, size_t numValues)
+{
+  if (vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER == magicNumber)
+    {
+    vtkSMPTools::For(0, static_cast<vtkIdType>(numValues), FS_DECODE_GRAIN_SIZE,
+      [raw, faceData](vtkIdType begin, vtkIdType end)
+      {
+      vtkFSIO::DecodeIntArray(raw + 4 * begin, faceData + begin, end - begin);
+      });
+    }
+  else
+    {
+    vtkSMPTools::For(0, static_cast<vtkIdType>(numValues), FS_DECODE_GRAIN_SIZE,
+      [raw, faceData](vtkIdType begin, vtkIdType end)
+      {
+      vtkFSIO::DecodeInt3Array(raw + 3 * begin, faceData + begin, end - begin);
+      });
+    }
+}
+
+//----------------------------------------------------------------------------
+// Check in parallel chunks that every decoded face index is a vertex of
+// the file.
+bool AreFaceIndicesValid(const int* faceData, size_t numValues, int numVertices)
+{
+  std::atomic<bool> valid(true);
+  vtkSMPTools::For(0, static_cast<vtkIdType>(numValues), FS_DECODE_GRAIN_SIZE,
+    [faceData, numVertices, &valid](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      if (faceData[i] < 0 || faceData[i] >= numVertices)
+        {
+        valid = false;
+        return;
+        }
+      }
+    });
+  return valid;
+}
+
+//----------------------------------------------------------------------------
+std::string InvalidFaceMessage(const char* fileName, int numVertices)
+{
+  std::ostringstream message;
+  message << "Faces of " << fileName << " use vertices out of the "
+          << numVertices << " vertices of the file";
+  return message.str();
+}
+
+//----------------------------------------------------------------------------
+// Faces [first, last) of piece out of numPieces, in file order.
+void GetPieceFaceRange(int numFaces, int piece, int numPieces, size_t& first, size_t& last)
+{
+  if (piece < 0 || piece >= numPieces)
+    {
+    first = last = 0;
+    return;
+    }
+  first = static_cast<size_t>(static_cast<long long>(numFaces) * piece / numPieces);
+  last = static_cast<size_t>(static_cast<long long>(numFaces) * (piece + 1) / numPieces);
+}
+
+//----------------------------------------------------------------------------
+// Decode the numPieceFaces faces at rawPieceFaces and only the vertices
+// they use out of the raw vertex block, which holds all numVertices
+// vertices of the file. The vertices keep their file order and the faces
+// are renumbered to them; data.PointIds maps them back to the file.
+// Returns FS_READ_ERROR_FORMAT if a face uses a vertex out of the file.
+int DecodeSurfacePiece(int magicNumber, const unsigned char* rawVertices, int numVertices,
+                       const unsigned char* rawPieceFaces, size_t numPieceFaces,
+                       const double* transform, vtkFSIO::SurfaceData& data)
+{
+  const int numVerticesPerFace = GetNumberOfVerticesPerFace(magicNumber);
+  const size_t numFaceValues = numPieceFaces * numVerticesPerFace;
+  if (!data.Faces.Allocate(numFaceValues))
+    {
+    return vtkFSIO::FS_READ_ERROR_ALLOC;
+    }
+  int* faces = data.Faces.GetData();
+  DecodeFaceBlock(magicNumber, rawPieceFaces, faces, numFaceValues);
+  if (!AreFaceIndicesValid(faces, numFaceValues, numVertices))
+    {
+    data.Faces.Allocate(0);
+    return vtkFSIO::FS_READ_ERROR_FORMAT;
+    }
+
+  // Number the vertices used by the piece in file order.
+  std::vector<int> pieceIndex(static_cast<size_t>(numVertices), -1);
+  for (size_t i = 0; i < numFaceValues; i++)
+    {
+    pieceIndex[faces[i]] = 0;
+    }
+  int numPieceVertices = 0;
+  for (int& index : pieceIndex)
+    {
+    if (index == 0)
+      {
+      index = numPieceVertices++;
+      }
+    }
+  if (!data.PointIds.Allocate(numPieceVertices) ||
+      !data.Points.Allocate(3 * static_cast<size_t>(numPieceVertices)))
+    {
+    return vtkFSIO::FS_READ_ERROR_ALLOC;
+    }
+  int* pointIds = data.PointIds.GetData();
+  for (int v = 0; v < numVertices; v++)
+    {
+    if (pieceIndex[v] >= 0)
+      {
+      pointIds[pieceIndex[v]] = v;
+      }
+    }
+
+  const int* index = pieceIndex.data();
+  vtkSMPTools::For(0, static_cast<vtkIdType>(numFaceValues), FS_DECODE_GRAIN_SIZE,
+    [faces, index](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      faces[i] = index[faces[i]];
+      }
+    });
+
+  const bool oldQuad = vtkFSIO::FS_QUAD_FILE_MAGIC_NUMBER == magicNumber;
+  const size_t vertexSize = 3 * GetVertexValueSize(magicNumber);
+  float* locations = data.Points.GetData();
+  vtkSMPTools::For(0, numPieceVertices, FS_DECODE_GRAIN_SIZE / 3,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType v = begin; v < end; v++)
+      {
+      DecodeVertices(oldQuad, rawVertices + vertexSize * pointIds[v], locations + 3 * v, 1, transform);
+      }
+    });
+
+  data.NumberOfVertices = numPieceVertices;
+  data.NumberOfFaces = static_cast<int>(numPieceFaces);
+  data.NumberOfVerticesPerFace = numVerticesPerFace;
+  return vtkFSIO::FS_READ_OK;
+}
+
+//----------------------------------------------------------------------------
+// Read and drop size bytes of a stream, a block at a time.
+bool SkipBytes(vtkFSIO::InputStream& stream, size_t size)
+{
+  std::vector<unsigned char> block(std::min<size_t>(size, 1 << 20));
+  while (size > 0)
+    {
+    const size_t blockSize = std::min(size, block.size());
+    if (stream.Read(block.data(), blockSize) != blockSize)
+      {
+      return false;
+      }
+    size -= blockSize;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Split a "key = value" footer line. Returns false if the line has no
+// separator or if its key is none of the given ones.
+bool SplitVolumeGeometryLine(const char* line, const char* key, const char* alternateKey,
+                             std::string& value)
+{
+  const char* separator = strchr(line, '=');
+  if (separator == nullptr)
+    {
+    return false;
+    }
+  const char* keyBegin = line;
+  const char* keyEnd = separator;
+  while (keyBegin < keyEnd && isspace(static_cast<unsigned char>(*keyBegin)))
+    {
+    keyBegin++;
+    }
+  while (keyEnd > keyBegin && isspace(static_cast<unsigned char>(keyEnd[-1])))
+    {
+    keyEnd--;
+    }
+  const std::string name(keyBegin, keyEnd);
+  if (name != key && (alternateKey == nullptr || name != alternateKey))
+    {
+    return false;
+    }
+  value = separator + 1;
+  const size_t first = value.find_first_not_of(" \t");
+  const size_t last = value.find_last_not_of(" \t\r\n");
+  value = first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Parse three numbers, independently of the current locale.
+template <typename T>
+bool ParseVolumeGeometryVector(const std::string& value, T vector[3])
+{
+  std::istringstream stream(value);
+  stream.imbue(std::locale::classic());
+  return static_cast<bool>(stream >> vector[0] >> vector[1] >> vector[2]);
+}
+
+//----------------------------------------------------------------------------
+// Read the volume geometry footer of a triangle file. readInt(int&) reads
+// one big-endian int and getLine(char*, int) reads one text line, both
+// returning false at the end of the data. The footer starts with the tag
+// 20, or with the sequence 2 0 20 (2 1 20) in files written by older
+// versions of FreeSurfer. Returns false if there is no footer or if it
+// can't be parsed.
+template <typename IntReader, typename LineReader>
+bool ReadVolumeGeometry(IntReader readInt, LineReader getLine, vtkFSIO::VolumeGeometry& geometry)
+{
+  const int FS_TAG_OLD_SURF_GEOM = 20;
+  int tag = 0;
+  if (!readInt(tag))
+    {
+    return false;
+    }
+  if (tag != FS_TAG_OLD_SURF_GEOM)
+    {
+    int flag = 0;
+    if (tag != 2 || !readInt(flag) || (flag != 0 && flag != 1) ||
+        !readInt(tag) || tag != FS_TAG_OLD_SURF_GEOM)
+      {
+      return false;
+      }
+    }
+
+  char line[1024];
+  std::string value;
+  if (!getLine(line, sizeof(line)) || !SplitVolumeGeometryLine(line, "valid", nullptr, value))
+    {
+    return false;
+    }
+  geometry.Valid = atoi(value.c_str()) != 0;
+  if (!getLine(line, sizeof(line)) || !SplitVolumeGeometryLine(line, "filename", nullptr, value))
+    {
+    return false;
+    }
+  geometry.FileName = value;
+  if (!getLine(line, sizeof(line)) || !SplitVolumeGeometryLine(line, "volume", nullptr, value) ||
+      !ParseVolumeGeometryVector(value, geometry.Dimensions))
+    {
+    return false;
+    }
+  const char* keys[5] = { "voxelsize", "xras", "yras", "zras", "cras" };
+  double* vectors[5] = { geometry.VoxelSize, geometry.XRAS, geometry.YRAS, geometry.ZRAS, geometry.CRAS };
+  for (int i = 0; i < 5; i++)
+    {
+    // FreeSurfer writes the center as "c_ras", nibabel as "cras".
+    if (!getLine(line, sizeof(line)) ||
+        !SplitVolumeGeometryLine(line, keys[i], i == 4 ? "c_ras" : nullptr, value) ||
+        !ParseVolumeGeometryVector(value, vectors[i]))
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Read the header and the vertex and face blocks of an open surface file,
+// which may be gzip compressed. The volume geometry footer of triangle
+// files is read first; both blocks are only decoded afterwards so that, if
+// applyScannerTransform is set and the geometry is valid, the vertices can
+// be moved to scanner RAS while they are decoded. If a piece is requested,
+// the faces out of it are skipped instead of stored.
+vtkFSIO::ReadStatus ReadSurfaceStream(const char* fileName, vtkFSIO::InputStream& surfaceFile,
+                                      const vtkFSIO::SurfaceReadOptions& options,
+                                      vtkFSIO::SurfaceData& data)
+{
+  int& magicNumber = data.MagicNumber;
+  int numVertices = 0;
+  int numFaces = 0;
+  char line[256];
+  std::ostringstream message;
+
+  // Get the three byte magic number. We support three file types.
+  vtkFSIO::ReadInt3 (surfaceFile, magicNumber);
+  if (!IsSurfaceMagicNumber(magicNumber))
+    {
+    return MakeError(vtkFSIO::FS_READ_ERROR_FORMAT, WrongSurfaceTypeMessage(fileName, magicNumber));
+    }
+
+  // Triangle file has some kind of header string at the
+  // beginning. Skip it.
+  if (vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER == magicNumber)
+    {
+    surfaceFile.GetLine (line, 200);
+    surfaceFile.SkipWhitespace ();
+    }
+
+  // Triangle files use normal ints to store their number of vertices
+  // and faces, while quad files use three byte ints.
+  if (vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER == magicNumber)
+    {
+    if (vtkFSIO::ReadInt (surfaceFile, numVertices) != 1 ||
+        vtkFSIO::ReadInt (surfaceFile, numFaces) != 1)
+      {
+      message << "Error reading number of vertices and faces from " << fileName;
+      return MakeError(vtkFSIO::FS_READ_ERROR_EOF, message.str());
+      }
+    }
+  else
+    {
+    vtkFSIO::ReadInt3 (surfaceFile, numVertices);
+    vtkFSIO::ReadInt3 (surfaceFile, numFaces);
+    }
+
+  if (numVertices < 0 || numFaces < 0)
+    {
+    message << "Invalid number of vertices (" << numVertices << ") or faces (" << numFaces << ") in " << fileName;
+    return MakeError(vtkFSIO::FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+  // compared with the sizes below
+  const size_t numFileFaces = static_cast<size_t>(numFaces);
+
+  // Read the whole vertex block at once. The new quad and triangle
+  // formats store floats, which are read straight into the points to be
+  // decoded in place, unless only the vertices of a piece are kept.
+  const bool readPiece = options.NumberOfPieces > 1;
+  const int numVerticesPerFace = GetNumberOfVerticesPerFace(magicNumber);
+  const size_t numVertexValues = 3 * static_cast<size_t>(numVertices);
+  const size_t vertexBlockSize = numVertexValues * GetVertexValueSize(magicNumber);
+  const size_t faceSize = numVerticesPerFace * GetFaceValueSize(magicNumber);
+  const size_t remainingSize = surfaceFile.GetMaximumRemainingSize();
+  if (vertexBlockSize > remainingSize ||
+      numFileFaces > (remainingSize - vertexBlockSize) / faceSize)
+    {
+    message << "Unexpected end of file in " << fileName << ": expected " << numVertices << " vertices and " << numFaces << " faces";
+    return MakeError(vtkFSIO::FS_READ_ERROR_EOF, message.str());
+    }
+  if (!readPiece && !data.Points.Allocate(numVertexValues))
+    {
+    message << "Error allocating " << numVertices << " vertices for " << fileName;
+    return MakeError(vtkFSIO::FS_READ_ERROR_ALLOC, message.str());
+    }
+  vtkFSIO::Buffer<unsigned char> rawVertexValues;
+  unsigned char* rawVertices = reinterpret_cast<unsigned char*>(data.Points.GetData());
+  if (readPiece || vtkFSIO::FS_QUAD_FILE_MAGIC_NUMBER == magicNumber)
+    {
+    if (!rawVertexValues.Allocate(vertexBlockSize))
+      {
+      message << "Error allocating " << numVertices << " vertices for " << fileName;
+      return MakeError(vtkFSIO::FS_READ_ERROR_ALLOC, message.str());
+      }
+    rawVertices = rawVertexValues.GetData();
+    }
+  size_t numBytesRead = surfaceFile.Read (rawVertices, vertexBlockSize);
+  if (numBytesRead != vertexBlockSize)
+    {
+    message << "Unexpected end of file after " << numBytesRead / (3 * GetVertexValueSize(magicNumber)) << " of " << numVertices << " vertices in " << fileName;
+    return MakeError(vtkFSIO::FS_READ_ERROR_EOF, message.str());
+    }
+
+  // Same for the face block. Triangle format gets normal ints, read in
+  // place, quad formats get three byte ints. Only the faces of the piece
+  // are kept; the others still have to be read past to get to the footer.
+  size_t firstFace = 0;
+  size_t lastFace = numFileFaces;
+  if (readPiece)
+    {
+    GetPieceFaceRange(numFaces, options.Piece, options.NumberOfPieces, firstFace, lastFace);
+    }
+  const size_t numFaceValues = (lastFace - firstFace) * numVerticesPerFace;
+  const size_t faceBlockSize = (lastFace - firstFace) * faceSize;
+  if (!readPiece && !data.Faces.Allocate(numFaceValues))
+    {
+    message << "Error allocating " << numFaces << " faces for " << fileName;
+    return MakeError(vtkFSIO::FS_READ_ERROR_ALLOC, message.str());
+    }
+  vtkFSIO::Buffer<unsigned char> rawFaceValues;
+  unsigned char* rawFaces = reinterpret_cast<unsigned char*>(data.Faces.GetData());
+  if (readPiece || vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER != magicNumber)
+    {
+    if (!rawFaceValues.Allocate(faceBlockSize))
+      {
+      message << "Error allocating " << numFaces << " faces for " << fileName;
+      return MakeError(vtkFSIO::FS_READ_ERROR_ALLOC, message.str());
+      }
+    rawFaces = rawFaceValues.GetData();
+    }
+  size_t numFacesRead = 0;
+  if (SkipBytes(surfaceFile, firstFace * faceSize))
+    {
+    numFacesRead = firstFace + surfaceFile.Read (rawFaces, faceBlockSize) / faceSize;
+    }
+  // Quad files end with their faces, the footer of triangle files comes
+  // after the last one.
+  if (numFacesRead == lastFace && vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER == magicNumber &&
+      SkipBytes(surfaceFile, (numFileFaces - lastFace) * faceSize))
+    {
+    numFacesRead = numFileFaces;
+    }
+  if (numFacesRead != (vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER == magicNumber ? numFileFaces : lastFace))
+    {
+    message << "Unexpected end of file after " << numFacesRead << " of " << numFaces << " faces in " << fileName;
+    return MakeError(vtkFSIO::FS_READ_ERROR_EOF, message.str());
+    }
+
+  // A missing or unreadable footer is not an error, the surface is just
+  // left in tkreg coordinates.
+  if (vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER == magicNumber)
+    {
+    ReadVolumeGeometry(
+      [&surfaceFile](int& value) { return vtkFSIO::ReadInt (surfaceFile, value) == 1; },
+      [&surfaceFile](char* buffer, int size) { return surfaceFile.GetLine (buffer, size) != nullptr; },
+      data.Geometry);
+    }
+
+  double transform[12];
+  const bool transformVertices = options.ApplyScannerTransform && vtkFSIO::GetScannerTransform(data.Geometry, transform);
+  if (readPiece)
+    {
+    const int errorCode = DecodeSurfacePiece(magicNumber, rawVertices, numVertices, rawFaces,
+      lastFace - firstFace, transformVertices ? transform : nullptr, data);
+    if (errorCode == vtkFSIO::FS_READ_ERROR_FORMAT)
+      {
+      return MakeError(errorCode, InvalidFaceMessage(fileName, numVertices));
+      }
+    if (errorCode != vtkFSIO::FS_READ_OK)
+      {
+      message << "Error allocating piece " << options.Piece << " of " << fileName;
+      return MakeError(errorCode, message.str());
+      }
+    return vtkFSIO::ReadStatus();
+    }
+  DecodeFaceBlock(magicNumber, rawFaces, data.Faces.GetData(), numFaceValues);
+  if (!AreFaceIndicesValid(data.Faces.GetData(), numFaceValues, numVertices))
+    {
+    data.Points.Allocate(0);
+    data.Faces.Allocate(0);
+    return MakeError(vtkFSIO::FS_READ_ERROR_FORMAT, InvalidFaceMessage(fileName, numVertices));
+    }
+  DecodeVertexBlock(magicNumber, rawVertices, data.Points.GetData(), numVertices,
+                    transformVertices ? transform : nullptr);
+  data.NumberOfVertices = numVertices;
+  data.NumberOfFaces = numFaces;
+  data.NumberOfVerticesPerFace = numVerticesPerFace;
+  return vtkFSIO::ReadStatus();
+}
+
+//----------------------------------------------------------------------------
+// Same as ReadSurfaceStream, but decodes the header and the blocks straight
+// out of a memory mapping of the file. The vertex floats are byte swapped
+// into their final buffer and never go through a stdio buffer. A piece
+// only touches the pages of its faces and of the vertices they use.
+vtkFSIO::ReadStatus ReadMappedSurface(const char* fileName, const vtkFSIO::MappedFile& surfaceFile,
+                                      const vtkFSIO::SurfaceReadOptions& options,
+                                      vtkFSIO::SurfaceData& data)
+{
+  const unsigned char* mapped = surfaceFile.GetData();
+  const size_t size = surfaceFile.GetSize();
+  size_t offset = 0;
+  int& magicNumber = data.MagicNumber;
+  int numVertices = 0;
+  int numFaces = 0;
+  std::ostringstream message;
+
+  if (size < 3)
+    {
+    message << "File " << fileName << " is too small to be a surface file";
+    return MakeError(vtkFSIO::FS_READ_ERROR_EOF, message.str());
+    }
+  vtkFSIO::DecodeInt3Array (mapped, &magicNumber, 1);
+  offset = 3;
+  if (!IsSurfaceMagicNumber(magicNumber))
+    {
+    return MakeError(vtkFSIO::FS_READ_ERROR_FORMAT, WrongSurfaceTypeMessage(fileName, magicNumber));
+    }
+
+  // Skip the triangle file header string the same way the stream path
+  // does: up to and including the first newline, then any whitespace.
+  if (vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER == magicNumber)
+    {
+    while (offset < size && mapped[offset] != '\n')
+      {
+      offset++;
+      }
+    while (offset < size && isspace(mapped[offset]))
+      {
+      offset++;
+      }
+    }
+
+  const size_t countSize = GetFaceValueSize(magicNumber);
+  if (size - offset < 2 * countSize)
+    {
+    message << "Error reading number of vertices and faces from " << fileName;
+    return MakeError(vtkFSIO::FS_READ_ERROR_EOF, message.str());
+    }
+  if (countSize == 4)
+    {
+    vtkFSIO::DecodeIntArray (mapped + offset, &numVertices, 1);
+    vtkFSIO::DecodeIntArray (mapped + offset + 4, &numFaces, 1);
+    }
+  else
+    {
+    vtkFSIO::DecodeInt3Array (mapped + offset, &numVertices, 1);
+    vtkFSIO::DecodeInt3Array (mapped + offset + 3, &numFaces, 1);
+    }
+  offset += 2 * countSize;
+
+  if (numVertices < 0 || numFaces < 0)
+    {
+    message << "Invalid number of vertices (" << numVertices << ") or faces (" << numFaces << ") in " << fileName;
+    return MakeError(vtkFSIO::FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+
+  // Both blocks have a fixed size, so the whole file can be validated
+  // before anything is decoded.
+  const int numVerticesPerFace = GetNumberOfVerticesPerFace(magicNumber);
+  const size_t numVertexValues = 3 * static_cast<size_t>(numVertices);
+  const size_t numFaceValues = static_cast<size_t>(numFaces) * numVerticesPerFace;
+  const size_t vertexBlockSize = numVertexValues * GetVertexValueSize(magicNumber);
+  const size_t faceBlockSize = numFaceValues * countSize;
+  if (size - offset < vertexBlockSize || size - offset - vertexBlockSize < faceBlockSize)
+    {
+    message << "Unexpected end of file in " << fileName << ": expected " << numVertices << " vertices and " << numFaces << " faces";
+    return MakeError(vtkFSIO::FS_READ_ERROR_EOF, message.str());
+    }
+
+  const unsigned char* rawVertices = mapped + offset;
+  const unsigned char* rawFaces = rawVertices + vertexBlockSize;
+  offset += vertexBlockSize + faceBlockSize;
+
+  if (vtkFSIO::FS_TRIANGLE_FILE_MAGIC_NUMBER == magicNumber)
+    {
+    ReadVolumeGeometry(
+      [mapped, size, &offset](int& value)
+      {
+      if (size - offset < 4)
+        {
+        return false;
+        }
+      vtkFSIO::DecodeIntArray (mapped + offset, &value, 1);
+      offset += 4;
+      return true;
+      },
+      [mapped, size, &offset](char* buffer, int bufferSize)
+      {
+      // Same as fgets: up to and including the newline.
+      int length = 0;
+      while (offset < size && length < bufferSize - 1)
+        {
+        buffer[length++] = static_cast<char>(mapped[offset++]);
+        if (buffer[length - 1] == '\n')
+          {
+          break;
+          }
+        }
+      buffer[length] = '\0';
+      return length > 0;
+      },
+      data.Geometry);
+    }
+
+  double transform[12];
+  const bool transformVertices = options.ApplyScannerTransform && vtkFSIO::GetScannerTransform(data.Geometry, transform);
+  if (options.NumberOfPieces > 1)
+    {
+    size_t firstFace = 0;
+    size_t lastFace = 0;
+    GetPieceFaceRange(numFaces, options.Piece, options.NumberOfPieces, firstFace, lastFace);
+    const int errorCode = DecodeSurfacePiece(magicNumber, rawVertices, numVertices,
+      rawFaces + firstFace * numVerticesPerFace * countSize, lastFace - firstFace,
+      transformVertices ? transform : nullptr, data);
+    if (errorCode == vtkFSIO::FS_READ_ERROR_FORMAT)
+      {
+      return MakeError(errorCode, InvalidFaceMessage(fileName, numVertices));
+      }
+    if (errorCode != vtkFSIO::FS_READ_OK)
+      {
+      message << "Error allocating piece " << options.Piece << " of " << fileName;
+      return MakeError(errorCode, message.str());
+      }
+    return vtkFSIO::ReadStatus();
+    }
+  if (!data.Points.Allocate(numVertexValues) || !data.Faces.Allocate(numFaceValues))
+    {
+    message << "Error allocating " << numVertices << " vertices and " << numFaces << " faces for " << fileName;
+    return MakeError(vtkFSIO::FS_READ_ERROR_ALLOC, message.str());
+    }
+  DecodeFaceBlock(magicNumber, rawFaces, data.Faces.GetData(), numFaceValues);
+  if (!AreFaceIndicesValid(data.Faces.GetData(), numFaceValues, numVertices))
+    {
+    data.Points.Allocate(0);
+    data.Faces.Allocate(0);
+    return MakeError(vtkFSIO::FS_READ_ERROR_FORMAT, InvalidFaceMessage(fileName, numVertices));
+    }
+  DecodeVertexBlock(magicNumber, rawVertices, data.Points.GetData(), numVertices,
+                    transformVertices ? transform : nullptr);
+  data.NumberOfVertices = numVertices;
+  data.NumberOfFaces = numFaces;
+  data.NumberOfVerticesPerFace = numVerticesPerFace;
+  return vtkFSIO::ReadStatus();
+}
+
+//----------------------------------------------------------------------------
+// Pack r, g, b the way annotation files store vertex colors. Returns -1 if
+// a component is out of the 0-255 range, as no vertex color can match it.
+int PackRGB(int r, int g, int b)
+{
+  if (r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255)
+    {
+    return -1;
+    }
+  return r | (g << 8) | (b << 16);
+}
+
+//----------------------------------------------------------------------------
+// Read a length prefixed string, as used for names in embedded color tables.
+bool ReadString(vtkFSIO::InputStream& stream, vtkFSIO::Buffer<char>& oString)
+{
+  int length = 0;
+  if (vtkFSIO::ReadInt(stream, length) != 1 || length < 0 ||
+      !FitsInStream(stream, length, 1) || !oString.Allocate(length))
+    {
+    return false;
+    }
+  return stream.Read(oString.GetData(), length) == static_cast<size_t>(length);
+}
+
+//----------------------------------------------------------------------------
+// Read the color table that may follow the vertex colors of an annotation.
+// Returns false, with an empty table, if there is none or it can't be
+// parsed; message is then set unless the file just ends there.
+bool ReadEmbeddedColorTable(vtkFSIO::InputStream& annotFile, vtkFSIO::ColorTable& colorTable,
+                            std::string& message)
+{
+  int tag;
+  int numColorTableEntries;
+  int rgbt[4];
+  vtkFSIO::Buffer<char> name;
+  std::ostringstream error;
+
+  colorTable.Clear();
+  // Embedded color tables are identified by a tag at the end of
+  // the normal data. If there is no embedded table, we'll get
+  // an eof error here.
+  if (vtkFSIO::ReadInt (annotFile, tag) != 1)
+    {
+    return false;
+    }
+  // check the value of the tag, should be 1
+  if (vtkFSIO::FS_ANNOTATION_COLOR_TABLE_TAG != tag)
+    {
+    error << "Unknown tag " << tag << " after the vertex colors";
+    message = error.str();
+    return false;
+    }
+
+  // Read the number of entries.
+  if (vtkFSIO::ReadInt (annotFile, numColorTableEntries) != 1)
+    {
+    message = "Error reading number of color table entries";
+    return false;
+    }
+  // check the next int, if it's >0 it's the old format,
+  // and this int is the number of entries, if it's <0 it's the new format,
+  // and it's the negative version number
+  if (numColorTableEntries > 0)
+    {
+    // old version
+    // Read the table name.
+    if (!ReadString (annotFile, name))
+      {
+      message = "Error reading color table name";
+      return false;
+      }
+
+    // Read all the entries: a name, the rgb values and a flag value,
+    // which we ignore. Each one takes at least 20 bytes.
+    if (!FitsInStream (annotFile, numColorTableEntries, 20))
+      {
+      error << "Number of color table entries " << numColorTableEntries << " is larger than the file";
+      message = error.str();
+      return false;
+      }
+    if (!colorTable.SetNumberOfEntries (numColorTableEntries))
+      {
+      error << "Too many color table entries: " << numColorTableEntries;
+      message = error.str();
+      return false;
+      }
+    for (int entryIndex = 0; entryIndex < numColorTableEntries; entryIndex++)
+      {
+      if (!ReadString (annotFile, name) ||
+          vtkFSIO::ReadIntArray (annotFile, rgbt, 4) != 4)
+        {
+        error << "Error reading color table entry " << entryIndex;
+        message = error.str();
+        colorTable.Clear();
+        return false;
+        }
+      colorTable.SetEntry (entryIndex, name.GetData(), name.GetSize(), rgbt[0], rgbt[1], rgbt[2]);
+      }
+    return true;
+    }
+
+  //new version
+  int version = -numColorTableEntries;
+  if (version != 2)
+    {
+    error << "Version of embedded color table not supported: " << version;
+    message = error.str();
+    return false;
+    }
+
+  int num_entries_to_read;
+  int structure;
+  // read the number of entries
+  if (vtkFSIO::ReadInt(annotFile, numColorTableEntries) != 1 || numColorTableEntries < 0)
+    {
+    error << "Error getting number of colour table entries: " << numColorTableEntries;
+    message = error.str();
+    return false;
+    }
+  // read the file name
+  if (!ReadString (annotFile, name))
+    {
+    message = "Failed to read color table name";
+    return false;
+    }
+  // read the number of entries to read, each one takes at least 24 bytes
+  if (vtkFSIO::ReadInt(annotFile, num_entries_to_read) != 1 || num_entries_to_read < 0 ||
+      !FitsInStream (annotFile, num_entries_to_read, 24))
+    {
+    error << "Error getting num entries to read: " << num_entries_to_read;
+    message = error.str();
+    return false;
+    }
+  // for each entry, read in the structure number, name and rgbt. Entries
+  // that are not listed stay unused.
+  if (!colorTable.SetNumberOfEntries (numColorTableEntries))
+    {
+    error << "Too many color table entries: " << numColorTableEntries;
+    message = error.str();
+    return false;
+    }
+  for (int entryIndex = 0; entryIndex < num_entries_to_read; entryIndex++)
+    {
+    if (vtkFSIO::ReadInt(annotFile, structure) != 1 || structure < 0 || structure >= numColorTableEntries)
+      {
+      error << "Error in structure " << structure << " at entry " << entryIndex;
+      message = error.str();
+      colorTable.Clear();
+      return false;
+      }
+    // check if we already have an entry here
+    if (colorTable.IsEntryUsed (structure))
+      {
+      error << "Duplicate structure " << structure << " at index " << entryIndex;
+      message = error.str();
+      colorTable.Clear();
+      return false;
+      }
+    if (!ReadString (annotFile, name) ||
+        vtkFSIO::ReadIntArray (annotFile, rgbt, 4) != 4)
+      {
+      error << "Error reading name or RGBT value for entry structure " << structure << " at index " << entryIndex;
+      message = error.str();
+      colorTable.Clear();
+      return false;
+      }
+    // alpha = 255 - transparency
+    colorTable.SetEntry (structure, name.GetData(), name.GetSize(), rgbt[0], rgbt[1], rgbt[2]);
+    }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Read a text color table, such as FreeSurferColorLUT.txt.
+vtkFSIO::ReadStatus ReadExternalColorTable(const char* fileName, vtkFSIO::ColorTable& colorTable)
+{
+  vtkFSIO::InputStream file;
+  std::string text;
+
+  colorTable.Clear();
+  if (nullptr == fileName)
+    {
+    return MakeError(vtkFSIO::FS_READ_ERROR_COLOR_TABLE_OPEN, "Color table file name not specified");
+    }
+  if (!file.Open (fileName) || !file.ReadToEnd (text))
+    {
+    return MakeError(vtkFSIO::FS_READ_ERROR_COLOR_TABLE_OPEN,
+                     std::string("Could not read color table file ") + fileName);
+    }
+
+  // Parse all the entries in one pass. The table grows to the highest
+  // index in the file.
+  int malformedLine = colorTable.ParseText (text.data(), text.size());
+  if (malformedLine != 0)
+    {
+    colorTable.Clear();
+    std::ostringstream message;
+    message << "Error parsing " << fileName << ": Malformed line " << malformedLine;
+    return MakeError(vtkFSIO::FS_READ_ERROR_COLOR_TABLE_FORMAT, message.str());
+    }
+  return vtkFSIO::ReadStatus();
+}
+
+//----------------------------------------------------------------------------
+// Create a color table from the vertex colors, with entries numbered and
+// named in order of first appearance of their color.
+void GenerateColorTable(const int* vertexColors, size_t numVertices, vtkFSIO::ColorTable& colorTable)
+{
+  std::vector<int> colors;
+  std::unordered_map<int, int> entryIndexByRGB;
+  for (size_t i = 0; i < numVertices; i++)
+    {
+    int rgb = vertexColors[i] & 0xffffff;
+    if (entryIndexByRGB.emplace(rgb, static_cast<int>(colors.size())).second)
+      {
+      colors.push_back(rgb);
+      }
+    }
+
+  colorTable.Clear();
+  colorTable.SetNumberOfEntries(static_cast<int>(colors.size()));
+  for (int entryIndex = 0; entryIndex < static_cast<int>(colors.size()); entryIndex++)
+    {
+    int rgb = colors[entryIndex];
+    std::string name = std::to_string(entryIndex);
+    colorTable.SetEntry(entryIndex, name.c_str(), name.size(),
+      rgb & 0xff, (rgb >> 8) & 0xff, (rgb >> 16) & 0xff);
+    }
+}
+}
+
+//-------------------------------------------------------------------------
+vtkFSIO::ReadStatus vtkFSIO::ReadScalarFile(const char* fileName, ScalarData& data)
+{
+  InputStream scalarFile;
+  ReadStatus status;
+  int magicNumber = 0;
+  int numValues = 0;
+  int numFaces = 0;
+  int numValuesPerPoint = 0;
+  std::ostringstream message;
+
+  if (!OpenStream(fileName, scalarFile, status))
+    {
+    return status;
+    }
+
+  // In the old file type, there is no magin number; the first three
+  // byte int is the number of values. In the (more common) new type,
+  // the first three bytes is the magic number. So read three bytes
+  // and assume it's a magic number, check and assign it to the number
+  // of values if not. New style files also have a number of faces and
+  // values per point, which aren't really used.
+  ReadInt3 (scalarFile, magicNumber);
+  if (FS_NEW_SCALAR_MAGIC_NUMBER == magicNumber)
+    {
+    if (ReadInt (scalarFile, numValues) != 1 ||
+        ReadInt (scalarFile, numFaces) != 1 ||
+        ReadInt (scalarFile, numValuesPerPoint) != 1)
+      {
+      message << "Error reading the header of " << fileName;
+      return MakeError(FS_READ_ERROR_EOF, message.str());
+      }
+    if (numValuesPerPoint != 1)
+      {
+      message << "Number of values per point is " << numValuesPerPoint << ", not 1, can't process " << fileName;
+      return MakeError(FS_READ_ERROR_FORMAT, message.str());
+      }
+    }
+  else
+    {
+    // Old style files store the number of faces as a three byte int
+    // right after the number of values.
+    numValues = magicNumber;
+    ReadInt3 (scalarFile, numFaces);
+    }
+
+  if (numValues <= 0)
+    {
+    message << "Number of vertices is 0 or negative, can't process " << fileName;
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+  if (!FitsInStream(scalarFile, numValues, FS_NEW_SCALAR_MAGIC_NUMBER == magicNumber ? 4 : 2))
+    {
+    message << "Unexpected EOF, " << fileName << " is too small for " << numValues << " values";
+    return MakeError(FS_READ_ERROR_EOF, message.str());
+    }
+
+  if (!data.Values.Allocate(numValues))
+    {
+    message << "Error allocating " << numValues << " floats.";
+    return MakeError(FS_READ_ERROR_ALLOC, message.str());
+    }
+  float* values = data.Values.GetData();
+
+  // Read the whole value block at once. New style files store floats,
+  // which are read straight into the buffer, then byte swapped in place
+  // while their range is computed. Old style files store two byte ints
+  // that are divided by 100.
+  size_t numRead = 0;
+  float range[2] = { std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+  if (FS_NEW_SCALAR_MAGIC_NUMBER == magicNumber)
+    {
+    numRead = scalarFile.Read (values, numValues * sizeof(float)) / sizeof(float);
+    DecodeScalarBlock (values, numRead, range);
+    }
+  else
+    {
+    Buffer<short> shortValues;
+    if (!shortValues.Allocate(numValues))
+      {
+      data.Values.Allocate(0);
+      message << "Error allocating " << numValues << " shorts.";
+      return MakeError(FS_READ_ERROR_ALLOC, message.str());
+      }
+    numRead = ReadShortArray (scalarFile, shortValues.GetData(), numValues);
+    for (size_t i = 0; i < numRead; i++)
+      {
+      values[i] = shortValues[i] / 100.0f;
+      range[0] = std::min(range[0], values[i]);
+      range[1] = std::max(range[1], values[i]);
+      }
+    }
+  if (numRead != static_cast<size_t>(numValues))
+    {
+    data.Values.Allocate(0);
+    message << "Unexpected EOF after " << numRead << " values read from " << fileName;
+    return MakeError(FS_READ_ERROR_EOF, message.str());
+    }
+  data.Range[0] = range[0];
+  data.Range[1] = range[1];
+  return status;
+}
+
+//-------------------------------------------------------------------------
+vtkFSIO::ReadStatus vtkFSIO::ReadWFile(const char* fileName, WFileData& data)
+{
+  InputStream wFile;
+  ReadStatus status;
+  int latency = 0;
+  int numValues = 0;
+  std::ostringstream message;
+
+  if (!OpenStream(fileName, wFile, status))
+    {
+    return status;
+    }
+
+  // I'm not sure what this is. In the original FreeSurfer code, there
+  // is this:
+  //
+  //    fread2(&ilat,fp);
+  //    lat = ilat/10.0;
+  //
+  // And then the lat variable is not used again. Maybe it was a scale
+  // factor of some kind? No idea.
+  ReadInt2 (wFile, latency);
+
+  // This is the number of values in the wfile.
+  ReadInt3 (wFile, numValues);
+  if (numValues < 0)
+    {
+    message << "Number of values is negative, can't process " << fileName;
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+
+  // Read all the index/value pairs at once, then decode them in parallel
+  // chunks. The wfile is weird in that there is a 3 byte int index and
+  // float value pair for every value.
+  if (!FitsInStream(wFile, numValues, FS_W_PAIR_SIZE))
+    {
+    message << "Unexpected EOF, " << fileName << " is too small for " << numValues << " values";
+    return MakeError(FS_READ_ERROR_EOF, message.str());
+    }
+  Buffer<unsigned char> raw;
+  if (!raw.Allocate(FS_W_PAIR_SIZE * numValues))
+    {
+    message << "Error allocating " << numValues << " values.";
+    return MakeError(FS_READ_ERROR_ALLOC, message.str());
+    }
+  const size_t numRead = wFile.Read (raw.GetData(), raw.GetSize()) / FS_W_PAIR_SIZE;
+  if (numRead != static_cast<size_t>(numValues))
+    {
+    message << "Unexpected EOF after " << numRead << " values read. Tried to read " << numValues;
+    return MakeError(FS_READ_ERROR_EOF, message.str());
+    }
+  if (!data.Indices.Allocate(numRead) || !data.Values.Allocate(numRead))
+    {
+    message << "Error allocating " << numValues << " values.";
+    return MakeError(FS_READ_ERROR_ALLOC, message.str());
+    }
+  const unsigned char* rawPairs = raw.GetData();
+  int* indices = data.Indices.GetData();
+  float* values = data.Values.GetData();
+  vtkSMPTools::For(0, static_cast<vtkIdType>(numRead), FS_W_DECODE_GRAIN_SIZE,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    DecodeInt3FloatPairs (rawPairs + FS_W_PAIR_SIZE * begin,
+      indices + begin, values + begin, end - begin);
+    });
+  return status;
+}
+
+//-------------------------------------------------------------------------
+vtkFSIO::ReadStatus vtkFSIO::ReadLabelFile(const char* fileName, LabelData& data)
+{
+  InputStream labelFile;
+  ReadStatus status;
+  int numValues = 0;
+  std::ostringstream message;
+
+  // It's a plain ascii file, possibly gzip compressed, which is read at
+  // once and parsed in memory.
+  if (!OpenStream(fileName, labelFile, status))
+    {
+    return status;
+    }
+  std::string text;
+  bool readAll = labelFile.ReadToEnd(text);
+  labelFile.Close();
+  if (!readAll)
+    {
+    return MakeError(FS_READ_ERROR_OPEN, std::string("Error reading file ") + fileName);
+    }
+  const char* textBegin = text.data();
+  const char* textEnd = textBegin + text.size();
+
+  // Skip the comment line, then read the number of values.
+  const char* p = static_cast<const char*>(memchr(textBegin, '\n', text.size()));
+  p = (p == nullptr ? textEnd : p + 1);
+  p = SkipWhitespace(p, textEnd);
+  if (!ParseInt(p, textEnd, numValues) || numValues < 0)
+    {
+    message << "Number of values is missing or negative, can't process " << fileName;
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+  // Every row takes at least two characters, a value and a line break.
+  if (static_cast<size_t>(numValues) > static_cast<size_t>(textEnd - p) / 2 + 1)
+    {
+    message << "Number of values " << numValues << " is larger than " << fileName << " can hold";
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+
+  // Find where each row starts. The label file has an
+  // index/coordinate/weight row for every value:
+  // index x y z w
+  // This means that the label file could have fewer values than the
+  // number of vertices in the surface.
+  std::vector<const char*> rows;
+  rows.reserve(numValues);
+  p = static_cast<const char*>(memchr(p, '\n', textEnd - p));
+  while (p != nullptr && static_cast<int>(rows.size()) < numValues)
+    {
+    p = SkipWhitespace(p, textEnd);
+    if (p == textEnd)
+      {
+      break;
+      }
+    rows.push_back(p);
+    p = static_cast<const char*>(memchr(p, '\n', textEnd - p));
+    }
+  if (static_cast<int>(rows.size()) < numValues)
+    {
+    message << "Unexpected EOF after " << rows.size() << " values read. Tried to read " << numValues;
+    return MakeError(FS_READ_ERROR_EOF, message.str());
+    }
+
+  if (!data.Indices.Allocate(numValues, true) ||
+      !data.Coordinates.Allocate(3 * static_cast<size_t>(numValues), true) ||
+      !data.Weights.Allocate(numValues, true))
+    {
+    message << "Error allocating " << numValues << " rows.";
+    return MakeError(FS_READ_ERROR_ALLOC, message.str());
+    }
+
+  // Rows are independent of each other, so they are parsed concurrently.
+  std::vector<char> rowValid(numValues, 0);
+  {
+  const char* const* rowStart = rows.data();
+  int* indexValues = data.Indices.GetData();
+  float* coordinateValues = data.Coordinates.GetData();
+  float* weightValues = data.Weights.GetData();
+  char* valid = rowValid.data();
+  vtkSMPTools::For(0, numValues, FS_LABEL_PARSE_GRAIN_SIZE,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      const char* row = rowStart[i];
+      float* xyz = coordinateValues + 3 * i;
+      valid[i] = ParseInt(row, textEnd, indexValues[i]) &&
+                 ParseFloat(row, textEnd, xyz[0]) &&
+                 ParseFloat(row, textEnd, xyz[1]) &&
+                 ParseFloat(row, textEnd, xyz[2]) &&
+                 ParseFloat(row, textEnd, weightValues[i]);
+      }
+    });
+  }
+
+  data.NumberOfValues = numValues;
+  data.NumberOfRows = static_cast<int>(std::find(rowValid.begin(), rowValid.end(), 0) - rowValid.begin());
+  if (data.NumberOfRows < numValues)
+    {
+    message << "Value #" << data.NumberOfRows << ": error reading line";
+    status.Warnings.push_back(message.str());
+    }
+  return status;
+}
+
+//-------------------------------------------------------------------------
+vtkFSIO::ReadStatus vtkFSIO::ReadSurfaceFile(const char* fileName,
+                                             const SurfaceReadOptions& options,
+                                             SurfaceData& data)
+{
+  ReadStatus status;
+  if (fileName == nullptr)
+    {
+    return MakeError(FS_READ_ERROR_NO_FILENAME, "FileName not specified.");
+    }
+
+  // Compressed files can't be decoded from a mapping, so they always go
+  // through the stream.
+  MappedFile mappedFile;
+  if (options.UseMemoryMap && mappedFile.Open(fileName) &&
+      !IsGzipData(mappedFile.GetData(), mappedFile.GetSize()))
+    {
+    return ReadMappedSurface(fileName, mappedFile, options, data);
+    }
+  mappedFile.Close();
+  InputStream surfaceFile;
+  if (!OpenStream(fileName, surfaceFile, status))
+    {
+    return status;
+    }
+  return ReadSurfaceStream(fileName, surfaceFile, options, data);
+}
+
+//-------------------------------------------------------------------------
+vtkFSIO::ReadStatus vtkFSIO::ReadAnnotationFile(const char* fileName,
+                                                const char* colorTableFileName,
+                                                bool computeVertexColors,
+                                                AnnotationData& data)
+{
+  InputStream annotFile;
+  ReadStatus status;
+  int numLabels = 0;
+  std::ostringstream message;
+
+  if (!OpenStream(fileName, annotFile, status))
+    {
+    return status;
+    }
+
+  // Read the number of label elements in the file.
+  if (ReadInt (annotFile, numLabels) != 1 || numLabels <= 0)
+    {
+    message << "Number of labels is missing, 0 or negative, can't process " << fileName;
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+
+  // Every label is a pair of ints.
+  if (!FitsInStream (annotFile, numLabels, 8))
+    {
+    message << "Number of labels " << numLabels << " is larger than " << fileName << " can hold";
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+
+  Buffer<int> rgbs;
+  Buffer<int> pairs;
+  if (!data.Labels.Allocate (numLabels, true) || !rgbs.Allocate (numLabels, true) ||
+      !pairs.Allocate (2 * static_cast<size_t>(numLabels)))
+    {
+    data.Labels.Allocate (0);
+    message << "Couldn't allocate array with " << numLabels << " ints.";
+    return MakeError(FS_READ_ERROR_ALLOC, message.str());
+    }
+
+  // The (vertex index, rgb) pairs are read as one block and then
+  // scattered into the rgb array.
+  size_t numPairsRead = ReadIntPairs (annotFile, pairs.GetData(), numLabels);
+  if (numPairsRead != static_cast<size_t>(numLabels))
+    {
+    message << "Unexpected EOF after " << numPairsRead << " values read from " << fileName;
+    return MakeError(FS_READ_ERROR_EOF, message.str());
+    }
+  int numOutOfBounds = 0;
+  for (int labelIndex = 0; labelIndex < numLabels; labelIndex++)
+    {
+    const int vertexIndex = pairs[2 * labelIndex];
+    if (vertexIndex < 0 || vertexIndex >= numLabels)
+      {
+      if (numOutOfBounds++ == 0)
+        {
+        message << "Read vertex # " << vertexIndex << " is out of bounds! Not in 0 to "
+                << numLabels << " -1, rgb = " << pairs[2 * labelIndex + 1];
+        }
+      }
+    else
+      {
+      rgbs[vertexIndex] = pairs[2 * labelIndex + 1];
+      }
+    }
+  if (numOutOfBounds > 0)
+    {
+    message << " (" << numOutOfBounds << " vertex indices out of bounds)";
+    status.Warnings.push_back(message.str());
+    }
+
+  // Use the external color table if given, else the embedded one, else
+  // make one up from the colors in the file.
+  data.GeneratedColorTable = false;
+  if (colorTableFileName != nullptr)
+    {
+    ReadStatus colorTableStatus;
+    data.Colors = GetSharedColorTable (colorTableFileName, colorTableStatus);
+    if (!data.Colors)
+      {
+      data.Labels.Allocate (0);
+      colorTableStatus.Warnings = status.Warnings;
+      return colorTableStatus;
+      }
+    }
+  else
+    {
+    std::shared_ptr<ColorTable> fileColorTable = std::make_shared<ColorTable>();
+    std::string colorTableMessage;
+    if (!ReadEmbeddedColorTable (annotFile, *fileColorTable, colorTableMessage))
+      {
+      if (!colorTableMessage.empty())
+        {
+        status.Warnings.push_back("Embedded color table of " + std::string(fileName) + ": " + colorTableMessage);
+        }
+      GenerateColorTable (rgbs.GetData(), numLabels, *fileColorTable);
+      data.GeneratedColorTable = true;
+      }
+    data.Colors = fileColorTable;
+    }
+  const ColorTable& colorTable = *data.Colors;
+  const int numColorTableEntries = colorTable.GetNumberOfEntries();
+
+  // Index the color table by packed rgb once. When several entries have
+  // the same color, the first one is used.
+  std::unordered_map<int, int> entryIndexByRGB;
+  entryIndexByRGB.reserve(numColorTableEntries);
+  for (int entryIndex = 0; entryIndex < numColorTableEntries; entryIndex++)
+    {
+    // the colour table may have indices where the colour hasn't been
+    // initialised
+    const int* entryRGB = colorTable.GetRGB(entryIndex);
+    int key = entryRGB != nullptr ? PackRGB(entryRGB[0], entryRGB[1], entryRGB[2]) : -1;
+    if (key >= 0)
+      {
+      entryIndexByRGB.emplace(key, entryIndex);
+      }
+    }
+
+  // If requested, the vertex colors are written in the same pass. Vertices
+  // with a label get their own color, the others the color of label 0.
+  unsigned char* vertexColors = nullptr;
+  unsigned char unassignedColor[4] = { 0, 0, 0, 255 };
+  if (computeVertexColors)
+    {
+    if (!data.VertexColors.Allocate (4 * static_cast<size_t>(numLabels)))
+      {
+      message.str("");
+      message << "Couldn't allocate colors for " << numLabels << " vertices.";
+      return MakeError(FS_READ_ERROR_ALLOC, message.str());
+      }
+    vertexColors = data.VertexColors.GetData();
+    const int* entryRGB = colorTable.GetRGB(0);
+    for (int component = 0; entryRGB != nullptr && component < 3; component++)
+      {
+      unassignedColor[component] =
+        static_cast<unsigned char>(std::min(std::max(entryRGB[component], 0), 255));
+      }
+    }
+
+  // Look up every vertex concurrently. Vertices whose color isn't in the
+  // table get label 0.
+  int* labels = data.Labels.GetData();
+  const int* vertexRGBs = rgbs.GetData();
+  std::atomic<bool> anyUnassigned(false);
+  vtkSMPTools::For(0, numLabels, FS_ANNOTATION_GRAIN_SIZE,
+    [&entryIndexByRGB, &anyUnassigned, &unassignedColor, vertexRGBs, labels, vertexColors]
+    (vtkIdType begin, vtkIdType end)
+    {
+    bool chunkUnassigned = false;
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      int rgb = vertexRGBs[i] & 0xffffff;
+      auto it = entryIndexByRGB.find(rgb);
+      if (it != entryIndexByRGB.end())
+        {
+        labels[i] = it->second;
+        if (vertexColors)
+          {
+          vertexColors[4*i] = rgb & 0xff;
+          vertexColors[4*i + 1] = (rgb >> 8) & 0xff;
+          vertexColors[4*i + 2] = (rgb >> 16) & 0xff;
+          vertexColors[4*i + 3] = 255;
+          }
+        }
+      else
+        {
+        labels[i] = 0;
+        chunkUnassigned = true;
+        if (vertexColors)
+          {
+          std::copy(unassignedColor, unassignedColor + 4, vertexColors + 4*i);
+          }
+        }
+      }
+    if (chunkUnassigned)
+      {
+      anyUnassigned = true;
+      }
+    });
+  data.HasUnassignedLabels = anyUnassigned;
+  return status;
+}
+
+//-------------------------------------------------------------------------
+std::shared_ptr<const vtkFSIO::ColorTable> vtkFSIO::GetSharedColorTable(const char* fileName, ReadStatus& status)
+{
+  struct SharedEntry
+  {
+    std::string Path;
+    unsigned long FileSize;
+    long int FileTime;
+    std::shared_ptr<const ColorTable> Table;
+  };
+  static std::mutex sharedMutex;
+  // most recently used first
+  static std::list<SharedEntry> sharedTables;
+
+  status = ReadStatus();
+  if (nullptr == fileName || !vtksys::SystemTools::FileExists (fileName, true))
+    {
+    // let the parser report the error
+    std::shared_ptr<ColorTable> table = std::make_shared<ColorTable>();
+    status = ReadExternalColorTable (fileName, *table);
+    return status.IsOk() ? table : nullptr;
+    }
+  std::string path = vtksys::SystemTools::GetRealPath (fileName);
+  unsigned long fileSize = vtksys::SystemTools::FileLength (path);
+  long int fileTime = vtksys::SystemTools::ModifiedTime (path);
+
+  // Parse under the lock, so that concurrent callers wait for the first
+  // one instead of parsing the file again.
+  std::lock_guard<std::mutex> lock (sharedMutex);
+  std::list<SharedEntry>::iterator found = std::find_if (sharedTables.begin(), sharedTables.end(),
+    [&path](const SharedEntry& entry) { return entry.Path == path; });
+  if (found != sharedTables.end())
+    {
+    if (found->FileSize == fileSize && found->FileTime == fileTime)
+      {
+      sharedTables.splice (sharedTables.begin(), sharedTables, found);
+      return found->Table;
+      }
+    sharedTables.erase (found);
+    }
+  std::shared_ptr<ColorTable> table = std::make_shared<ColorTable>();
+  status = ReadExternalColorTable (fileName, *table);
+  if (!status.IsOk())
+    {
+    return nullptr;
+    }
+  // Callers keep their tables, only the cache lets go of them.
+  sharedTables.push_front (SharedEntry{ path, fileSize, fileTime, table });
+  if (sharedTables.size() > FS_SHARED_COLOR_TABLE_COUNT)
+    {
+    sharedTables.pop_back();
+    }
+  return table;
+}
+
+//-------------------------------------------------------------------------
+bool vtkFSIO::GetScannerTransform(const VolumeGeometry& geometry, double transform[12])
+{
+  if (!geometry.Valid)
+    {
+    return false;
+    }
+  double xras[3], yras[3], zras[3], cras[3];
+  std::copy(geometry.XRAS, geometry.XRAS + 3, xras);
+  std::copy(geometry.YRAS, geometry.YRAS + 3, yras);
+  std::copy(geometry.ZRAS, geometry.ZRAS + 3, zras);
+  std::copy(geometry.CRAS, geometry.CRAS + 3, cras);
+  vtkNew<vtkMatrix4x4> tkRegToScanner;
+  vtkFSSurfaceHelper::ComputeTkRegToScannerRASMatrix(xras, yras, zras, cras, tkRegToScanner);
+  for (int i = 0; i < 3; i++)
+    {
+    for (int j = 0; j < 4; j++)
+      {
+      transform[4 * i + j] = tkRegToScanner->GetElement(i, j);
+      }
+    }
+  return true;
+}
+
+//-------------------------------------------------------------------------
+// Split each quad (v0, v1, v2, v3) into two triangles. The diagonal
+// depends on the parity of v0, the same way nibabel reads quad files:
+// (v0, v1, v3), (v2, v3, v1) for even v0 and (v0, v1, v2), (v0, v2, v3)
+// for odd v0.
+bool vtkFSIO::TriangulateQuads(const int* quads, size_t numQuads, Buffer<int>& triangles)
+{
+  if (!triangles.Allocate(6 * numQuads))
+    {
+    return false;
+    }
+  int* t = triangles.GetData();
+  vtkSMPTools::For(0, static_cast<vtkIdType>(numQuads), FS_DECODE_GRAIN_SIZE,
+    [quads, t](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      const int* quad = quads + 4 * i;
+      int* tri = t + 6 * i;
+      if (quad[0] % 2 == 0)
+        {
+        tri[0] = quad[0]; tri[1] = quad[1]; tri[2] = quad[3];
+        tri[3] = quad[2]; tri[4] = quad[3]; tri[5] = quad[1];
+        }
+      else
+        {
+        tri[0] = quad[0]; tri[1] = quad[1]; tri[2] = quad[2];
+        tri[3] = quad[0]; tri[4] = quad[2]; tri[5] = quad[3];
+        }
+      }
+    });
+  return true;
+}
+
+//-------------------------------------------------------------------------
+// Each face normal is the cross product of the face diagonals (of two
+// edges for triangles), whose length is proportional to the face area.
+// The faces around each vertex are then gathered through a vertex to face
+// table, so vertices can be summed and normalized concurrently without a
+// limit on the number of faces per vertex.
+bool vtkFSIO::ComputeVertexNormals(const float* points, size_t numPoints,
+                                   const int* connectivity, size_t numFaces,
+                                   int cellSize, bool flip, Buffer<float>& normals)
+{
+  const vtkIdType numVertices = static_cast<vtkIdType>(numPoints);
+  const vtkIdType numCells = static_cast<vtkIdType>(numFaces);
+  if (!normals.Allocate(3 * numPoints))
+    {
+    return false;
+    }
+  std::vector<float> faceNormals(3 * numFaces);
+  float* faceNormal = faceNormals.data();
+  vtkSMPTools::For(0, numCells, FS_DECODE_GRAIN_SIZE / 3,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      const int* cell = connectivity + cellSize * i;
+      float* n = faceNormal + 3 * i;
+      n[0] = n[1] = n[2] = 0.0f;
+      bool validCell = true;
+      for (vtkIdType j = 0; j < cellSize; j++)
+        {
+        validCell = validCell && cell[j] >= 0 && cell[j] < numVertices;
+        }
+      if (!validCell)
+        {
+        continue;
+        }
+      const float* p0 = points + 3 * cell[0];
+      const float* p1 = points + 3 * cell[1];
+      const float* p2 = points + 3 * cell[2];
+      const float* p3 = points + 3 * cell[cellSize - 1];
+      // (p2 - p0) x (p3 - p1). For triangles p3 == p2, which gives the
+      // same as (p1 - p0) x (p2 - p0).
+      const double a[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+      const double b[3] = { p3[0] - p1[0], p3[1] - p1[1], p3[2] - p1[2] };
+      n[0] = static_cast<float>(a[1] * b[2] - a[2] * b[1]);
+      n[1] = static_cast<float>(a[2] * b[0] - a[0] * b[2]);
+      n[2] = static_cast<float>(a[0] * b[1] - a[1] * b[0]);
+      }
+    });
+
+  // Vertex to face table, in compressed row form.
+  std::vector<vtkIdType> firstFace(numPoints + 1, 0);
+  const vtkIdType numValues = numCells * cellSize;
+  for (vtkIdType i = 0; i < numValues; i++)
+    {
+    if (connectivity[i] >= 0 && connectivity[i] < numVertices)
+      {
+      firstFace[connectivity[i] + 1]++;
+      }
+    }
+  for (vtkIdType v = 0; v < numVertices; v++)
+    {
+    firstFace[v + 1] += firstFace[v];
+    }
+  std::vector<int> vertexFaces(static_cast<size_t>(firstFace[numVertices]));
+  std::vector<vtkIdType> nextFace(firstFace.begin(), firstFace.end() - 1);
+  for (vtkIdType i = 0; i < numValues; i++)
+    {
+    if (connectivity[i] >= 0 && connectivity[i] < numVertices)
+      {
+      vertexFaces[nextFace[connectivity[i]]++] = static_cast<int>(i / cellSize);
+      }
+    }
+
+  float* vertexNormal = normals.GetData();
+  const vtkIdType* first = firstFace.data();
+  const int* faces = vertexFaces.data();
+  const double sign = flip ? -1.0 : 1.0;
+  vtkSMPTools::For(0, numVertices, FS_DECODE_GRAIN_SIZE / 3,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType v = begin; v < end; v++)
+      {
+      double sum[3] = { 0.0, 0.0, 0.0 };
+      for (vtkIdType k = first[v]; k < first[v + 1]; k++)
+        {
+        const float* n = faceNormal + 3 * faces[k];
+        sum[0] += n[0];
+        sum[1] += n[1];
+        sum[2] += n[2];
+        }
+      double length = sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+      length = length > 0.0 ? sign / length : 0.0;
+      vertexNormal[3 * v]     = static_cast<float>(sum[0] * length);
+      vertexNormal[3 * v + 1] = static_cast<float>(sum[1] * length);
+      vertexNormal[3 * v + 2] = static_cast<float>(sum[2] * length);
+      }
+    });
+  return true;
+}
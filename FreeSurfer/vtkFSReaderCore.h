@@ -0,0 +1,290 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2006 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+=========================================================================auto=*/
+
+#ifndef __vtkFSReaderCore_h
+#define __vtkFSReaderCore_h
+
+#include "vtkFreeSurferExport.h"
+
+// FreeSurfer includes
+#include "vtkFSIO.h"
+
+// STD includes
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// \brief Reentrant decoding of the FreeSurfer surface file formats.
+///
+/// Each Read*File function decodes one whole file into a small value type
+/// that owns its buffers and returns a ReadStatus instead of reporting
+/// errors on an object. The only state they share is the cache of
+/// GetSharedColorTable, behind a mutex, and the only VTK objects they use
+/// are local to a call, such as the matrix of GetScannerTransform, so any
+/// number of files can be decoded concurrently, from any thread. Counts
+/// read from a file are checked against its size before anything is
+/// allocated for them. The vtkFSSurface*Reader classes are adapters that
+/// wrap these results into VTK arrays and lookup tables.
+namespace vtkFSIO {
+
+  /// Error codes of ReadStatus. Values shared with the w-file and label
+  /// readers have the same meaning as their FS_ERROR_W_* codes.
+  enum
+  {
+    FS_READ_OK = 0,
+    FS_READ_ERROR_NO_FILENAME = 2,
+    FS_READ_ERROR_OPEN = 3,
+    FS_READ_ERROR_NUM_VALUES = 4,
+    FS_READ_ERROR_ALLOC = 5,
+    FS_READ_ERROR_EOF = 6,
+    /// not a file of the expected type, or a malformed header
+    FS_READ_ERROR_FORMAT = 7,
+    /// external or embedded color table of an annotation
+    FS_READ_ERROR_COLOR_TABLE_OPEN = 8,
+    FS_READ_ERROR_COLOR_TABLE_FORMAT = 9,
+    /// a write failed, for instance on a full disk
+    FS_WRITE_ERROR = 10,
+  };
+
+  /// Outcome of a read or a write: an error code, the message describing
+  /// the error, and messages about problems that did not stop it.
+  struct VTK_FreeSurfer_EXPORT ReadStatus
+  {
+    int ErrorCode = FS_READ_OK;
+    std::string Message;
+    std::vector<std::string> Warnings;
+
+    bool IsOk () const { return this->ErrorCode == FS_READ_OK; }
+  };
+
+  /// \brief Array allocated with malloc, owned until released.
+  ///
+  /// Release hands the pointer over, for instance to
+  /// vtkAOSDataArrayTemplate::SetArray, which frees it with free().
+  template <typename T>
+  class Buffer
+  {
+  public:
+    Buffer () = default;
+    ~Buffer () { free (this->Data); }
+    Buffer (Buffer&& other) noexcept : Data(other.Data), Size(other.Size)
+      {
+      other.Data = nullptr;
+      other.Size = 0;
+      }
+    Buffer& operator= (Buffer&& other) noexcept
+      {
+      if (this != &other)
+        {
+        free (this->Data);
+        this->Data = other.Data;
+        this->Size = other.Size;
+        other.Data = nullptr;
+        other.Size = 0;
+        }
+      return *this;
+      }
+
+    /// Replace the content with \a size uninitialized values, or zeros if
+    /// \a zero is set. Returns false if the memory could not be allocated.
+    bool Allocate (size_t size, bool zero = false)
+      {
+      free (this->Data);
+      this->Data = nullptr;
+      this->Size = 0;
+      if (size == 0)
+        {
+        return true;
+        }
+      this->Data = static_cast<T*>(zero ? calloc (size, sizeof(T)) : malloc (size * sizeof(T)));
+      this->Size = this->Data != nullptr ? size : 0;
+      return this->Data != nullptr;
+      }
+
+    /// Give up ownership of the values, leaving the buffer empty.
+    T* Release ()
+      {
+      T* data = this->Data;
+      this->Data = nullptr;
+      this->Size = 0;
+      return data;
+      }
+
+    T* GetData () { return this->Data; }
+    const T* GetData () const { return this->Data; }
+    size_t GetSize () const { return this->Size; }
+    T& operator[] (size_t i) { return this->Data[i]; }
+    const T& operator[] (size_t i) const { return this->Data[i]; }
+
+  private:
+    Buffer (const Buffer&) = delete;
+    void operator= (const Buffer&) = delete;
+
+    T* Data = nullptr;
+    size_t Size = 0;
+  };
+
+  /// Per-vertex values of a curvature or thickness file, old or new style.
+  struct VTK_FreeSurfer_EXPORT ScalarData
+  {
+    Buffer<float> Values;
+    /// Range of the values, NaN ignored. Range[0] > Range[1] if there is
+    /// no value that is a number.
+    float Range[2] = { 0.0f, 0.0f };
+  };
+
+  /// Index/value pairs of a w-file, in file order.
+  struct VTK_FreeSurfer_EXPORT WFileData
+  {
+    Buffer<int> Indices;
+    Buffer<float> Values;
+  };
+
+  /// Rows of a label file. The buffers have one entry (three coordinates)
+  /// per row announced in the header; only the first NumberOfRows are
+  /// parsed, the others are zero.
+  struct VTK_FreeSurfer_EXPORT LabelData
+  {
+    int NumberOfValues = 0;
+    /// Number of rows before the first malformed one
+    int NumberOfRows = 0;
+    Buffer<int> Indices;
+    Buffer<float> Coordinates;
+    Buffer<float> Weights;
+  };
+
+  /// Geometry of the volume a triangle surface was created from, stored
+  /// as tagged text after its faces.
+  struct VTK_FreeSurfer_EXPORT VolumeGeometry
+  {
+    bool Valid = false;
+    std::string FileName;
+    int Dimensions[3] = { 0, 0, 0 };
+    double VoxelSize[3] = { 0.0, 0.0, 0.0 };
+    double XRAS[3] = { 0.0, 0.0, 0.0 };
+    double YRAS[3] = { 0.0, 0.0, 0.0 };
+    double ZRAS[3] = { 0.0, 0.0, 0.0 };
+    double CRAS[3] = { 0.0, 0.0, 0.0 };
+  };
+
+  /// Vertices and faces of a quad or triangle surface file.
+  struct VTK_FreeSurfer_EXPORT SurfaceData
+  {
+    int MagicNumber = 0;
+    int NumberOfVertices = 0;
+    int NumberOfFaces = 0;
+    /// 3 for triangle files, 4 for quad files
+    int NumberOfVerticesPerFace = 0;
+    /// x y z of each vertex
+    Buffer<float> Points;
+    /// NumberOfVerticesPerFace vertex indices per face
+    Buffer<int> Faces;
+    /// Index in the file of each vertex, only filled when a piece is read
+    Buffer<int> PointIds;
+    VolumeGeometry Geometry;
+  };
+
+  struct VTK_FreeSurfer_EXPORT SurfaceReadOptions
+  {
+    /// Decode the blocks straight from a memory mapping of the file.
+    /// Compressed files are always streamed.
+    bool UseMemoryMap = false;
+    /// Move the vertices of files with a valid volume geometry to
+    /// scanner RAS while they are decoded.
+    bool ApplyScannerTransform = false;
+    /// Read only the faces of piece \a Piece out of \a NumberOfPieces
+    /// contiguous ranges of faces, and the vertices they use.
+    int Piece = 0;
+    int NumberOfPieces = 1;
+  };
+
+  /// Labels of an annotation file and the color table they index.
+  struct VTK_FreeSurfer_EXPORT AnnotationData
+  {
+    /// Color table entry of each vertex, 0 if its color is in no entry
+    Buffer<int> Labels;
+    /// RGBA of each vertex, only filled if requested
+    Buffer<unsigned char> VertexColors;
+    /// The labels index this table. An external table is the one shared
+    /// by GetSharedColorTable, not a copy.
+    std::shared_ptr<const ColorTable> Colors;
+    /// Whether some vertices have a color that is in no entry
+    bool HasUnassignedLabels = false;
+    /// Whether the table was generated from the vertex colors, because
+    /// the file has no usable embedded table
+    bool GeneratedColorTable = false;
+  };
+
+  /// Surface magic numbers and face sizes.
+  enum
+  {
+    FS_QUAD_FILE_MAGIC_NUMBER = (-1 & 0x00ffffff),
+    FS_NEW_QUAD_FILE_MAGIC_NUMBER = (-3 & 0x00ffffff),
+    FS_TRIANGLE_FILE_MAGIC_NUMBER = (-2 & 0x00ffffff),
+    FS_NEW_SCALAR_MAGIC_NUMBER = 16777215,
+    FS_NUM_VERTS_IN_QUAD_FACE = 4,
+    FS_NUM_VERTS_IN_TRI_FACE = 3,
+    FS_ANNOTATION_COLOR_TABLE_TAG = 1,
+  };
+
+  /// Read a curvature, thickness or other per-vertex scalar file.
+  ReadStatus VTK_FreeSurfer_EXPORT ReadScalarFile (const char* fileName, ScalarData& data);
+
+  /// Read all the index/value pairs of a w-file. Indices are not checked
+  /// against any surface.
+  ReadStatus VTK_FreeSurfer_EXPORT ReadWFile (const char* fileName, WFileData& data);
+
+  /// Read all the rows of an ASCII label file. A malformed row ends the
+  /// rows with a warning.
+  ReadStatus VTK_FreeSurfer_EXPORT ReadLabelFile (const char* fileName, LabelData& data);
+
+  /// Read a quad or triangle surface file, and the volume geometry of
+  /// triangle files. A missing or unreadable geometry is not an error.
+  /// The vertices of a piece keep their file order and the faces are
+  /// renumbered to them. Faces using a vertex out of the file are a
+  /// FS_READ_ERROR_FORMAT.
+  ReadStatus VTK_FreeSurfer_EXPORT ReadSurfaceFile (const char* fileName,
+                                                    const SurfaceReadOptions& options,
+                                                    SurfaceData& data);
+
+  /// Read an annotation file and match the vertex colors with its color
+  /// table, or with the text color table \a colorTableFileName if set (see
+  /// GetSharedColorTable). A file without a usable embedded table gets one
+  /// generated from its colors. Unassigned labels are reported as a warning.
+  ReadStatus VTK_FreeSurfer_EXPORT ReadAnnotationFile (const char* fileName,
+                                                       const char* colorTableFileName,
+                                                       bool computeVertexColors,
+                                                       AnnotationData& data);
+
+  /// Parsed text color table \a fileName, such as FreeSurferColorLUT.txt.
+  /// The file is parsed once per process and the table is shared by all
+  /// the callers until the size or modification time of the file changes.
+  /// Only the few most recently used tables are kept.
+  /// Returns nullptr and sets \a status if the file can't be read or parsed.
+  std::shared_ptr<const ColorTable> VTK_FreeSurfer_EXPORT GetSharedColorTable (const char* fileName,
+                                                                               ReadStatus& status);
+
+  /// Fill \a transform (3x4, row major) with the tkreg to scanner RAS
+  /// affine of \a geometry. Returns false if the geometry is not valid.
+  bool VTK_FreeSurfer_EXPORT GetScannerTransform (const VolumeGeometry& geometry, double transform[12]);
+
+  /// Split each of \a numQuads quads into two triangles, the way nibabel
+  /// reads quad files.
+  bool VTK_FreeSurfer_EXPORT TriangulateQuads (const int* quads, size_t numQuads, Buffer<int>& triangles);
+
+  /// Area weighted vertex normals of a surface whose cells all have
+  /// \a cellSize vertices, reversed if \a flip is set.
+  bool VTK_FreeSurfer_EXPORT ComputeVertexNormals (const float* points, size_t numVertices,
+                                                   const int* connectivity, size_t numCells,
+                                                   int cellSize, bool flip, Buffer<float>& normals);
+}
+
+#endif
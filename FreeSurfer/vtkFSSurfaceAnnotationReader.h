@@ -17,8 +17,16 @@
 // VTK includes
 #include <vtkDataReader.h>
 
+// STD includes
+#include <memory>
+
 class vtkIntArray;
 class vtkLookupTable;
+class vtkUnsignedCharArray;
+namespace vtkFSIO
+{
+class ColorTable;
+}
 
 /// \brief Read a surface annotation and
 /// color table file from Freesurfer tools.
@@ -42,11 +50,26 @@ public:
   vtkLookupTable *GetColorTableOutput();
   void SetColorTableOutput(vtkLookupTable* colors);
 
+  /// Optional output of ready to render colors. If set, ReadFSAnnotation
+  /// also fills it with one RGBA tuple per vertex, the color of the
+  /// vertex label, while decoding the labels.
+  vtkUnsignedCharArray *GetVertexColorsOutput();
+  void SetVertexColorsOutput(vtkUnsignedCharArray* vertexColors);
+
+  /// Color table names as a single "index {name} " list. Prefer
+  /// GetColorTableEntry, which doesn't need parsing.
   char* GetColorTableNames();
 
+  /// Get the name and color of entry \a index of the color table read by
+  /// the last ReadFSAnnotation call. Returns false if there is no such
+  /// entry. \a name stays valid until the next read.
+  bool GetColorTableEntry(int index, const char*& name, int rgb[3]);
+
   int ReadFSAnnotation();
 
-  /// write out the annotation file, using an internal color table
+  /// Write the labels to FileName as an annotation file, with the colors
+  /// of the color table output embedded as its color table. Entry names
+  /// come from the color table read last, if it has as many entries.
   int WriteFSAnnotation();
 
   vtkGetMacro(NumColorTableEntries, int);
@@ -79,29 +102,16 @@ protected:
 
   vtkIntArray    *Labels;
   vtkLookupTable *Colors;
+  vtkUnsignedCharArray *VertexColors;
   char           *NamesList;
   int            NumColorTableEntries;
 
   int UseExternalColorTableFile;
   char *ColorTableFileName;
 
-  /// Read color table information from a source, allocate the arrays
-  /// to hold rgb and name values, and return pointers to the
-  /// arrays. The caller is responsible for disposing of the memory.
-  int ReadEmbeddedColorTable (FILE* annotFile, int* numEntries,
-                  int*** rgbValues, char*** names);
-  int ReadExternalColorTable (char* fileName, int* numEntries,
-                  int*** rgbValues, char*** names);
-
-  /// Creates a color table from the RGB values specified by the labels.
-  /// The caller is responsible for disposing of the memory.
-  int GenerateColorTable(
-    int numLabels,
-    int* labels,
-    int* labelColors,
-    int* numEntries,
-    int*** rgbValues,
-    char*** names);
+  /// Color table of the last read. An external table is shared with the
+  /// other readers of the same file.
+  std::shared_ptr<const vtkFSIO::ColorTable> ColorTableEntries;
 
 private:
   vtkFSSurfaceAnnotationReader(const vtkFSSurfaceAnnotationReader&) = delete;
@@ -53,6 +53,31 @@ void vtkFSSurfaceHelper::ComputeTkRegVox2RASMatrix ( double* spacing,
   M->SetElement ( 3, 3, 1.0 );
 }
 
+//-------------------------------------------------------------------------
+void vtkFSSurfaceHelper::ComputeTkRegToScannerRASMatrix ( double* xras,
+                                                          double* yras,
+                                                          double* zras,
+                                                          double* cras,
+                                                          vtkMatrix4x4 *M )
+{
+  if (!xras || !yras || !zras || !cras || !M)
+    {
+    return;
+    }
+
+  // [scanner Vox2RAS] [tkreg Vox2RAS]inverse. The voxel size and the
+  // volume dimensions cancel out, leaving the direction cosines combined
+  // with the inverse of the tkreg axis permutation, and the center.
+  M->Identity();
+  for (int i = 0; i < 3; i++)
+    {
+    M->SetElement ( i, 0, -xras[i] );
+    M->SetElement ( i, 1, zras[i] );
+    M->SetElement ( i, 2, -yras[i] );
+    M->SetElement ( i, 3, cras[i] );
+    }
+}
+
 //-------------------------------------------------------------------------
 void vtkFSSurfaceHelper
 ::TranslateFreeSurferRegistrationMatrixIntoSlicerRASToRASMatrix(
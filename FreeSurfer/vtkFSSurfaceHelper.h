@@ -28,6 +28,12 @@ public:
   /// Convenience method to compute a volume's Vox2RAS-tkreg Matrix
   static void ComputeTkRegVox2RASMatrix(double* spacing, int* dimensions, vtkMatrix4x4 *M );
 
+  /// Convenience method to compute the matrix that maps surface (tkreg RAS)
+  /// coordinates to scanner RAS, given the direction cosines and center of
+  /// the volume geometry stored in a surface file
+  static void ComputeTkRegToScannerRASMatrix(double* xras, double* yras,
+    double* zras, double* cras, vtkMatrix4x4 *M );
+
   /// Computes matrix we need to register V1Node to V2Node given the
   /// "register.dat" matrix from tkregister2 (FreeSurfer)
   static void TranslateFreeSurferRegistrationMatrixIntoSlicerRASToRASMatrix(
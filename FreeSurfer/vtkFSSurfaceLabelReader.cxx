@@ -13,12 +13,19 @@
 =========================================================================auto=*/
 
 // FreeSurfer includes
+#include "vtkFSReaderCore.h"
 #include "vtkFSSurfaceLabelReader.h"
 
 // VTK includes
 #include <vtkFloatArray.h>
+#include <vtkIntArray.h>
+#include <vtkNew.h>
 #include <vtkObjectFactory.h>
 
+// STD includes
+#include <algorithm>
+#include <string>
+
 //-------------------------------------------------------------------------
 vtkStandardNewMacro(vtkFSSurfaceLabelReader);
 
@@ -27,6 +34,8 @@ vtkFSSurfaceLabelReader::vtkFSSurfaceLabelReader()
 {
   this->Scalars = nullptr;
   this->Points = nullptr;
+  this->Indices = nullptr;
+  this->Weights = nullptr;
   this->NumberOfVertices = 0;
   this->NumberOfValues = 0;
   // from the freesurfer colour table, this is the index for the Left-Cerebral-Cortex
@@ -40,63 +49,42 @@ vtkFSSurfaceLabelReader::vtkFSSurfaceLabelReader()
 vtkFSSurfaceLabelReader::~vtkFSSurfaceLabelReader()
 {
   this->SetPoints(nullptr);
+  this->SetIndices(nullptr);
+  this->SetWeights(nullptr);
 }
 
 //-------------------------------------------------------------------------
 // Returns error codes depending on failure
 int vtkFSSurfaceLabelReader::ReadLabel()
 {
-  FILE* labelFile;
-  int numValues = 0;
   int vIndex;
-  int vIndexFromFile;
-  float  xValue, yValue, zValue, wValue;
   float *scalars;
   vtkFloatArray *output = this->Scalars;
 
-  // Do some basic sanity checks.
-  if (output == nullptr)
+  // Do some basic sanity checks. Without output, only the columns are read.
+  if (output == nullptr && this->Indices == nullptr && this->Points == nullptr && this->Weights == nullptr)
     {
     cerr << "ERROR vtkFSSurfaceLabelReader ReadLabel() : output is null" << endl;
     return this->FS_ERROR_W_OUTPUT_NULL;
     }
-  vtkDebugMacro( << "vtkFSSurfaceLabelReader Execute() " << endl);
-
-  if (!this->GetFileName())
-    {
-    vtkErrorMacro(<<"vtkFSSurfaceLabelReader Execute: FileName not specified.");
-    return this->FS_ERROR_W_NO_FILENAME;
-    }
-
   vtkDebugMacro(<<"Reading surface Label data...");
 
-  // Try to open the file. It's a plain ascii file
-  labelFile = fopen(this->GetFileName(), "r") ;
-  if (!labelFile)
+  // The label file has an index/coordinate/weight row for every value:
+  // index x y z w
+  // This means that the label file could have fewer values than the
+  // number of vertices in the surface.
+  vtkFSIO::LabelData data;
+  vtkFSIO::ReadStatus status = vtkFSIO::ReadLabelFile (this->GetFileName(), data);
+  if (!status.IsOk())
     {
-    vtkErrorMacro (<< "Could not open file " << this->GetFileName());
-    return this->FS_ERROR_W_OPEN;
+    vtkErrorMacro (<< "vtkFSSurfaceLabelReader ReadLabel: " << status.Message);
+    return status.ErrorCode;
     }
-
-  // read the comment line
-  char lineString[1024];
-  char *retval = fgets (lineString, 1024, labelFile);
-  if (retval != nullptr)
+  for (const std::string& warning : status.Warnings)
     {
-    vtkDebugMacro("Comment string:" << lineString);
+    vtkErrorMacro (<< "ReadLabel: " << warning);
     }
-
-  // TODO: parse the comment string, there may be a label number before the
-  // comma
-
-  // This is the number of values in the label file.
-  int numread = fscanf (labelFile, "%d", &numValues);
-  if (numValues < 0 || numread <= 0)
-    {
-    vtkErrorMacro (<< "vtkFSSurfaceLabelReader.cxx Execute: Number of vertices is 0 or negative, can't process file.");
-    return this->FS_ERROR_W_NUM_VALUES;
-    }
-
+  const int numValues = data.NumberOfValues;
   this->NumberOfValues = numValues;
 
   // Check to see that NumberOfVertices was set and is larger than number of values
@@ -111,56 +99,32 @@ int vtkFSSurfaceLabelReader::ReadLabel()
     }
 
   vtkDebugMacro(<<"vtkFSSurfaceLabelReader: numValues = " << this->NumberOfValues << ", numVertices = " << this->NumberOfVertices);
+  this->UpdateProgress(0.5);
 
   // Make our float array.
-  // scalars = (float*) calloc (numValues, sizeof(float));
   // make the array big enough to hold all vertices, calloc inits all values
   // to zero as a default
-  scalars = (float*) calloc (this->NumberOfVertices, sizeof(float));
-  if (scalars == nullptr)
+  scalars = nullptr;
+  if (output)
+    {
+    scalars = (float*) calloc (this->NumberOfVertices, sizeof(float));
+    }
+  if (output && scalars == nullptr)
     {
     vtkErrorMacro(<<"vtkFSSurfaceLabelReader: error allocating " << this->NumberOfVertices << " floats!");
     return this->FS_ERROR_W_ALLOC;
     }
-  if (this->LabelOff != 0.0)
+  if (scalars && this->LabelOff != 0.0)
     {
     // reset the array to the label off value
-    for (int i = 0; i < this->NumberOfVertices; i++)
-      {
-      scalars[i] = this->LabelOff;
-      }
-    }
-
-  if (this->Points)
-    {
-    this->Points->SetNumberOfPoints(numValues);
+    std::fill(scalars, scalars + this->NumberOfVertices, this->LabelOff);
     }
 
+  // For each row before the first malformed one...
   this->NumberOfValues = 0;
-  // For each value in the file...
-  for (vIndex = 0; vIndex < numValues; vIndex ++ )
+  const int* indices = data.Indices.GetData();
+  for (vIndex = 0; vIndex < data.NumberOfRows; vIndex ++ )
     {
-
-    // Check for eof.
-    if (feof(labelFile))
-      {
-      vtkErrorMacro (<< "vtkFSSurfaceLabelReader.cxx Execute: Unexpected EOF after " << vIndex << " values read. Tried to read " << numValues);
-      return this->FS_ERROR_W_EOF;
-      }
-
-    // Read the 3 byte int index and 3 float values. The label file
-    // has an index/coordinate set for every value.
-    // This means that the label file could have fewer values than the
-    // number of vertices in the surface.
-    // index x y z w
-    // Currently, ignoring the values after the index
-    int retval2 = fscanf(labelFile, "%d %f %f %f %f", &vIndexFromFile, &xValue, &yValue, &zValue, &wValue);
-
-    if (retval2 != 5)
-      {
-      vtkErrorMacro("ReadLabel: value #" << this->NumberOfValues << ": error reading line");
-      break;
-      }
     this->NumberOfValues++;
 
     // Make sure the index is in bounds. If not, print a warning and
@@ -169,19 +133,19 @@ int vtkFSSurfaceLabelReader::ReadLabel()
     // is a reason for being able to load a mismatched file. But this
     // should raise some kind of message to the user like, "This file
     // appears to be for a different surface; continue loading?"
+    int vIndexFromFile = indices[vIndex];
     if (this->UseFileIndices && (vIndexFromFile < 0 || vIndexFromFile >= this->NumberOfVertices))
       {
       vtkErrorMacro (<< "ReadLabel: value #" << this->NumberOfValues << ": Read an index that is out of bounds (" << vIndexFromFile << " not in 0-" << this->NumberOfVertices << "), ignoring.");
       break;
       }
 
-    if (this->Points)
-      {
-      this->Points->SetPoint(vIndex, xValue, yValue, zValue);
-      }
-
     // Set the value in the scalars array based on the index we read
     // in, not the index in our for loop.
+    if (scalars == nullptr)
+      {
+      continue;
+      }
     if (this->UseFileIndices)
       {
       scalars[vIndexFromFile] = this->LabelOn;
@@ -190,23 +154,38 @@ int vtkFSSurfaceLabelReader::ReadLabel()
       {
       scalars[vIndex] = this->LabelOn;
       }
+    }
 
-    if (numValues < 10000 ||
-        (vIndex % 100) == 0)
-      {
-      this->UpdateProgress(1.0*vIndex/numValues);
-      }
+  // Hand the parsed columns over in bulk. The coordinates of all the
+  // rows are kept without a copy.
+  if (this->Points)
+    {
+    vtkNew<vtkFloatArray> coordinates;
+    coordinates->SetNumberOfComponents(3);
+    coordinates->SetArray(data.Coordinates.Release(), 3 * static_cast<vtkIdType>(numValues), 0);
+    this->Points->SetData(coordinates);
+    }
+  if (this->Indices)
+    {
+    this->Indices->SetNumberOfComponents(1);
+    this->Indices->SetNumberOfTuples(this->NumberOfValues);
+    std::copy(indices, indices + this->NumberOfValues, this->Indices->GetPointer(0));
+    }
+  if (this->Weights)
+    {
+    this->Weights->SetNumberOfComponents(1);
+    this->Weights->SetNumberOfTuples(this->NumberOfValues);
+    std::copy(data.Weights.GetData(), data.Weights.GetData() + this->NumberOfValues, this->Weights->GetPointer(0));
     }
 
   this->SetProgressText("");
   this->UpdateProgress(0.0);
 
-  // Close the file.
-  fclose (labelFile);
-
   // Set the array in our output.
-  //output->SetArray (scalars, numValues, 0);
-  output->SetArray(scalars, this->NumberOfVertices, 0);
+  if (output)
+    {
+    output->SetArray(scalars, this->NumberOfVertices, 0);
+    }
 
   return this->FS_ERROR_W_NONE;
 }
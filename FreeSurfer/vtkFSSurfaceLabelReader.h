@@ -15,10 +15,10 @@
 
 // VTK includes
 #include <vtkDataReader.h>
+#include <vtkFloatArray.h>
+#include <vtkIntArray.h>
 #include <vtkPoints.h>
 
-class vtkFloatArray;
-
 /// \brief Read a label surface overlay file (*.label)
 /// from Freesurfer tools.
 ///
@@ -27,6 +27,11 @@ class vtkFloatArray;
 /// name. The number of values in the array should be equal to the
 /// number of vertices/points in the surface, but not all elements may be found
 /// in the label file.
+///
+/// The file may be gzip compressed. Rows are parsed independently of the
+/// current locale. The coordinates, vertex indices and weights of the rows
+/// can be retrieved by setting Points, Indices and Weights. The output may
+/// then be null, to read the columns without filling a dense array.
 class VTK_FreeSurfer_EXPORT vtkFSSurfaceLabelReader : public vtkDataReader
 {
 public:
@@ -42,6 +47,17 @@ public:
   vtkGetObjectMacro(Points, vtkPoints);
   vtkSetObjectMacro(Points, vtkPoints);
 
+  ///
+  /// If set, filled with the vertex index column of the rows read
+  vtkGetObjectMacro(Indices, vtkIntArray);
+  vtkSetObjectMacro(Indices, vtkIntArray);
+
+  ///
+  /// If set, filled with the weight (w) column of the rows read, for
+  /// instance statistics or probabilities
+  vtkGetObjectMacro(Weights, vtkFloatArray);
+  vtkSetObjectMacro(Weights, vtkFloatArray);
+
   int ReadLabel();
 
   ///
@@ -94,6 +110,8 @@ protected:
 
   vtkFloatArray* Scalars;
   vtkPoints* Points;
+  vtkIntArray* Indices;
+  vtkFloatArray* Weights;
 
   ///
   /// this is the number of vertices in the associated model file,
@@ -0,0 +1,358 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2006 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include "vtkFSIO.h"
+#include "vtkFSSurfaceMGHReader.h"
+
+// VTK includes
+#include <vtkFloatArray.h>
+#include <vtkInformationIntegerKey.h>
+#include <vtkInformationObjectBaseKey.h>
+#include <vtkObjectFactory.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+/// Minimum number of values decoded by one thread.
+const vtkIdType FS_MGH_DECODE_GRAIN_SIZE = 16 * 1024;
+
+/// Number of values converted at once through a stack buffer.
+const vtkIdType FS_MGH_DECODE_BLOCK_SIZE = 1024;
+
+/// Size in bytes of the dimensions and type at the start of the header:
+/// version, width, height, depth, frames, type and dof ints.
+const size_t FS_MGH_DIMENSIONS_SIZE = 7 * 4;
+
+//----------------------------------------------------------------------------
+// Decode big endian values of type T and convert them to float, in
+// parallel chunks.
+template <typename T, void (*Decode)(const void*, T*, size_t)>
+void DecodeAndConvert(const unsigned char* raw, float* values, vtkIdType numValues)
+{
+  vtkSMPTools::For(0, numValues, FS_MGH_DECODE_GRAIN_SIZE,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    T block[FS_MGH_DECODE_BLOCK_SIZE];
+    for (vtkIdType blockBegin = begin; blockBegin < end; blockBegin += FS_MGH_DECODE_BLOCK_SIZE)
+      {
+      const vtkIdType count = std::min(end - blockBegin, FS_MGH_DECODE_BLOCK_SIZE);
+      Decode(raw + sizeof(T) * blockBegin, block, count);
+      std::copy(block, block + count, values + blockBegin);
+      }
+    });
+}
+}
+
+//-------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFSSurfaceMGHReader);
+vtkInformationKeyMacro(vtkFSSurfaceMGHReader, FRAME_READER, ObjectBase);
+vtkInformationKeyMacro(vtkFSSurfaceMGHReader, FRAME, Integer);
+
+//-------------------------------------------------------------------------
+vtkFSSurfaceMGHReader::vtkFSSurfaceMGHReader()
+{
+  this->Scalars = nullptr;
+  this->NumberOfValues = 0;
+  this->NumberOfFrames = 0;
+  this->DataType = -1;
+  this->Frame = -1;
+  this->MappedFile = nullptr;
+  this->Stream = nullptr;
+  this->NextFrame = 0;
+  this->BufferedFrame = -1;
+}
+
+//-------------------------------------------------------------------------
+vtkFSSurfaceMGHReader::~vtkFSSurfaceMGHReader()
+{
+  this->Close();
+}
+
+//-------------------------------------------------------------------------
+vtkFloatArray * vtkFSSurfaceMGHReader::GetOutput()
+{
+  return this->Scalars;
+}
+
+//-------------------------------------------------------------------------
+void vtkFSSurfaceMGHReader::SetOutput(vtkFloatArray *output)
+{
+  this->Scalars = output;
+}
+
+//-------------------------------------------------------------------------
+void vtkFSSurfaceMGHReader::Close()
+{
+  delete this->MappedFile;
+  this->MappedFile = nullptr;
+  delete this->Stream;
+  this->Stream = nullptr;
+  this->NextFrame = 0;
+  std::vector<unsigned char>().swap(this->FrameBuffer);
+  this->BufferedFrame = -1;
+  this->NumberOfValues = 0;
+  this->NumberOfFrames = 0;
+  this->DataType = -1;
+  this->Frame = -1;
+}
+
+//-------------------------------------------------------------------------
+size_t vtkFSSurfaceMGHReader::GetDataTypeSize() const
+{
+  switch (this->DataType)
+    {
+    case FS_MGH_TYPE_UCHAR: return 1;
+    case FS_MGH_TYPE_SHORT: return 2;
+    case FS_MGH_TYPE_INT:
+    case FS_MGH_TYPE_LONG:
+    case FS_MGH_TYPE_FLOAT: return 4;
+    default: return 0;
+    }
+}
+
+//-------------------------------------------------------------------------
+// Returns error codes depending on failure
+int vtkFSSurfaceMGHReader::ReadHeader()
+{
+  this->Close();
+
+  if (!this->GetFileName())
+    {
+    vtkErrorMacro(<<"vtkFSSurfaceMGHReader ReadHeader: FileName not specified.");
+    return this->FS_ERROR_MGH_NO_FILENAME;
+    }
+
+  vtkDebugMacro(<<"Reading surface MGH header...");
+
+  // Compression is detected from the content, a .mgh file may be gzipped.
+  this->Stream = new vtkFSIO::InputStream;
+  if (!this->Stream->Open(this->GetFileName()))
+    {
+    vtkErrorMacro (<< "Could not open file " << this->GetFileName());
+    this->Close();
+    return this->FS_ERROR_MGH_OPEN;
+    }
+
+  unsigned char header[FS_MGH_HEADER_SIZE];
+  size_t fileSize = 0;
+  if (this->Stream->IsCompressed())
+    {
+    if (this->Stream->Read(header, FS_MGH_HEADER_SIZE) != FS_MGH_HEADER_SIZE)
+      {
+      vtkErrorMacro (<< "Unexpected EOF in the header of " << this->GetFileName());
+      this->Close();
+      return this->FS_ERROR_MGH_EOF;
+      }
+    }
+  else
+    {
+    delete this->Stream;
+    this->Stream = nullptr;
+    this->MappedFile = new vtkFSIO::MappedFile;
+    if (!this->MappedFile->Open(this->GetFileName()))
+      {
+      vtkErrorMacro (<< "Could not map file " << this->GetFileName());
+      this->Close();
+      return this->FS_ERROR_MGH_OPEN;
+      }
+    fileSize = this->MappedFile->GetSize();
+    if (fileSize < FS_MGH_HEADER_SIZE)
+      {
+      vtkErrorMacro (<< "Unexpected EOF in the header of " << this->GetFileName());
+      this->Close();
+      return this->FS_ERROR_MGH_EOF;
+      }
+    std::copy(this->MappedFile->GetData(), this->MappedFile->GetData() + FS_MGH_HEADER_SIZE, header);
+    }
+
+  int dimensions[7];
+  vtkFSIO::DecodeIntArray (header, dimensions, FS_MGH_DIMENSIONS_SIZE / 4);
+  const int version = dimensions[0];
+  bool validDimensions = dimensions[1] > 0 && dimensions[2] > 0 && dimensions[3] > 0 && dimensions[4] > 0;
+  // multiply the positive dimensions one at a time, rejecting the file
+  // before the number of values overflows an int
+  int numValues = 1;
+  for (int i = 1; i <= 3 && validDimensions; ++i)
+    {
+    validDimensions = dimensions[i] <= std::numeric_limits<int>::max() / numValues;
+    numValues *= validDimensions ? dimensions[i] : 1;
+    }
+  if (version != FS_MGH_VERSION || !validDimensions)
+    {
+    vtkErrorMacro (<< "Invalid header in " << this->GetFileName() << ": version " << version
+                   << ", dimensions " << dimensions[1] << " " << dimensions[2] << " " << dimensions[3]
+                   << ", frames " << dimensions[4]);
+    this->Close();
+    return this->FS_ERROR_MGH_HEADER;
+    }
+  this->NumberOfValues = numValues;
+  this->NumberOfFrames = dimensions[4];
+  this->DataType = dimensions[5];
+  if (this->GetDataTypeSize() == 0)
+    {
+    vtkErrorMacro (<< "Unsupported data type " << this->DataType << " in " << this->GetFileName());
+    this->Close();
+    return this->FS_ERROR_MGH_DATA_TYPE;
+    }
+
+  // The frames follow the header, one after the other.
+  const size_t frameSize = this->GetDataTypeSize() * this->NumberOfValues;
+  if (this->MappedFile &&
+      (fileSize - FS_MGH_HEADER_SIZE) / frameSize < static_cast<size_t>(this->NumberOfFrames))
+    {
+    vtkErrorMacro (<< "Unexpected EOF, " << this->GetFileName() << " is too small for "
+                   << this->NumberOfFrames << " frames of " << this->NumberOfValues << " values");
+    this->Close();
+    return this->FS_ERROR_MGH_EOF;
+    }
+
+  vtkDebugMacro(<< "Read header: " << this->NumberOfValues << " values, "
+                << this->NumberOfFrames << " frames of type " << this->DataType);
+  return this->FS_ERROR_MGH_NONE;
+}
+
+//-------------------------------------------------------------------------
+// Returns error codes depending on failure
+int vtkFSSurfaceMGHReader::ReadFrame(int frame)
+{
+  vtkFloatArray *output = this->Scalars;
+  if (output == nullptr)
+    {
+    cerr << "ERROR vtkFSSurfaceMGHReader ReadFrame() : output is null" << endl;
+    return this->FS_ERROR_MGH_OUTPUT_NULL;
+    }
+
+  if (this->MappedFile == nullptr && this->Stream == nullptr)
+    {
+    int error = this->ReadHeader();
+    if (error != this->FS_ERROR_MGH_NONE)
+      {
+      return error;
+      }
+    }
+
+  if (frame < 0 || frame >= this->NumberOfFrames)
+    {
+    vtkErrorMacro (<< "Frame " << frame << " out of range, " << this->GetFileName()
+                   << " has " << this->NumberOfFrames << " frames");
+    return this->FS_ERROR_MGH_FRAME;
+    }
+
+  const size_t frameSize = this->GetDataTypeSize() * this->NumberOfValues;
+  const unsigned char* rawFrame = nullptr;
+  if (this->MappedFile)
+    {
+    rawFrame = this->MappedFile->GetData() + FS_MGH_HEADER_SIZE + frameSize * frame;
+    }
+  else
+    {
+    int error = this->InflateFrame(frame);
+    if (error != this->FS_ERROR_MGH_NONE)
+      {
+      return error;
+      }
+    rawFrame = this->FrameBuffer.data();
+    }
+
+  // Switching frames decodes over the values of the previous frame.
+  if (output->GetNumberOfComponents() != 1 ||
+      output->GetNumberOfValues() != this->NumberOfValues)
+    {
+    output->SetNumberOfComponents(1);
+    output->SetNumberOfValues(this->NumberOfValues);
+    }
+  this->DecodeFrame(rawFrame);
+  output->Modified();
+  this->Frame = frame;
+
+  return this->FS_ERROR_MGH_NONE;
+}
+
+//-------------------------------------------------------------------------
+int vtkFSSurfaceMGHReader::InflateFrame(int frame)
+{
+  if (frame == this->BufferedFrame)
+    {
+    return this->FS_ERROR_MGH_NONE;
+    }
+
+  // The stream only goes forward, start again from the header.
+  if (frame < this->NextFrame)
+    {
+    unsigned char header[FS_MGH_HEADER_SIZE];
+    this->NextFrame = 0;
+    this->BufferedFrame = -1;
+    if (!this->Stream->Open(this->GetFileName()) ||
+        this->Stream->Read(header, FS_MGH_HEADER_SIZE) != FS_MGH_HEADER_SIZE)
+      {
+      vtkErrorMacro (<< "Could not reopen file " << this->GetFileName());
+      return this->FS_ERROR_MGH_OPEN;
+      }
+    }
+
+  // Inflate the frames before the requested one into the same buffer.
+  const size_t frameSize = this->GetDataTypeSize() * this->NumberOfValues;
+  this->FrameBuffer.resize(frameSize);
+  this->BufferedFrame = -1;
+  for (; this->NextFrame <= frame; ++this->NextFrame)
+    {
+    if (this->Stream->Read(this->FrameBuffer.data(), frameSize) != frameSize)
+      {
+      vtkErrorMacro (<< "Unexpected EOF reading frame " << this->NextFrame << " of " << this->GetFileName());
+      return this->FS_ERROR_MGH_EOF;
+      }
+    }
+  this->BufferedFrame = frame;
+  return this->FS_ERROR_MGH_NONE;
+}
+
+//-------------------------------------------------------------------------
+void vtkFSSurfaceMGHReader::DecodeFrame(const unsigned char* rawFrame)
+{
+  float* values = this->Scalars->GetPointer(0);
+  const vtkIdType numValues = this->NumberOfValues;
+  switch (this->DataType)
+    {
+    case FS_MGH_TYPE_FLOAT:
+      vtkSMPTools::For(0, numValues, FS_MGH_DECODE_GRAIN_SIZE,
+        [=](vtkIdType begin, vtkIdType end)
+        {
+        vtkFSIO::DecodeFloatArray (rawFrame + 4 * begin, values + begin, end - begin);
+        });
+      break;
+    case FS_MGH_TYPE_INT:
+    case FS_MGH_TYPE_LONG:
+      DecodeAndConvert<int, vtkFSIO::DecodeIntArray>(rawFrame, values, numValues);
+      break;
+    case FS_MGH_TYPE_SHORT:
+      DecodeAndConvert<short, vtkFSIO::DecodeShortArray>(rawFrame, values, numValues);
+      break;
+    case FS_MGH_TYPE_UCHAR:
+      std::copy(rawFrame, rawFrame + numValues, values);
+      break;
+    }
+}
+
+//-------------------------------------------------------------------------
+void vtkFSSurfaceMGHReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "NumberOfValues: " << this->NumberOfValues << "\n";
+  os << indent << "NumberOfFrames: " << this->NumberOfFrames << "\n";
+  os << indent << "DataType: " << this->DataType << "\n";
+  os << indent << "Frame: " << this->Frame << "\n";
+  os << indent << "Compressed: " << (this->Stream != nullptr) << "\n";
+  os << indent << "NextFrame: " << this->NextFrame << "\n";
+  os << indent << "BufferedFrame: " << this->BufferedFrame << "\n";
+}
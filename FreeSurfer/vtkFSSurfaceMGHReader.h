@@ -0,0 +1,145 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2006 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+=========================================================================auto=*/
+
+#ifndef __vtkFSSurfaceMGHReader_h
+#define __vtkFSSurfaceMGHReader_h
+
+#include "FreeSurferConfigure.h"
+#include "vtkFreeSurferExport.h"
+
+// VTK includes
+#include <vtkDataReader.h>
+
+// STD includes
+#include <vector>
+
+class vtkFloatArray;
+class vtkInformationIntegerKey;
+class vtkInformationObjectBaseKey;
+
+namespace vtkFSIO
+{
+  class InputStream;
+  class MappedFile;
+}
+
+/// \brief Read a surface overlay stored in a volume file (*.mgh, *.mgz)
+/// from Freesurfer tools.
+///
+/// Surface overlays such as a functional time series sampled on a surface
+/// are saved as volumes with one voxel per vertex and one frame per time
+/// point. ReadHeader only reads the dimensions, ReadFrame then decodes a
+/// single frame into the output vtkFloatArray. The number of values in a
+/// frame should be equal to the number of vertices/points in the surface.
+///
+/// An uncompressed file is memory mapped, so a frame is decoded straight
+/// from the page cache and only the pages of the frames that are read are
+/// loaded. A compressed file can't be read at random positions: it stays
+/// open after the last frame read and is inflated forward from there, one
+/// frame at a time, so only a single inflated frame is kept. Reading an
+/// earlier frame inflates the file again from its start.
+class VTK_FreeSurfer_EXPORT vtkFSSurfaceMGHReader : public vtkDataReader
+{
+public:
+  static vtkFSSurfaceMGHReader *New();
+  vtkTypeMacro(vtkFSSurfaceMGHReader,vtkDataReader);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  vtkFloatArray *GetOutput();
+  void SetOutput(vtkFloatArray *output);
+
+  /// Open the file and read its dimensions. Returns an error code.
+  int ReadHeader();
+
+  /// Decode \a frame into the output, replacing its values. The values
+  /// are written into the buffer of the output if it already has the size
+  /// of a frame. The header is read first if needed. Returns an error code.
+  int ReadFrame(int frame);
+
+  /// Release the file and the inflated frame. The next ReadFrame
+  /// reads the header again.
+  void Close();
+
+  /// Number of values in a frame, width * height * depth of the volume
+  vtkGetMacro(NumberOfValues,int);
+  vtkGetMacro(NumberOfFrames,int);
+  /// Type of the values in the file, one of FS_MGH_TYPE_*
+  vtkGetMacro(DataType,int);
+  /// Last frame read into the output, -1 if none
+  vtkGetMacro(Frame,int);
+
+  /// Key to keep the reader of a multi-frame overlay in the information
+  /// of the array it fills, so other frames can be read into it later.
+  /// Copies of the array share the reader.
+  static vtkInformationObjectBaseKey* FRAME_READER();
+
+  /// Key to keep the frame an array holds in its information, next to
+  /// its FRAME_READER. The reader only knows the last frame it read,
+  /// which is not the frame of every array sharing it.
+  static vtkInformationIntegerKey* FRAME();
+
+  enum
+  {
+    /// error codes
+    FS_ERROR_MGH_NONE = 0,
+    FS_ERROR_MGH_OUTPUT_NULL = 1,
+    FS_ERROR_MGH_NO_FILENAME = 2,
+    FS_ERROR_MGH_OPEN = 3,
+    FS_ERROR_MGH_HEADER = 4,
+    FS_ERROR_MGH_DATA_TYPE = 5,
+    FS_ERROR_MGH_FRAME = 6,
+    FS_ERROR_MGH_EOF = 7,
+    /// file format
+    FS_MGH_VERSION = 1,
+    FS_MGH_HEADER_SIZE = 284,
+    /// data types
+    FS_MGH_TYPE_UCHAR = 0,
+    FS_MGH_TYPE_INT = 1,
+    FS_MGH_TYPE_LONG = 2,
+    FS_MGH_TYPE_FLOAT = 3,
+    FS_MGH_TYPE_SHORT = 4,
+  };
+
+protected:
+  vtkFSSurfaceMGHReader();
+  ~vtkFSSurfaceMGHReader() override;
+
+  /// Size in bytes of a value of the file, 0 if the type isn't supported
+  size_t GetDataTypeSize() const;
+
+  /// Decode numberOfValues values of the file type into the output
+  void DecodeFrame(const unsigned char* rawFrame);
+
+  /// Inflate \a frame of the compressed file into FrameBuffer.
+  /// Returns an error code.
+  int InflateFrame(int frame);
+
+  vtkFloatArray * Scalars;
+
+  int NumberOfValues;
+  int NumberOfFrames;
+  int DataType;
+  int Frame;
+
+  /// uncompressed file
+  vtkFSIO::MappedFile* MappedFile;
+
+  /// compressed file, positioned at the start of NextFrame
+  vtkFSIO::InputStream* Stream;
+  int NextFrame;
+  /// last inflated frame, -1 if none
+  std::vector<unsigned char> FrameBuffer;
+  int BufferedFrame;
+
+private:
+  vtkFSSurfaceMGHReader(const vtkFSSurfaceMGHReader&);  /// Not implemented.
+  void operator=(const vtkFSSurfaceMGHReader&);  /// Not implemented.
+};
+
+#endif
@@ -0,0 +1,344 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2006 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include "vtkFSReaderCore.h"
+#include "vtkFSSurfaceLabelReader.h"
+#include "vtkFSSurfaceMultiLabelReader.h"
+
+// VTK includes
+#include <vtkIdList.h>
+#include <vtkIntArray.h>
+#include <vtkObjectFactory.h>
+#include <vtkSMPTools.h>
+#include <vtkStringArray.h>
+#include <vtkUnsignedIntArray.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+/// Minimum number of vertices processed by one thread.
+const vtkIdType FS_MULTI_LABEL_GRAIN_SIZE = 16 * 1024;
+
+//----------------------------------------------------------------------------
+// File name without directory and .label or .label.gz extension
+std::string GetLabelName(const std::string& fileName)
+{
+  std::string name = fileName.substr(fileName.find_last_of("/\\") + 1);
+  for (const char* extension : { ".gz", ".label" })
+    {
+    const size_t length = strlen(extension);
+    if (name.size() > length && name.compare(name.size() - length, length, extension) == 0)
+      {
+      name.resize(name.size() - length);
+      }
+    }
+  return name;
+}
+}
+
+//-------------------------------------------------------------------------
+vtkStandardNewMacro(vtkFSSurfaceMultiLabelReader);
+
+//-------------------------------------------------------------------------
+vtkFSSurfaceMultiLabelReader::vtkFSSurfaceMultiLabelReader()
+{
+  this->Scalars = nullptr;
+  this->NumberOfVertices = 0;
+  this->LabelNames = vtkStringArray::New();
+  this->LabelOffsets = vtkIntArray::New();
+  this->LabelVertices = vtkIntArray::New();
+}
+
+//-------------------------------------------------------------------------
+vtkFSSurfaceMultiLabelReader::~vtkFSSurfaceMultiLabelReader()
+{
+  this->LabelNames->Delete();
+  this->LabelOffsets->Delete();
+  this->LabelVertices->Delete();
+}
+
+//-------------------------------------------------------------------------
+vtkUnsignedIntArray * vtkFSSurfaceMultiLabelReader::GetOutput()
+{
+  return this->Scalars;
+}
+
+//-------------------------------------------------------------------------
+void vtkFSSurfaceMultiLabelReader::SetOutput(vtkUnsignedIntArray *output)
+{
+  this->Scalars = output;
+}
+
+//-------------------------------------------------------------------------
+void vtkFSSurfaceMultiLabelReader::AddFileName(const char* fileName)
+{
+  this->FileNames.push_back(fileName ? fileName : "");
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------
+void vtkFSSurfaceMultiLabelReader::RemoveAllFileNames()
+{
+  this->FileNames.clear();
+  this->ErrorCodes.clear();
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------
+int vtkFSSurfaceMultiLabelReader::GetNumberOfFileNames()
+{
+  return static_cast<int>(this->FileNames.size());
+}
+
+//-------------------------------------------------------------------------
+const char* vtkFSSurfaceMultiLabelReader::GetFileName(int index)
+{
+  if (index < 0 || index >= this->GetNumberOfFileNames())
+    {
+    return nullptr;
+    }
+  return this->FileNames[index].c_str();
+}
+
+//-------------------------------------------------------------------------
+int vtkFSSurfaceMultiLabelReader::GetErrorCode(int index)
+{
+  if (index < 0 || index >= static_cast<int>(this->ErrorCodes.size()))
+    {
+    return vtkFSSurfaceLabelReader::FS_ERROR_W_NO_FILENAME;
+    }
+  return this->ErrorCodes[index];
+}
+
+//-------------------------------------------------------------------------
+// Returns error codes depending on failure
+int vtkFSSurfaceMultiLabelReader::ReadLabels()
+{
+  vtkUnsignedIntArray *output = this->Scalars;
+  if (output == nullptr)
+    {
+    cerr << "ERROR vtkFSSurfaceMultiLabelReader ReadLabels() : output is null" << endl;
+    return this->FS_ERROR_MULTI_LABEL_OUTPUT_NULL;
+    }
+  if (this->NumberOfVertices <= 0)
+    {
+    vtkErrorMacro(<<"vtkFSSurfaceMultiLabelReader ReadLabels: NumberOfVertices not specified.");
+    return this->FS_ERROR_MULTI_LABEL_NO_VERTICES;
+    }
+
+  const int numLabels = this->GetNumberOfFileNames();
+  const int numVertices = this->NumberOfVertices;
+  vtkDebugMacro(<<"Reading " << numLabels << " labels of " << numVertices << " vertices...");
+
+  // Only the vertex index column of each file is kept, as a sorted list,
+  // up to the first index out of the surface. Errors are reported once
+  // all the files are read.
+  std::vector<std::vector<int> > labelVertices(numLabels);
+  std::vector<std::string> errorMessages(numLabels);
+  this->ErrorCodes.assign(numLabels, vtkFSSurfaceLabelReader::FS_ERROR_W_NONE);
+  {
+  const std::string* fileNames = this->FileNames.data();
+  std::vector<int>* vertices = labelVertices.data();
+  std::string* messages = errorMessages.data();
+  int* errorCodes = this->ErrorCodes.data();
+  vtkSMPTools::For(0, numLabels, 1,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType label = begin; label < end; label++)
+      {
+      vtkFSIO::LabelData data;
+      vtkFSIO::ReadStatus status = vtkFSIO::ReadLabelFile(fileNames[label].c_str(), data);
+      errorCodes[label] = status.ErrorCode;
+      if (!status.IsOk())
+        {
+        messages[label] = status.Message;
+        continue;
+        }
+      const int* first = data.Indices.GetData();
+      const int* last = std::find_if(first, first + data.NumberOfRows,
+        [numVertices](int vertex) { return vertex < 0 || vertex >= numVertices; });
+      std::vector<int>& labelIndices = vertices[label];
+      labelIndices.assign(first, last);
+      std::sort(labelIndices.begin(), labelIndices.end());
+      labelIndices.erase(std::unique(labelIndices.begin(), labelIndices.end()), labelIndices.end());
+      }
+    });
+  }
+  for (int label = 0; label < numLabels; label++)
+    {
+    if (!errorMessages[label].empty())
+      {
+      vtkErrorMacro(<< "ReadLabels: " << errorMessages[label]);
+      }
+    }
+
+  this->LabelNames->SetNumberOfValues(numLabels);
+  this->LabelOffsets->SetNumberOfComponents(1);
+  this->LabelOffsets->SetNumberOfValues(numLabels + 1);
+  int numMembers = 0;
+  for (int label = 0; label < numLabels; label++)
+    {
+    this->LabelNames->SetValue(label, GetLabelName(this->FileNames[label]));
+    this->LabelOffsets->SetValue(label, numMembers);
+    numMembers += static_cast<int>(labelVertices[label].size());
+    }
+  this->LabelOffsets->SetValue(numLabels, numMembers);
+  this->LabelVertices->SetNumberOfComponents(1);
+  this->LabelVertices->SetNumberOfValues(numMembers);
+  int* members = this->LabelVertices->GetPointer(0);
+  for (int label = 0; label < numLabels; label++)
+    {
+    members = std::copy(labelVertices[label].begin(), labelVertices[label].end(), members);
+    }
+
+  // One thread per component, so no two threads set bits in the same word.
+  const int numComponents = std::max(1, (numLabels + FS_MULTI_LABEL_COMPONENT_BITS - 1) / FS_MULTI_LABEL_COMPONENT_BITS);
+  output->SetNumberOfComponents(numComponents);
+  output->SetNumberOfTuples(numVertices);
+  unsigned int* mask = output->GetPointer(0);
+  std::fill(mask, mask + static_cast<size_t>(numComponents) * numVertices, 0u);
+  {
+  const std::vector<int>* vertices = labelVertices.data();
+  vtkSMPTools::For(0, numComponents, 1,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType component = begin; component < end; component++)
+      {
+      const int firstLabel = static_cast<int>(component) * FS_MULTI_LABEL_COMPONENT_BITS;
+      const int lastLabel = std::min(numLabels, firstLabel + FS_MULTI_LABEL_COMPONENT_BITS);
+      for (int label = firstLabel; label < lastLabel; label++)
+        {
+        const unsigned int bit = 1u << (label - firstLabel);
+        for (int vertex : vertices[label])
+          {
+          mask[static_cast<size_t>(vertex) * numComponents + component] |= bit;
+          }
+        }
+      }
+    });
+  }
+  output->Modified();
+
+  return this->FS_ERROR_MULTI_LABEL_NONE;
+}
+
+//-------------------------------------------------------------------------
+bool vtkFSSurfaceMultiLabelReader::IsVertexInLabel(vtkUnsignedIntArray* mask, vtkIdType vertex, int label)
+{
+  const int component = label / FS_MULTI_LABEL_COMPONENT_BITS;
+  if (mask == nullptr || label < 0 || component >= mask->GetNumberOfComponents() ||
+      vertex < 0 || vertex >= mask->GetNumberOfTuples())
+    {
+    return false;
+    }
+  const unsigned int word = mask->GetValue(vertex * mask->GetNumberOfComponents() + component);
+  return (word >> (label % FS_MULTI_LABEL_COMPONENT_BITS)) & 1u;
+}
+
+//-------------------------------------------------------------------------
+void vtkFSSurfaceMultiLabelReader::GetLabelVertices(vtkUnsignedIntArray* mask, int label, vtkIdList* vertices)
+{
+  if (vertices == nullptr)
+    {
+    return;
+    }
+  vertices->Reset();
+  const int component = label / FS_MULTI_LABEL_COMPONENT_BITS;
+  if (mask == nullptr || label < 0 || component >= mask->GetNumberOfComponents())
+    {
+    return;
+    }
+  const int numComponents = mask->GetNumberOfComponents();
+  const unsigned int bit = 1u << (label % FS_MULTI_LABEL_COMPONENT_BITS);
+  const unsigned int* words = mask->GetPointer(0) + component;
+  const vtkIdType numVertices = mask->GetNumberOfTuples();
+  for (vtkIdType vertex = 0; vertex < numVertices; vertex++)
+    {
+    if (words[vertex * numComponents] & bit)
+      {
+      vertices->InsertNextId(vertex);
+      }
+    }
+}
+
+//-------------------------------------------------------------------------
+int vtkFSSurfaceMultiLabelReader::GetNumberOfVertexLabels(vtkUnsignedIntArray* mask, vtkIdType vertex)
+{
+  if (mask == nullptr || vertex < 0 || vertex >= mask->GetNumberOfTuples())
+    {
+    return 0;
+    }
+  const int numComponents = mask->GetNumberOfComponents();
+  const unsigned int* words = mask->GetPointer(vertex * numComponents);
+  int count = 0;
+  for (int component = 0; component < numComponents; component++)
+    {
+    for (unsigned int word = words[component]; word != 0; word &= word - 1)
+      {
+      count++;
+      }
+    }
+  return count;
+}
+
+//-------------------------------------------------------------------------
+void vtkFSSurfaceMultiLabelReader::ComputeFirstLabels(vtkUnsignedIntArray* mask, vtkIntArray* labels)
+{
+  if (mask == nullptr || labels == nullptr)
+    {
+    return;
+    }
+  const int numComponents = mask->GetNumberOfComponents();
+  const vtkIdType numVertices = mask->GetNumberOfTuples();
+  labels->SetNumberOfComponents(1);
+  labels->SetNumberOfValues(numVertices);
+  const unsigned int* words = mask->GetPointer(0);
+  int* firstLabels = labels->GetPointer(0);
+  vtkSMPTools::For(0, numVertices, FS_MULTI_LABEL_GRAIN_SIZE,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType vertex = begin; vertex < end; vertex++)
+      {
+      const unsigned int* vertexWords = words + vertex * numComponents;
+      int firstLabel = 0;
+      for (int component = 0; component < numComponents && firstLabel == 0; component++)
+        {
+        const unsigned int word = vertexWords[component];
+        if (word != 0)
+          {
+          int bit = 0;
+          while (!((word >> bit) & 1u))
+            {
+            bit++;
+            }
+          firstLabel = component * FS_MULTI_LABEL_COMPONENT_BITS + bit + 1;
+          }
+        }
+      firstLabels[vertex] = firstLabel;
+      }
+    });
+  labels->Modified();
+}
+
+//-------------------------------------------------------------------------
+void vtkFSSurfaceMultiLabelReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "NumberOfVertices: " << this->NumberOfVertices << "\n";
+  os << indent << "NumberOfFileNames: " << this->FileNames.size() << "\n";
+  for (size_t i = 0; i < this->FileNames.size(); i++)
+    {
+    os << indent.GetNextIndent() << this->FileNames[i] << "\n";
+    }
+  os << indent << "NumberOfLabelVertices: " << this->LabelVertices->GetNumberOfValues() << "\n";
+}
@@ -0,0 +1,113 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2006 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+=========================================================================auto=*/
+
+#ifndef __vtkFSSurfaceMultiLabelReader_h
+#define __vtkFSSurfaceMultiLabelReader_h
+
+#include "FreeSurferConfigure.h"
+#include "vtkFreeSurferExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+class vtkIdList;
+class vtkIntArray;
+class vtkStringArray;
+class vtkUnsignedIntArray;
+
+/// \brief Read several label files (*.label) of a surface into one array
+/// from Freesurfer tools.
+///
+/// Reading each label of a subject with vtkFSSurfaceLabelReader makes one
+/// float array of NumberOfVertices values per label. This reader instead
+/// reads the files concurrently into a single per-vertex bitmask: bit i of
+/// a vertex is set if it belongs to the label of the i-th file name. The
+/// output has one 32 bit component per 32 labels.
+///
+/// The sorted vertex indices of each label are also kept, in LabelVertices
+/// from LabelOffsets[i] to LabelOffsets[i + 1], and the label names, the
+/// file names without directory and extension, in LabelNames.
+class VTK_FreeSurfer_EXPORT vtkFSSurfaceMultiLabelReader : public vtkObject
+{
+public:
+  static vtkFSSurfaceMultiLabelReader *New();
+  vtkTypeMacro(vtkFSSurfaceMultiLabelReader,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  vtkUnsignedIntArray *GetOutput();
+  void SetOutput(vtkUnsignedIntArray *output);
+
+  void AddFileName(const char* fileName);
+  void RemoveAllFileNames();
+  int GetNumberOfFileNames();
+  const char* GetFileName(int index);
+
+  ///
+  /// Number of vertices on the surface
+  vtkGetMacro(NumberOfVertices,int);
+  vtkSetMacro(NumberOfVertices,int);
+
+  ///
+  /// Read all the files, concurrently. Returns an error code. A label
+  /// that could not be read is left empty, see GetErrorCode.
+  int ReadLabels();
+
+  ///
+  /// vtkFSSurfaceLabelReader error code of a file, after ReadLabels
+  int GetErrorCode(int index);
+
+  vtkGetObjectMacro(LabelNames, vtkStringArray);
+  vtkGetObjectMacro(LabelOffsets, vtkIntArray);
+  vtkGetObjectMacro(LabelVertices, vtkIntArray);
+
+  ///
+  /// Queries on a bitmask output
+  static bool IsVertexInLabel(vtkUnsignedIntArray* mask, vtkIdType vertex, int label);
+  static void GetLabelVertices(vtkUnsignedIntArray* mask, int label, vtkIdList* vertices);
+  static int GetNumberOfVertexLabels(vtkUnsignedIntArray* mask, vtkIdType vertex);
+
+  ///
+  /// Fill \a labels with, for each vertex of \a mask, one plus the lowest
+  /// label it belongs to, or 0, to color the labels with a single table.
+  static void ComputeFirstLabels(vtkUnsignedIntArray* mask, vtkIntArray* labels);
+
+  enum
+  {
+    /// error codes
+    FS_ERROR_MULTI_LABEL_NONE = 0,
+    FS_ERROR_MULTI_LABEL_OUTPUT_NULL = 1,
+    FS_ERROR_MULTI_LABEL_NO_VERTICES = 2,
+    /// number of labels in a component of the output
+    FS_MULTI_LABEL_COMPONENT_BITS = 32,
+  };
+
+protected:
+  vtkFSSurfaceMultiLabelReader();
+  ~vtkFSSurfaceMultiLabelReader() override;
+
+  vtkUnsignedIntArray* Scalars;
+  vtkStringArray* LabelNames;
+  vtkIntArray* LabelOffsets;
+  vtkIntArray* LabelVertices;
+
+  std::vector<std::string> FileNames;
+  std::vector<int> ErrorCodes;
+
+  int NumberOfVertices;
+
+private:
+  vtkFSSurfaceMultiLabelReader(const vtkFSSurfaceMultiLabelReader&) = delete;
+  void operator=(const vtkFSSurfaceMultiLabelReader&) = delete;
+};
+
+#endif
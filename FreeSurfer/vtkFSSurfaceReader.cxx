@@ -13,17 +13,27 @@
 =========================================================================auto=*/
 
 // FreeSurfer includes
-#include "vtkFSIO.h"
+#include "vtkFSReaderCore.h"
 #include "vtkFSSurfaceReader.h"
 
 // VTK includes
 #include <vtkObjectFactory.h>
-#include <vtkByteSwap.h>
 #include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
 #include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
 #include <vtkStreamingDemandDrivenPipeline.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkVersion.h>
+
+// STD includes
+#include <algorithm>
 
 //-------------------------------------------------------------------------
 vtkStandardNewMacro(vtkFSSurfaceReader);
@@ -32,6 +42,21 @@ vtkStandardNewMacro(vtkFSSurfaceReader);
 vtkFSSurfaceReader::vtkFSSurfaceReader()
 {
   this->FileName = nullptr;
+  this->UseMemoryMap = false;
+  this->TriangulateQuads = false;
+  this->ApplyScannerTransform = false;
+  this->ComputeNormals = false;
+  this->VolumeGeometryValid = false;
+  this->VolumeFileName = nullptr;
+  for (int i = 0; i < 3; i++)
+    {
+    this->VolumeDimensions[i] = 0;
+    this->VoxelSize[i] = 0.0;
+    this->XRAS[i] = 0.0;
+    this->YRAS[i] = 0.0;
+    this->ZRAS[i] = 0.0;
+    this->CRAS[i] = 0.0;
+    }
   this->SetNumberOfInputPorts(0);
 }
 
@@ -40,6 +65,25 @@ vtkFSSurfaceReader::~vtkFSSurfaceReader()
 {
   delete[] this->FileName;
   this->FileName = nullptr;
+  this->SetVolumeFileName(nullptr);
+}
+
+namespace
+{
+/// Minimum number of cell offsets filled by one thread.
+const vtkIdType FS_DECODE_GRAIN_SIZE = 64 * 1024;
+}
+
+//----------------------------------------------------------------------------
+int vtkFSSurfaceReader::RequestInformation(
+        vtkInformation *,
+        vtkInformationVector **,
+        vtkInformationVector *outputVector)
+{
+  // Faces are split into pieces when they are decoded.
+  vtkInformation *outInfo = outputVector->GetInformationObject(0);
+  outInfo->Set(vtkAlgorithm::CAN_HANDLE_PIECE_REQUEST(), 1);
+  return 1;
 }
 
 //----------------------------------------------------------------------------
@@ -55,60 +99,59 @@ int vtkFSSurfaceReader::RequestData(
   vtkPolyData *output = vtkPolyData::SafeDownCast(
     outInfo->Get(vtkDataObject::DATA_OBJECT()));
 
-  FILE* surfaceFile;
-  int magicNumber;
-  char line[256];
   int numVertices = 0;
   int numFaces = 0;
-  int vIndex, fIndex;
   int numVerticesPerFace = 0;
-  int tmpX, tmpY, tmpZ;
-  int tmpfIndex = 0;
-  float locations[3];
-  int fvIndex;
-  int faceIncrement = 1;
-  int faceMultiplier = 1;
-  vtkIdType faceIndices[4];
   vtkPoints *outputVertices;
   vtkCellArray *outputFaces;
 
-#if FS_CALC_NORMALS
-  vtkFloatArray *outputNormals;
-  FSVertex* vertices;
-  FSFace* faces;
-  FSVertex* v;
-  FSFace* f;
-  FSVertex* fv0;
-  FSVertex* fv1;
-  FSVertex* fv2;
-  int fvIndex1, fvIndex2, fvIndex0;
-  float faceVector0[3], faceVector1[3];
-  float faceNormal[3];
-  float length;
-#endif
-  int totalSteps = 1;
+  int totalSteps = this->ComputeNormals ? 3 : 2;
   int thisStep = 0;
 
   vtkDebugMacro(<<"RequestData: Reading vtk polygonal data...");
 
-  // Try to open the file.
-  surfaceFile = fopen(this->GetFileName(), "rb") ;
-  if (!surfaceFile) {
-    vtkErrorMacro (<< "Could not open file " << this->GetFileName());
+  // Read the header and both data blocks, either from a memory mapping of
+  // the file or through a stream.
+  vtkFSIO::SurfaceReadOptions options;
+  options.UseMemoryMap = this->UseMemoryMap;
+  options.ApplyScannerTransform = this->ApplyScannerTransform;
+  if (outInfo->Has(vtkStreamingDemandDrivenPipeline::UPDATE_NUMBER_OF_PIECES()))
+    {
+    options.Piece = outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_PIECE_NUMBER());
+    options.NumberOfPieces = outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_NUMBER_OF_PIECES());
+    }
+  vtkFSIO::SurfaceData data;
+  vtkFSIO::ReadStatus status = vtkFSIO::ReadSurfaceFile(this->GetFileName(), options, data);
+  const vtkFSIO::VolumeGeometry& geometry = data.Geometry;
+  this->VolumeGeometryValid = geometry.Valid;
+  this->SetVolumeFileName(geometry.FileName.empty() ? nullptr : geometry.FileName.c_str());
+  for (int i = 0; i < 3; i++)
+    {
+    this->VolumeDimensions[i] = geometry.Dimensions[i];
+    this->VoxelSize[i] = geometry.VoxelSize[i];
+    this->XRAS[i] = geometry.XRAS[i];
+    this->YRAS[i] = geometry.YRAS[i];
+    this->ZRAS[i] = geometry.ZRAS[i];
+    this->CRAS[i] = geometry.CRAS[i];
+    }
+  if (!status.IsOk())
+    {
+    vtkErrorMacro(<< status.Message);
     return 1;
-  }
+    }
+  if (this->ApplyScannerTransform && !geometry.Valid)
+    {
+    vtkWarningMacro("No valid volume geometry in " << this->GetFileName() << ", vertices are left in tkreg coordinates");
+    }
+  thisStep++;
+  this->UpdateProgress(1.0*thisStep/totalSteps);
 
-  // Get the three byte magic number. We support two file types.
-  vtkFSIO::ReadInt3 (surfaceFile, magicNumber);
-  if (magicNumber != vtkFSSurfaceReader::FS_QUAD_FILE_MAGIC_NUMBER &&
-      magicNumber != vtkFSSurfaceReader::FS_NEW_QUAD_FILE_MAGIC_NUMBER &&
-      magicNumber != vtkFSSurfaceReader::FS_TRIANGLE_FILE_MAGIC_NUMBER) {
-    vtkErrorMacro (<< "vtkFSSurfaceReader.cxx Execute: Wrong file type when loading " << this->GetFileName() << "\n magic number = " << magicNumber << ". Supported ar " << vtkFSSurfaceReader::FS_QUAD_FILE_MAGIC_NUMBER << ", " << vtkFSSurfaceReader::FS_NEW_QUAD_FILE_MAGIC_NUMBER << ", and " << vtkFSSurfaceReader::FS_TRIANGLE_FILE_MAGIC_NUMBER );
-    return 1;
-  }
+  numVerticesPerFace = data.NumberOfVerticesPerFace;
+  numVertices = data.NumberOfVertices;
+  numFaces = data.NumberOfFaces;
 
 #if FS_DEBUG
-  switch (magicNumber) {
+  switch (data.MagicNumber) {
   case vtkFSSurfaceReader::FS_QUAD_FILE_MAGIC_NUMBER:
     cerr << "Reading old quad file" << endl;
     break;
@@ -119,338 +162,122 @@ int vtkFSSurfaceReader::RequestData(
     cerr << "Reading triangle file" << endl;
     break;
   }
+  cerr << numVertices << " vertices, " << numFaces << " faces" << endl;
 #endif
 
+  // Allocate our VTK arrays. The decoded vertices are handed over to the
+  // points without a copy.
+  vtkNew<vtkFloatArray> vertexData;
+  vertexData->SetNumberOfComponents(3);
+  vertexData->SetArray(data.Points.Release(), 3 * static_cast<vtkIdType>(numVertices), 0);
+  outputVertices = vtkPoints::New();
+  outputVertices->SetData(vertexData);
+  outputFaces = vtkCellArray::New();
 
-  // Triangle file has some kind of header string at the
-  // beginning. Skip it.
-  if (vtkFSSurfaceReader::FS_TRIANGLE_FILE_MAGIC_NUMBER == magicNumber)
+  vtkDebugMacro(<<"Read " << numVertices << " vertices and " << numFaces << " faces");
+
+  // The decoded face block is used as the cell connectivity as is, so
+  // the offsets are all that is left to fill in. Quads can be split into
+  // two triangles each on the way.
+  vtkIdType cellSize = numVerticesPerFace;
+  vtkIdType numCells = numFaces;
+  if (this->TriangulateQuads &&
+      numVerticesPerFace == vtkFSSurfaceReader::FS_NUM_VERTS_IN_QUAD_FACE)
+    {
+    cellSize = vtkFSSurfaceReader::FS_NUM_VERTS_IN_TRI_FACE;
+    numCells = 2 * static_cast<vtkIdType>(numFaces);
+    }
+  if (numCells * cellSize > VTK_TYPE_INT32_MAX)
+    {
+    vtkErrorMacro("Too many faces (" << numCells << ") in " << this->GetFileName());
+    outputVertices->Delete();
+    outputFaces->Delete();
+    return 1;
+    }
+  vtkFSIO::Buffer<int> triangles;
+  if (cellSize != numVerticesPerFace &&
+      !vtkFSIO::TriangulateQuads(data.Faces.GetData(), numFaces, triangles))
+    {
+    vtkErrorMacro("Error allocating " << numCells << " triangles for " << this->GetFileName());
+    outputVertices->Delete();
+    outputFaces->Delete();
+    return 1;
+    }
+  vtkFSIO::Buffer<int>& cells = cellSize != numVerticesPerFace ? triangles : data.Faces;
+  vtkNew<vtkTypeInt32Array> connectivity;
+  connectivity->SetArray(cells.Release(), numCells * cellSize, 0);
+
+#if VTK_MAJOR_VERSION >= 9
+  vtkNew<vtkTypeInt32Array> offsets;
+  offsets->SetNumberOfValues(numCells + 1);
+  int* offsetValues = offsets->GetPointer(0);
+  vtkSMPTools::For(0, numCells + 1, FS_DECODE_GRAIN_SIZE,
+    [offsetValues, cellSize](vtkIdType begin, vtkIdType end)
     {
-    char *skipchars = fgets (line, 200, surfaceFile);
-    int skip = fscanf (surfaceFile, "\n");
-    if (skipchars == nullptr || skip > 0)
+    for (vtkIdType i = begin; i < end; i++)
       {
-      // trying to avoid unused var warnings while checking return values
+      offsetValues[i] = static_cast<int>(i * cellSize);
       }
-    }
-
-  // Triangle files use normal ints to store their number of vertices
-  // and faces, while quad files use three byte ints.
-  size_t retval;
-  switch (magicNumber)
+    });
+  outputFaces->SetData(offsets, connectivity);
+#else
+  // Before VTK 9, cell arrays only take the legacy layout where each cell
+  // is its size followed by its point ids.
+  vtkNew<vtkIdTypeArray> legacyCells;
+  legacyCells->SetNumberOfValues(numCells * (cellSize + 1));
+  vtkIdType* legacyValues = legacyCells->GetPointer(0);
+  const int* connectivityValues = connectivity->GetPointer(0);
+  vtkSMPTools::For(0, numCells, FS_DECODE_GRAIN_SIZE,
+    [legacyValues, connectivityValues, cellSize](vtkIdType begin, vtkIdType end)
     {
-    case vtkFSSurfaceReader::FS_QUAD_FILE_MAGIC_NUMBER:
-    case vtkFSSurfaceReader::FS_NEW_QUAD_FILE_MAGIC_NUMBER:
-      vtkFSIO::ReadInt3 (surfaceFile, numVertices);
-      vtkFSIO::ReadInt3 (surfaceFile, numFaces);
-      break;
-    case vtkFSSurfaceReader::FS_TRIANGLE_FILE_MAGIC_NUMBER:
-      retval = fread (&numVertices, sizeof(int), 1, surfaceFile);
-      if (retval == 1)
-        {
-        vtkByteSwap::Swap4BE (&numVertices);
-        }
-      else
-        {
-        vtkErrorMacro("Error reading number of vertices");
-        }
-      retval = fread (&numFaces, sizeof(int), 1, surfaceFile);
-      if (retval == 1)
-        {
-        vtkByteSwap::Swap4BE (&numFaces);
-        }
-      else
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      vtkIdType* cell = legacyValues + i * (cellSize + 1);
+      cell[0] = cellSize;
+      for (vtkIdType j = 0; j < cellSize; j++)
         {
-        vtkErrorMacro("Error reading number of faces");
+        cell[j + 1] = connectivityValues[i * cellSize + j];
         }
-      break;
-    }
-
-  // In quad files, we want to skip every other face but count twice
-  // as many of them. This has to do with the way they are stored;
-  // here we just generate quads where as in the old code they
-  // generated tries from the quads. (Trust me.) In tri files, we use
-  // every face.
-  switch (magicNumber) {
-  case vtkFSSurfaceReader::FS_QUAD_FILE_MAGIC_NUMBER:
-  case vtkFSSurfaceReader::FS_NEW_QUAD_FILE_MAGIC_NUMBER:
-    faceIncrement = 2;
-    faceMultiplier = 2;
-    break;
-  case vtkFSSurfaceReader::FS_TRIANGLE_FILE_MAGIC_NUMBER:
-    faceIncrement = 1;
-    faceMultiplier = 1;
-    break;
-  }
-
-#if FS_DEBUG
-  cerr << numVertices << " vertices, " << numFaces * faceMultiplier << " faces" << endl;
-#endif
-
-  // If quad files, there are four vertices per face, in tri files,
-  // there are three.
-  switch (magicNumber) {
-  case vtkFSSurfaceReader::FS_QUAD_FILE_MAGIC_NUMBER:
-  case vtkFSSurfaceReader::FS_NEW_QUAD_FILE_MAGIC_NUMBER:
-    numVerticesPerFace = vtkFSSurfaceReader::FS_NUM_VERTS_IN_QUAD_FACE;
-    break;
-  case vtkFSSurfaceReader::FS_TRIANGLE_FILE_MAGIC_NUMBER:
-    numVerticesPerFace = vtkFSSurfaceReader::FS_NUM_VERTS_IN_TRI_FACE;
-    break;
-  }
-
-  // Allocate our VTK arrays.
-  outputVertices = vtkPoints::New();
-  outputVertices->Allocate (numVertices);
-  outputFaces = vtkCellArray::New();
-  outputFaces->Allocate (outputFaces->EstimateSize(numFaces,
-                           numVerticesPerFace));
-#if FS_CALC_NORMALS
-  outputNormals = vtkFloatArray::New();
-  outputNormals->Allocate (numVertices);
-  outputNormals->SetNumberOfComponents (3);
-  outputNormals->SetName ("Normals");
-
-  // Allocate our vertex and face connectivity arrays for calculating
-  // the normals. If we can't, no big deal.
-  vertices = (FSVertex*) calloc (numVertices, sizeof(FSVertex));
-  faces = (FSFace*) calloc (numFaces, sizeof(FSFace));
-  if (nullptr == vertices || nullptr == faces) {
-    vtkErrorMacro (<< "Couldn't allocate vertex or face connectivity "
-           "structures, unable to calc normals");
-  }
-#endif
-
-  totalSteps = numVertices + (numFaces*faceMultiplier/faceIncrement * numVerticesPerFace);
-#if FS_CALC_NORMALS
-  if (nullptr != vertices && nullptr != faces) {
-      for (vIndex = 0; vIndex < numVertices; vIndex++) {
-          fv1 = &vertices[vIndex];
-          for (fvIndex = 0; fvIndex < fv1->numFaces; fvIndex++) {
-              totalSteps++;
-          }
       }
-  }
+    });
+  outputFaces->SetCells(numCells, legacyCells);
 #endif
-  vtkDebugMacro(<<"Got total steps = " << totalSteps);
-
-  // For each vertex...
-  for (vIndex = 0; vIndex < numVertices; vIndex++) {
-
-      thisStep++;
-
-      // Depending on the file type, read in three two bytes ints and
-      // convert them from meters to millimeters or read in three floats
-      // in millimeters. Insert them into the vertices array.  The old
-      // quad format uses the ints and the new quad and triangle formats
-      // use floats.
-      switch (magicNumber) {
-      case vtkFSSurfaceReader::FS_QUAD_FILE_MAGIC_NUMBER:
-          vtkFSIO::ReadInt2 (surfaceFile, tmpX);
-          vtkFSIO::ReadInt2 (surfaceFile, tmpY);
-          vtkFSIO::ReadInt2 (surfaceFile, tmpZ);
-          locations[0] = (float)tmpX / 100.0;
-          locations[1] = (float)tmpY / 100.0;
-          locations[2] = (float)tmpZ / 100.0;
-          break;
-      case vtkFSSurfaceReader::FS_NEW_QUAD_FILE_MAGIC_NUMBER:
-      case vtkFSSurfaceReader::FS_TRIANGLE_FILE_MAGIC_NUMBER:
-          vtkFSIO::ReadFloat (surfaceFile, locations[0]);
-          vtkFSIO::ReadFloat (surfaceFile, locations[1]);
-          vtkFSIO::ReadFloat (surfaceFile, locations[2]);
-          break;
-      }
-
-      outputVertices->InsertNextPoint (locations);
-
-#if FS_CALC_NORMALS
-    // If we have connectivity info, fill out the location and
-    // initialize the normals to 0 for this vertex.
-      if (nullptr != vertices && nullptr != faces) {
-          v = &vertices[vIndex];
-          v->x = locations[0];
-          v->y = locations[1];
-          v->z = locations[2];
-          v->nx = 0;
-          v->ny = 0;
-          v->nz = 0;
-          v->numFaces = 0;
+  thisStep++;
+  this->UpdateProgress(1.0*thisStep/totalSteps);
+
+  // FreeSurfer surfaces are consistently oriented, with the faces wound
+  // counterclockwise seen from outside, so the normals need no orienting.
+  // A scanner transform with a negative determinant mirrors the surface.
+  vtkSmartPointer<vtkFloatArray> outputNormals;
+  if (this->ComputeNormals)
+    {
+    double transform[12];
+    bool flip = false;
+    if (this->ApplyScannerTransform && vtkFSIO::GetScannerTransform(geometry, transform))
+      {
+      const double determinant =
+        transform[0] * (transform[5] * transform[10] - transform[6] * transform[9]) -
+        transform[1] * (transform[4] * transform[10] - transform[6] * transform[8]) +
+        transform[2] * (transform[4] * transform[9] - transform[5] * transform[8]);
+      flip = determinant < 0.0;
       }
-
-#endif
-      if ((thisStep % 1000) == 0)
+    vtkFSIO::Buffer<float> normals;
+    if (vtkFSIO::ComputeVertexNormals(vertexData->GetPointer(0), numVertices,
+                                      connectivity->GetPointer(0), numCells, cellSize, flip, normals))
       {
-          this->UpdateProgress(1.0*thisStep/totalSteps);
+      outputNormals = vtkSmartPointer<vtkFloatArray>::New();
+      outputNormals->SetName("Normals");
+      outputNormals->SetNumberOfComponents(3);
+      outputNormals->SetArray(normals.Release(), 3 * static_cast<vtkIdType>(numVertices), 0);
       }
-  }
-
-  // For each face...
-  for (fIndex = 0;
-       fIndex < numFaces * faceMultiplier;
-       fIndex += faceIncrement) {
-
-    // For each vertex in the face...
-    for (fvIndex = 0; fvIndex < numVerticesPerFace; fvIndex++) {
-
-        thisStep++;
-
-        // Read in a vertex index. Triangle format gets a normal int,
-        // quad formats get three byte ints.
-        switch (magicNumber) {
-        case vtkFSSurfaceReader::FS_QUAD_FILE_MAGIC_NUMBER:
-        case vtkFSSurfaceReader::FS_NEW_QUAD_FILE_MAGIC_NUMBER:
-            vtkFSIO::ReadInt3 (surfaceFile, tmpfIndex);
-            break;
-        case vtkFSSurfaceReader::FS_TRIANGLE_FILE_MAGIC_NUMBER:
-            retval = fread (&tmpfIndex, sizeof(int), 1, surfaceFile);
-            if (retval == 1)
-              {
-              vtkByteSwap::Swap4BE (&tmpfIndex);
-              }
-            else
-              {
-              vtkErrorMacro("Error reading integer at index " << fvIndex);
-              }
-            break;
-        }
-
-        faceIndices[fvIndex] = tmpfIndex;
-
-#if FS_CALC_NORMALS
-        // Fill out connectivity info for this face. Get the vertex from
-        // the vertex index and add this face index to its list of
-        // faces. Then add this vertex index to the list of indices in
-        // the face.
-        if (nullptr != vertices && nullptr != faces) {
-            v = &vertices[tmpfIndex];
-            v->faces[v->numFaces] = fIndex;
-            v->indicesInFace[v->numFaces] = fvIndex;
-            v->numFaces++;
-
-            f = &faces[fIndex];
-            f->vertices[fvIndex] = tmpfIndex;
-        }
-#endif
-    }
-
-    // Add the face to the list.
-    outputFaces->InsertNextCell (numVerticesPerFace, faceIndices);
-    if ((thisStep % 1000) == 0)
-    {
-        this->UpdateProgress(1.0*thisStep/totalSteps);
+    thisStep++;
+    this->UpdateProgress(1.0*thisStep/totalSteps);
     }
-  }
-
-  // Close the surface file.
-  fclose (surfaceFile);
 
 #if FS_DEBUG
   cerr << "Done reading surface." << endl;
 #endif
 
-#if FS_CALC_NORMALS
-
-  // If we allocated the space for our vertex and face connectivity,
-  // calculate the normals.
-  if (nullptr != vertices && nullptr != faces) {
-      // For each vertex...
-      for (vIndex = 0; vIndex < numVertices; vIndex++) {
-
-          // For each face it is a part of...
-          fv1 = &vertices[vIndex];
-          for (fIndex = 0; fIndex < fv1->numFaces; fIndex++) {
-
-              thisStep++;
-
-              // Get this face. fv1->indicesInFace tells us which index,
-              // 0 - numVerticesPerFace-1, it is in the face. Get the two
-              // indices surrounding it so we can get the vertices
-              // surrounding it. Now we have fv0, fv1, and fv2 which are all
-              // adjacent in the face, with fv1 being the original vertex.
-              f = &faces[fv1->faces[fIndex]];
-              fvIndex1 = fv1->indicesInFace[fIndex];
-              if (0 == fvIndex1)
-                  fvIndex0 = numVerticesPerFace - 1;
-              else
-                  fvIndex0 = fvIndex1 - 1;
-              if (numVerticesPerFace == fvIndex1)
-                  fvIndex2 = 0;
-              else
-                  fvIndex2 = fvIndex1 + 1;
-
-              fv0 = &vertices[f->vertices[fvIndex0]];
-              fv2 = &vertices[f->vertices[fvIndex2]];
-
-              // Get two vectors from these points and normalize them. Then
-              // just cross them to get the perpendicular vector. This is
-              // the normal for the face. Add this to the normal for the
-              // vertex.
-              faceVector0[0] = fv1->x - fv0->x;
-              faceVector0[1] = fv1->y - fv0->y;
-              faceVector0[2] = fv1->z - fv0->z;
-              faceVector1[0] = fv2->x - fv1->x;
-              faceVector1[1] = fv2->y - fv1->y;
-              faceVector1[2] = fv2->z - fv1->z;
-              length = sqrt( faceVector0[0]*faceVector0[0] +
-                             faceVector0[1]*faceVector0[1] +
-                             faceVector0[2]*faceVector0[2] );
-              if (length > 0) {
-                  faceVector0[0] /= length;
-                  faceVector0[1] /= length;
-                  faceVector0[2] /= length;
-              }
-              length = sqrt( faceVector1[0]*faceVector1[0] +
-                             faceVector1[1]*faceVector1[1] +
-                             faceVector1[2]*faceVector1[2] );
-              if (length > 0) {
-                  faceVector1[0] /= length;
-                  faceVector1[1] /= length;
-                  faceVector1[2] /= length;
-              }
-
-              // get the cross product
-              faceNormal[0] = -faceVector1[1]*faceVector0[2] +
-                  faceVector0[1]*faceVector1[2];
-              faceNormal[1] = faceVector1[0]*faceVector0[2] -
-                  faceVector0[0]*faceVector1[2];
-              faceNormal[2] = -faceVector1[0]*faceVector0[1] +
-                  faceVector0[0]*faceVector1[1];
-
-              // add it to the normal vector at this vertex.
-              fv1->nx += faceNormal[0];
-              fv1->ny += faceNormal[1];
-              fv1->nz += faceNormal[2];
-          }
-
-          // When all the faces for this vertex have been processed, the
-          // normal at the vertex is the sum of all the normals for the
-          // adjacent faces. Normalize it and we're done.
-          faceNormal[0] = fv1->nx;
-          faceNormal[1] = fv1->ny;
-          faceNormal[2] = fv1->nz;
-          length = sqrt( faceNormal[0]*faceNormal[0] +
-                         faceNormal[1]*faceNormal[1] +
-                         faceNormal[2]*faceNormal[2] );
-          if (length > 0) {
-              faceNormal[0] /= length;
-              faceNormal[1] /= length;
-              faceNormal[2] /= length;
-          }
-
-          if ((thisStep % 1000) == 0)
-          {
-              this->UpdateProgress(1.0*thisStep/totalSteps);
-          }
-
-          // Add the final normal to the array.
-          outputNormals->InsertNextTuple(faceNormal);
-      }
-
-      free (vertices);
-      free (faces);
-  }
-#endif
-
   // Set all the arrays in the output.
   output->SetPoints (outputVertices);
   outputVertices->Delete();
@@ -458,13 +285,20 @@ int vtkFSSurfaceReader::RequestData(
   this->SetProgressText("");
   this->UpdateProgress(0.0);
 
-#if FS_CALC_NORMALS
-  output->GetPointData()->SetNormals (outputNormals);
-  outputNormals->Delete();
-#endif
+  if (outputNormals)
+    {
+    output->GetPointData()->SetNormals(outputNormals);
+    }
 
+  if (options.NumberOfPieces > 1)
+    {
+    vtkNew<vtkIdTypeArray> originalIds;
+    originalIds->SetName("vtkOriginalPointIds");
+    originalIds->SetNumberOfValues(numVertices);
+    std::copy(data.PointIds.GetData(), data.PointIds.GetData() + numVertices, originalIds->GetPointer(0));
+    output->GetPointData()->AddArray(originalIds);
+    }
 
-  outputFaces->Squeeze();
   output->SetPolys(outputFaces);
   outputFaces->Delete();
 
@@ -475,4 +309,16 @@ int vtkFSSurfaceReader::RequestData(
 void vtkFSSurfaceReader::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "UseMemoryMap: " << (this->UseMemoryMap ? "true" : "false") << "\n";
+  os << indent << "TriangulateQuads: " << (this->TriangulateQuads ? "true" : "false") << "\n";
+  os << indent << "ApplyScannerTransform: " << (this->ApplyScannerTransform ? "true" : "false") << "\n";
+  os << indent << "ComputeNormals: " << (this->ComputeNormals ? "true" : "false") << "\n";
+  os << indent << "VolumeGeometryValid: " << (this->VolumeGeometryValid ? "true" : "false") << "\n";
+  os << indent << "VolumeFileName: " << (this->VolumeFileName ? this->VolumeFileName : "(none)") << "\n";
+  os << indent << "VolumeDimensions: " << this->VolumeDimensions[0] << " " << this->VolumeDimensions[1] << " " << this->VolumeDimensions[2] << "\n";
+  os << indent << "VoxelSize: " << this->VoxelSize[0] << " " << this->VoxelSize[1] << " " << this->VoxelSize[2] << "\n";
+  os << indent << "XRAS: " << this->XRAS[0] << " " << this->XRAS[1] << " " << this->XRAS[2] << "\n";
+  os << indent << "YRAS: " << this->YRAS[0] << " " << this->YRAS[1] << " " << this->YRAS[2] << "\n";
+  os << indent << "ZRAS: " << this->ZRAS[0] << " " << this->ZRAS[1] << " " << this->ZRAS[2] << "\n";
+  os << indent << "CRAS: " << this->CRAS[0] << " " << this->CRAS[1] << " " << this->CRAS[2] << "\n";
 }
@@ -19,10 +19,6 @@
 /// Prints debugging info.
 #define FS_DEBUG 0
 
-/// This code can calc normals but it doesn't seem to do so very well
-/// (bug?) and vtkPolyDataNormals does it anyway.
-#define FS_CALC_NORMALS 0
-
 class vtkInformation;
 class vtkInformationVector;
 class vtkPolyData;
@@ -31,6 +27,14 @@ class vtkPolyData;
 ///
 /// Reads a surface file from FreeSurfer and output PolyData. Use the
 /// SetFileName function to specify the file name.
+/// Gzip compressed files are read transparently.
+///
+/// The reader can handle piece requests: piece i of n holds the i-th of n
+/// contiguous ranges of faces and only the vertices they use, in file
+/// order, with their index in the file in a "vtkOriginalPointIds" point
+/// data array. Vertices shared by faces of different pieces are repeated
+/// in each of them; ghost levels are not generated, so normals computed
+/// for a piece only account for its own faces.
 class VTK_FreeSurfer_EXPORT vtkFSSurfaceReader : public vtkAbstractPolyDataReader
 {
 public:
@@ -46,41 +50,84 @@ public:
       FS_TRIANGLE_FILE_MAGIC_NUMBER = (-2 & 0x00ffffff),
       FS_NUM_VERTS_IN_QUAD_FACE = 4, /// dealing with quads
       FS_NUM_VERTS_IN_TRI_FACE = 3, /// dealing with tris
-      FS_MAX_NUM_FACES_PER_VERTEX = 10, /// kinda arbitrary
   };
 
+  /// If enabled, the file is memory mapped and the vertex and face
+  /// blocks are decoded straight from the mapping instead of being read
+  /// through stdio. Off by default.
+  vtkSetMacro(UseMemoryMap, bool);
+  vtkGetMacro(UseMemoryMap, bool);
+  vtkBooleanMacro(UseMemoryMap, bool);
+
+  /// If enabled, the faces of old and new quad files are output as two
+  /// triangles each instead of as quads. Triangle files are not affected.
+  /// Off by default.
+  vtkSetMacro(TriangulateQuads, bool);
+  vtkGetMacro(TriangulateQuads, bool);
+  vtkBooleanMacro(TriangulateQuads, bool);
+
+  /// If enabled, the vertices of triangle files that store a valid volume
+  /// geometry are moved from tkreg (surface) RAS to scanner RAS while they
+  /// are decoded. Other files are left in tkreg coordinates. Off by default.
+  /// \sa vtkFSSurfaceHelper::ComputeTkRegToScannerRASMatrix
+  vtkSetMacro(ApplyScannerTransform, bool);
+  vtkGetMacro(ApplyScannerTransform, bool);
+  vtkBooleanMacro(ApplyScannerTransform, bool);
+
+  /// If enabled, area weighted vertex normals are computed while reading
+  /// and set as the point data normals of the output. FreeSurfer surfaces
+  /// are consistently oriented, so they don't need to go through
+  /// vtkPolyDataNormals consistency and orientation passes. Off by default.
+  vtkSetMacro(ComputeNormals, bool);
+  vtkGetMacro(ComputeNormals, bool);
+  vtkBooleanMacro(ComputeNormals, bool);
+
+  /// Volume geometry found after the faces of the last triangle file read:
+  /// whether it is valid, the volume file name, dimensions and voxel size,
+  /// the direction cosines of the volume axes and the volume center.
+  /// VolumeGeometryValid is false if the file has no geometry.
+  vtkGetMacro(VolumeGeometryValid, bool);
+  vtkGetStringMacro(VolumeFileName);
+  vtkGetVector3Macro(VolumeDimensions, int);
+  vtkGetVector3Macro(VoxelSize, double);
+  vtkGetVector3Macro(XRAS, double);
+  vtkGetVector3Macro(YRAS, double);
+  vtkGetVector3Macro(ZRAS, double);
+  vtkGetVector3Macro(CRAS, double);
+
 protected:
   vtkFSSurfaceReader();
   ~vtkFSSurfaceReader() override;
 
+  int RequestInformation(
+    vtkInformation *,
+    vtkInformationVector **,
+    vtkInformationVector *outputVector) override;
   int RequestData(
     vtkInformation *,
     vtkInformationVector **,
     vtkInformationVector *outputVector) override;
 
+  vtkSetStringMacro(VolumeFileName);
+
+  bool UseMemoryMap;
+  bool TriangulateQuads;
+  bool ApplyScannerTransform;
+  bool ComputeNormals;
+
+  bool VolumeGeometryValid;
+  char* VolumeFileName;
+  int VolumeDimensions[3];
+  double VoxelSize[3];
+  double XRAS[3];
+  double YRAS[3];
+  double ZRAS[3];
+  double CRAS[3];
+
 private:
   vtkFSSurfaceReader(const vtkFSSurfaceReader&) = delete;
   void operator=(const vtkFSSurfaceReader&) = delete;
 };
 
 
-/// If we're going to try to do normals, we need to keep some
-/// connectivity information for the verts and faces. Use these
-/// structures.
-#if FS_CALC_NORMALS
-struct VertexStruct {
-  int numFaces;
-  int faces[FS_MAX_NUM_FACES_PER_VERTEX];
-  int indicesInFace[FS_MAX_NUM_FACES_PER_VERTEX];
-  float x, y, z;
-  float nx, ny, nz;
-};
-using Vertex = struct VertexStruct;
-
-struct FaceStruct {
-  int vertices[FS_NUM_SIDES_IN_FACE];
-};
-using Face = struct FaceStruct;
-#endif
-
 #endif
@@ -13,11 +13,10 @@
 =========================================================================auto=*/
 
 // FreeSurfer includes
-#include "vtkFSIO.h"
+#include "vtkFSReaderCore.h"
 #include "vtkFSSurfaceScalarReader.h"
 
 // VTK includes
-#include <vtkByteSwap.h>
 #include <vtkFloatArray.h>
 #include <vtkObjectFactory.h>
 
@@ -28,6 +27,8 @@ vtkStandardNewMacro(vtkFSSurfaceScalarReader);
 vtkFSSurfaceScalarReader::vtkFSSurfaceScalarReader()
 {
     this->Scalars = nullptr;
+    this->ValueRange[0] = 0.0;
+    this->ValueRange[1] = 0.0;
 }
 
 //-------------------------------------------------------------------------
@@ -48,15 +49,6 @@ void vtkFSSurfaceScalarReader::SetOutput(vtkFloatArray *output)
 //-------------------------------------------------------------------------
 int vtkFSSurfaceScalarReader::ReadFSScalars()
 {
-  FILE* scalarFile;
-  int magicNumber;
-  int numValues = 0;
-  int numFaces = 0;
-  int numValuesPerPoint = 0;
-  int vIndex;
-  int ivalue;
-  float fvalue;
-  float *FSscalars;
   vtkFloatArray *output = this->Scalars;
 
   if (output == nullptr)
@@ -64,122 +56,35 @@ int vtkFSSurfaceScalarReader::ReadFSScalars()
       cerr << "ERROR vtkFSSurfaceScalarReader ReadFSScalars() : output is null" << endl;
       return 0;
   }
-  vtkDebugMacro( << "vtkFSSurfaceScalarReader Execute() " << endl);
-
-  if (!this->GetFileName()) {
-    vtkErrorMacro(<<"vtkFSSurfaceScalarReader Execute: FileName not specified.");
-    return 0;
-  }
-
   vtkDebugMacro(<<"Reading surface scalar data...");
 
-  // Try to open the file.
-  scalarFile = fopen(this->GetFileName(), "rb") ;
-  if (!scalarFile) {
-    vtkErrorMacro (<< "Could not open file " << this->GetFileName());
+  // The file is decoded into a buffer of our own, old style files (short
+  // values divided by 100) as well as new style ones (floats).
+  vtkFSIO::ScalarData data;
+  vtkFSIO::ReadStatus status = vtkFSIO::ReadScalarFile (this->GetFileName(), data);
+  if (!status.IsOk()) {
+    vtkErrorMacro (<< "vtkFSSurfaceScalarReader ReadFSScalars: " << status.Message);
     return 0;
   }
-
-
-  // In the old file type, there is no magin number; the first three
-  // byte int is the number of values. In the (more common) new type,
-  // the first three bytes is the magic number. So read three bytes
-  // and assume it's a magic number, check and assign it to the number
-  // of values if not. New style files also have a number of faces and
-  // values per point, which aren't really used.
-  vtkFSIO::ReadInt3 (scalarFile, magicNumber);
-  if (this->FS_NEW_SCALAR_MAGIC_NUMBER == magicNumber)
-    {
-    size_t retval;
-    retval = fread (&numValues, sizeof(int), 1, scalarFile);
-    if (retval == 1)
-      {
-      vtkByteSwap::Swap4BE (&numValues);
-      }
-    else
-      {
-      vtkErrorMacro("Error reading number of values from file " << this->GetFileName());
-      }
-    retval = fread (&numFaces, sizeof(int), 1, scalarFile);
-    if (retval == 1)
-      {
-      vtkByteSwap::Swap4BE (&numFaces);
-      }
-    else
-      {
-      vtkErrorMacro("Error reading number of faces from file " << this->GetFileName());
-      }
-    retval = fread (&numValuesPerPoint, sizeof(int), 1, scalarFile);
-    if (retval == 1)
-      {
-      vtkByteSwap::Swap4BE (&numValuesPerPoint);
-      }
-    else
-      {
-      vtkErrorMacro("Error reading number of values per point, should be 1, in filename " << this->GetFileName());
-      }
-
-    if (numValuesPerPoint != 1) {
-      vtkErrorMacro (<< "vtkFSSurfaceScalarReader.cxx Execute: Number of values per point is not 1, can't process file.");
-      return 0;
-    }
-
-  } else {
-    numValues = magicNumber;
-  }
-
-  if (numValues <= 0) {
-    vtkErrorMacro (<< "vtkFSSurfaceScalarReader.cxx Execute: Number of vertices is 0 or negative, can't process file.");
-      return 0;
-  }
-
-  // Make our float array.
-  FSscalars = (float*) calloc (numValues, sizeof(float));
-
-  // For each value, if it's a new style file read a float, otherwise
-  // read a two byte int and divide it by 100. Add this value to the
-  // array.
-  for (vIndex = 0; vIndex < numValues; vIndex ++ ) {
-
-    if (feof(scalarFile)) {
-      vtkErrorMacro (<< "vtkFSSurfaceScalarReader.cxx Execute: Unexpected EOF after " << vIndex << " values read.");
-      return 0;
-    }
-
-    if (this->FS_NEW_SCALAR_MAGIC_NUMBER == magicNumber) {
-      size_t retval = fread (&fvalue, sizeof(float), 1, scalarFile);
-      if (retval == 1)
-        {
-        vtkByteSwap::Swap4BE (&fvalue);
-        }
-      else
-        {
-        vtkErrorMacro("Error reading fvalue from file " << this->GetFileName());
-        }
-
-    } else {
-      vtkFSIO::ReadInt2 (scalarFile, ivalue);
-      fvalue = ivalue / 100.0;
-    }
-
-    FSscalars[vIndex] = fvalue;
-
-    if (numValues < 10000 ||
-        (vIndex % 100) == 0)
-    {
-        this->UpdateProgress(1.0*vIndex/numValues);
-    }
-
-  }
+  this->UpdateProgress(1.0);
 
   this->SetProgressText("");
   this->UpdateProgress(0.0);
 
-  // Close the file.
-  fclose (scalarFile);
+  // Hand the buffer over to the output, which frees it.
+  const vtkIdType numValues = static_cast<vtkIdType>(data.Values.GetSize());
+  output->SetArray (data.Values.Release(), numValues, 0);
+  output->SetNumberOfComponents (1);
 
-  // Set the array in our output.
-  output->SetArray (FSscalars, numValues, 0);
+  // The range is only reported by the reader: the array computes its own
+  // when it is first asked for one, and keeps it up to date when modified.
+  if (data.Range[0] <= data.Range[1]) {
+    this->ValueRange[0] = data.Range[0];
+    this->ValueRange[1] = data.Range[1];
+  } else {
+    this->ValueRange[0] = 0.0;
+    this->ValueRange[1] = 0.0;
+  }
 
   return 1;
 }
@@ -188,4 +93,5 @@ int vtkFSSurfaceScalarReader::ReadFSScalars()
 void vtkFSSurfaceScalarReader::PrintSelf(ostream& os, vtkIndent indent)
 {
   vtkDataReader::PrintSelf(os,indent);
+  os << indent << "ValueRange: " << this->ValueRange[0] << " " << this->ValueRange[1] << "\n";
 }
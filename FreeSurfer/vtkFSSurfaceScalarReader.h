@@ -38,6 +38,10 @@ public:
   /// Read the scalars from a file. Return 1 on success, 0 on failure
   int ReadFSScalars();
 
+  /// Range of the values read by the last successful ReadFSScalars,
+  /// computed while they were decoded. NaN values are ignored.
+  vtkGetVector2Macro(ValueRange, double);
+
   /// file type magic numbers
   /// const int FS_NEW_SCALAR_MAGIC_NUMBER = 16777215;
   enum
@@ -49,6 +53,7 @@ protected:
   ~vtkFSSurfaceScalarReader() override;
 
   vtkFloatArray * Scalars;
+  double ValueRange[2];
 
   int ReadInt3 (FILE* iFile, int& oInt);
   int ReadInt2 (FILE* iFile, int& oInt);
@@ -13,12 +13,25 @@
 =========================================================================auto=*/
 
 // FreeSurfer includes
-#include "vtkFSIO.h"
+#include "vtkFSReaderCore.h"
 #include "vtkFSSurfaceWFileReader.h"
 
 // VTK includes
 #include <vtkFloatArray.h>
+#include <vtkIntArray.h>
 #include <vtkObjectFactory.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+/// Minimum number of values scattered by one thread.
+const vtkIdType FS_W_DECODE_GRAIN_SIZE = 16 * 1024;
+}
 
 //-------------------------------------------------------------------------
 vtkStandardNewMacro(vtkFSSurfaceWFileReader);
@@ -28,10 +41,17 @@ vtkFSSurfaceWFileReader::vtkFSSurfaceWFileReader()
 {
   this->Scalars = nullptr;
   this->NumberOfVertices = 0;
+  this->SparseOutput = false;
+  this->SparseIndices = vtkIntArray::New();
+  this->SparseValues = vtkFloatArray::New();
 }
 
 //-------------------------------------------------------------------------
-vtkFSSurfaceWFileReader::~vtkFSSurfaceWFileReader() = default;
+vtkFSSurfaceWFileReader::~vtkFSSurfaceWFileReader()
+{
+  this->SparseIndices->Delete();
+  this->SparseValues->Delete();
+}
 
 //-------------------------------------------------------------------------
 vtkFloatArray * vtkFSSurfaceWFileReader::GetOutput()
@@ -49,59 +69,39 @@ void vtkFSSurfaceWFileReader::SetOutput(vtkFloatArray *output)
 // Returns error codes depending on failure
 int vtkFSSurfaceWFileReader::ReadWFile()
 {
-  FILE* wFile;
-  int magicNumber;
-  int numValues = 0;
   int vIndex;
-  int vIndexFromFile;
-  float fvalue;
-  float *FSscalars;
+  float *FSscalars = nullptr;
   vtkFloatArray *output = this->Scalars;
 
   // Do some basic sanity checks.
-  if (output == nullptr)
+  if (output == nullptr && !this->SparseOutput)
     {
     cerr << "ERROR vtkFSSurfaceWFileReader ReadWFile() : output is null" << endl;
     return this->FS_ERROR_W_OUTPUT_NULL;
     }
-  vtkDebugMacro( << "vtkFSSurfaceWFileReader Execute() " << endl);
-
-  if (!this->GetFileName())
-    {
-    vtkErrorMacro(<<"vtkFSSurfaceWFileReader Execute: FileName not specified.");
-    return this->FS_ERROR_W_NO_FILENAME;
-    }
-
   vtkDebugMacro(<<"Reading surface WFile data...");
 
-  // Try to open the file.
-  wFile = fopen(this->GetFileName(), "rb") ;
-  if (!wFile)
-    {
-    vtkErrorMacro (<< "Could not open file " << this->GetFileName());
-    return this->FS_ERROR_W_OPEN;
-    }
-
-  // I'm not sure what this is. In the original FreeSurfer code, there
-  // is this:
-  //
-  //    fread2(&ilat,fp);
-  //    lat = ilat/10.0;
-  //
-  // And then the lat variable is not used again. Maybe it was a scale
-  // factor of some kind? No idea.
-  vtkFSIO::ReadInt2 (wFile, magicNumber);
-
-  // This is the number of values in the wfile.
-  vtkFSIO::ReadInt3 (wFile, numValues);
-  if (numValues < 0)
+  // Read all the index/value pairs. The wfile is weird in that there is
+  // a 3 byte int index and float value pair for every value. I guess
+  // this means that the wfile could have fewer values than the number of
+  // vertices in the surface, but I've never seen this happen in
+  // practice. Additionally, these are usually written with indices from
+  // 0->nvertices, so this index value isn't even really needed.
+  vtkFSIO::WFileData data;
+  vtkFSIO::ReadStatus status = vtkFSIO::ReadWFile (this->GetFileName(), data);
+  if (!status.IsOk())
     {
-    vtkErrorMacro (<< "vtkFSSurfaceWFileReader.cxx Execute: Number of vertices is 0 or negative, can't process file.");
-    return this->FS_ERROR_W_NUM_VALUES;
+    vtkErrorMacro (<< "vtkFSSurfaceWFileReader ReadWFile: " << status.Message);
+    return status.ErrorCode;
     }
-
-  // Check to see that NumberOfVertices was set and is larger than number of values
-  if (this->NumberOfVertices == 0)
+  const int numValues = static_cast<int>(data.Values.GetSize());
+  const int* indices = data.Indices.GetData();
+  const float* values = data.Values.GetData();
+
+  // Check to see that NumberOfVertices was set and is larger than number of values.
+  // Sparse output doesn't need it, the indices are then only checked if it is set.
+  const bool checkIndices = !this->SparseOutput || this->NumberOfVertices != 0;
+  if (this->NumberOfVertices == 0 && !this->SparseOutput)
     {
     // it wasn't set, use numValues
     vtkErrorMacro(<<"vtkFSSurfaceWFileReader: Number of vertices in the associated scalar file has not been set, using number of values in the file");
@@ -110,45 +110,29 @@ int vtkFSSurfaceWFileReader::ReadWFile()
 
   vtkDebugMacro(<<"vtkFSSurfaceWFileReader: numValues = " << numValues << ", numVertices = " << this->NumberOfVertices);
 
-  // Make our float array.
-  // scalars = (float*) calloc (numValues, sizeof(float));
   // make the array big enough to hold all vertices, calloc inits all values
-  // to zero as a default
-  FSscalars = (float*) calloc (this->NumberOfVertices, sizeof(float));
-  if (FSscalars == nullptr)
+  // to zero as a default. Not needed for sparse output.
+  if (!this->SparseOutput)
     {
-    vtkErrorMacro(<<"vtkFSSurfaceWFileReader: error allocating " << this->NumberOfVertices << " floats!");
-    return this->FS_ERROR_W_ALLOC;
+    FSscalars = (float*) calloc (this->NumberOfVertices, sizeof(float));
+    if (FSscalars == nullptr)
+      {
+      vtkErrorMacro(<<"vtkFSSurfaceWFileReader: error allocating " << this->NumberOfVertices << " floats!");
+      return this->FS_ERROR_W_ALLOC;
+      }
     }
 
-  // For each value in the wfile...
   for (vIndex = 0; vIndex < numValues; vIndex ++ )
     {
-
-    // Check for eof.
-    if (feof(wFile))
-      {
-      vtkErrorMacro (<< "vtkFSSurfaceWFileReader.cxx Execute: Unexpected EOF after " << vIndex << " values read. Tried to read " << numValues);
-      return this->FS_ERROR_W_EOF;
-      }
-
-    // Read the 3 byte int index and float value. The wfile is weird
-    // in that there is an index/value pair for every value. I guess
-    // this means that the wfile could have fewer values than the
-    // number of vertices in the surface, but I've never seen this
-    // happen in practice. Additionally, these are usually written
-    // with indices from 0->nvertices, so this index value isn't even
-    // really needed.
-    vtkFSIO::ReadInt3 (wFile, vIndexFromFile);
-    vtkFSIO::ReadFloat (wFile, fvalue);
+    int vIndexFromFile = indices[vIndex];
 
     // Make sure the index is in bounds. If not, print a warning and
-    // try to do the next value. If this happens, there is probably a
-    // mismatch between the wfile and the surface, but I think there
-    // is a reason for being able to load a mismatched file. But this
-    // should raise some kind of message to the user like, "This wfile
-    // appears to be for a different surface; continue loading?"
-    if (vIndexFromFile < 0 || vIndexFromFile >= this->NumberOfVertices)
+    // stop here. If this happens, there is probably a mismatch between
+    // the wfile and the surface, but I think there is a reason for
+    // being able to load a mismatched file. But this should raise
+    // some kind of message to the user like, "This wfile appears to
+    // be for a different surface; continue loading?"
+    if (vIndexFromFile < 0 || (checkIndices && vIndexFromFile >= this->NumberOfVertices))
       {
       vtkErrorMacro (<< "vtkFSSurfaceWFileReader.cxx Execute: Read an index that is out of bounds (" << vIndexFromFile << " not in 0-" << this->NumberOfVertices << ", breaking.");
       break;
@@ -156,30 +140,98 @@ int vtkFSSurfaceWFileReader::ReadWFile()
 
     // Set the value in the scalars array based on the index we read
     // in, not the index in our for loop.
-    FSscalars[vIndexFromFile] = fvalue;
-
-    if (numValues < 10000 ||
-        (vIndex % 100) == 0)
+    if (FSscalars != nullptr)
       {
-      this->UpdateProgress(1.0*vIndex/numValues);
+      FSscalars[vIndexFromFile] = values[vIndex];
       }
     }
+  this->UpdateProgress(1.0);
 
   this->SetProgressText("");
   this->UpdateProgress(0.0);
 
-  // Close the file.
-  fclose (wFile);
+  if (this->SparseOutput)
+    {
+    // Keep the pairs read before any out of bounds index, sorted by
+    // vertex index. Files are normally written in order already. When
+    // an index is repeated, the value read last wins, as in the dense
+    // array.
+    const int numPairs = vIndex;
+    std::vector<int> order (numPairs);
+    std::iota (order.begin(), order.end(), 0);
+    if (!std::is_sorted (indices, indices + numPairs))
+      {
+      std::stable_sort (order.begin(), order.end(),
+        [indices](int a, int b) { return indices[a] < indices[b]; });
+      }
+    this->SparseIndices->Initialize();
+    this->SparseValues->Initialize();
+    this->SparseIndices->Allocate(numPairs);
+    this->SparseValues->Allocate(numPairs);
+    for (int i = 0; i < numPairs; i++)
+      {
+      if (i + 1 < numPairs && indices[order[i + 1]] == indices[order[i]])
+        {
+        continue;
+        }
+      this->SparseIndices->InsertNextValue(indices[order[i]]);
+      this->SparseValues->InsertNextValue(values[order[i]]);
+      }
+    this->SparseIndices->Squeeze();
+    this->SparseValues->Squeeze();
+    return this->FS_ERROR_W_NONE;
+    }
 
   // Set the array in our output.
-  //output->SetArray (FSscalars, numValues, 0);
   output->SetArray(FSscalars, this->NumberOfVertices, 0);
 
   return this->FS_ERROR_W_NONE;
 }
 
+//-------------------------------------------------------------------------
+int vtkFSSurfaceWFileReader::Densify(vtkFloatArray *output)
+{
+  if (output == nullptr)
+    {
+    return this->FS_ERROR_W_OUTPUT_NULL;
+    }
+  // Without a number of vertices, the array ends at the last index read.
+  const vtkIdType numPairs = this->SparseIndices->GetNumberOfTuples();
+  const int* indices = this->SparseIndices->GetPointer(0);
+  const float* values = this->SparseValues->GetPointer(0);
+  int numVertices = this->NumberOfVertices;
+  if (numVertices == 0 && numPairs > 0)
+    {
+    numVertices = indices[numPairs - 1] + 1;
+    }
+  float *FSscalars = (float*) calloc (numVertices, sizeof(float));
+  if (FSscalars == nullptr && numVertices > 0)
+    {
+    vtkErrorMacro(<<"vtkFSSurfaceWFileReader: error allocating " << numVertices << " floats!");
+    return this->FS_ERROR_W_ALLOC;
+    }
+
+  // Indices are unique, so the values can be scattered concurrently.
+  vtkSMPTools::For(0, numPairs, FS_W_DECODE_GRAIN_SIZE,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType i = begin; i < end; i++)
+      {
+      if (indices[i] >= 0 && indices[i] < numVertices)
+        {
+        FSscalars[indices[i]] = values[i];
+        }
+      }
+    });
+  output->SetArray(FSscalars, numVertices, 0);
+  return this->FS_ERROR_W_NONE;
+}
+
 //-------------------------------------------------------------------------
 void vtkFSSurfaceWFileReader::PrintSelf(ostream& os, vtkIndent indent)
 {
   vtkDataReader::PrintSelf(os,indent);
+  os << indent << "NumberOfVertices: " << this->NumberOfVertices << "\n";
+  os << indent << "SparseOutput: " << (this->SparseOutput ? "true" : "false") << "\n";
+  os << indent << "Number of sparse values: " << this->SparseValues->GetNumberOfTuples() << "\n";
 }
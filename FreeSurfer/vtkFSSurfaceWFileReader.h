@@ -17,6 +17,7 @@
 #include <vtkDataReader.h>
 
 class vtkFloatArray;
+class vtkIntArray;
 
 /// \brief Read a surface w file (*.w) file
 /// from Freesurfer tools.
@@ -25,6 +26,10 @@ class vtkFloatArray;
 /// vtkFloatArray. Use the SetFileName function to specify the file
 /// name. The number of values in the array should be equal to the
 /// number of vertices/points in the surface.
+///
+/// If SparseOutput is on, the values are instead kept as a sorted array
+/// of vertex indices and the matching values, and a dense array is only
+/// filled on request by Densify.
 class VTK_FreeSurfer_EXPORT vtkFSSurfaceWFileReader : public vtkDataReader
 {
 public:
@@ -40,6 +45,23 @@ public:
   vtkGetMacro(NumberOfVertices,int);
   vtkSetMacro(NumberOfVertices,int);
 
+  /// If enabled, ReadWFile fills SparseIndices and SparseValues instead
+  /// of the output, which may then be null. Indices are sorted and unique,
+  /// the last value read for an index is kept. NumberOfVertices may be
+  /// left at 0, indices are then not checked against it. Off by default.
+  vtkSetMacro(SparseOutput, bool);
+  vtkGetMacro(SparseOutput, bool);
+  vtkBooleanMacro(SparseOutput, bool);
+
+  /// Vertex indices and values read in sparse mode.
+  vtkGetObjectMacro(SparseIndices, vtkIntArray);
+  vtkGetObjectMacro(SparseValues, vtkFloatArray);
+
+  /// Fill output with NumberOfVertices values, or up to the last index
+  /// read if it is 0, zero except at the vertices read in sparse mode.
+  /// Returns an error code.
+  int Densify(vtkFloatArray *output);
+
   enum
   {
     /// error codes
@@ -65,6 +87,10 @@ protected:
   /// are vertices
   int NumberOfVertices;
 
+  bool SparseOutput;
+  vtkIntArray * SparseIndices;
+  vtkFloatArray * SparseValues;
+
   int ReadInt3 (FILE* iFile, int& oInt);
   int ReadInt2 (FILE* iFile, int& oInt);
   int ReadFloat (FILE* iFile, float& oInt);
@@ -0,0 +1,385 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2006 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include "vtkFSWriterCore.h"
+
+// VTK includes
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+/// Number of values encoded before each write.
+const size_t FS_WRITE_CHUNK_SIZE = 64 * 1024;
+
+/// Number of label rows formatted by one thread.
+const size_t FS_LABEL_FORMAT_CHUNK_SIZE = 4096;
+
+/// Tag of the volume geometry footer of triangle files.
+const int FS_TAG_OLD_SURF_GEOM = 20;
+
+/// Largest count that fits in a three byte int.
+const size_t FS_MAX_INT3 = 0xffffff;
+
+//----------------------------------------------------------------------------
+vtkFSIO::ReadStatus MakeError(int errorCode, const std::string& message)
+{
+  vtkFSIO::ReadStatus status;
+  status.ErrorCode = errorCode;
+  status.Message = message;
+  return status;
+}
+
+//----------------------------------------------------------------------------
+// Create fileName, gzip compressed if its name ends with .gz.
+bool OpenOutput(const char* fileName, vtkFSIO::OutputStream& stream, vtkFSIO::ReadStatus& status)
+{
+  if (fileName == nullptr)
+    {
+    status = MakeError(vtkFSIO::FS_READ_ERROR_NO_FILENAME, "FileName not specified.");
+    return false;
+    }
+  const size_t length = strlen(fileName);
+  const bool compress = length > 3 && strcmp(fileName + length - 3, ".gz") == 0;
+  if (!stream.Open(fileName, compress))
+    {
+    status = MakeError(vtkFSIO::FS_READ_ERROR_OPEN, std::string("Could not create file ") + fileName);
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Flush and close the stream, and turn any failed write into an error.
+vtkFSIO::ReadStatus CloseOutput(const char* fileName, vtkFSIO::OutputStream& stream,
+                                vtkFSIO::ReadStatus status = vtkFSIO::ReadStatus())
+{
+  if (!stream.Close())
+    {
+    return MakeError(vtkFSIO::FS_WRITE_ERROR, std::string("Error writing file ") + fileName);
+    }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+// Write a length prefixed, null terminated string, as read by ReadString.
+void WriteString(vtkFSIO::OutputStream& stream, const char* text)
+{
+  const size_t length = strlen(text) + 1;
+  vtkFSIO::WriteInt(stream, static_cast<int>(length));
+  stream.Write(text, length);
+}
+
+//----------------------------------------------------------------------------
+// Append value with decimals digits after the point, like printf("%.*f")
+// in the "C" locale, whatever the current locale.
+void AppendFixed(std::string& text, double value, int decimals)
+{
+  const double scale = std::pow(10.0, decimals);
+  const double scaled = std::fabs(value) * scale;
+  if (!(scaled < 1e18))
+    {
+    // Huge values and NaN are rare enough to go through a stream.
+    std::ostringstream stream;
+    stream.imbue(std::locale::classic());
+    stream << std::fixed << std::setprecision(decimals) << value;
+    text += stream.str();
+    return;
+    }
+  unsigned long long digits = static_cast<unsigned long long>(std::llround(scaled));
+  char buffer[32];
+  char* end = buffer + sizeof(buffer);
+  char* p = end;
+  for (int i = 0; i < decimals; i++)
+    {
+    *--p = static_cast<char>('0' + digits % 10);
+    digits /= 10;
+    }
+  if (decimals > 0)
+    {
+    *--p = '.';
+    }
+  do
+    {
+    *--p = static_cast<char>('0' + digits % 10);
+    digits /= 10;
+    }
+  while (digits > 0);
+  if (value < 0.0 && std::llround(scaled) != 0)
+    {
+    *--p = '-';
+    }
+  text.append(p, end);
+}
+
+//----------------------------------------------------------------------------
+// Volume geometry lines, in the format written by FreeSurfer.
+std::string FormatVolumeGeometry(const vtkFSIO::VolumeGeometry& geometry)
+{
+  std::ostringstream text;
+  text.imbue(std::locale::classic());
+  text << "valid = " << (geometry.Valid ? 1 : 0) << "  # volume info " << (geometry.Valid ? "valid" : "invalid") << "\n";
+  text << "filename = " << geometry.FileName << "\n";
+  text << "volume = " << geometry.Dimensions[0] << " " << geometry.Dimensions[1] << " " << geometry.Dimensions[2] << "\n";
+  text << std::scientific << std::setprecision(15);
+  const char* keys[5] = { "voxelsize", "xras  ", "yras  ", "zras  ", "c_ras " };
+  const double* vectors[5] = { geometry.VoxelSize, geometry.XRAS, geometry.YRAS, geometry.ZRAS, geometry.CRAS };
+  for (int i = 0; i < 5; i++)
+    {
+    text << keys[i] << " = " << vectors[i][0] << " " << vectors[i][1] << " " << vectors[i][2] << "\n";
+    }
+  return text.str();
+}
+
+//----------------------------------------------------------------------------
+int PackRGB(const int rgb[3])
+{
+  return (rgb[0] & 0xff) | ((rgb[1] & 0xff) << 8) | ((rgb[2] & 0xff) << 16);
+}
+}
+
+//-------------------------------------------------------------------------
+vtkFSIO::ReadStatus vtkFSIO::WriteSurfaceFile(const char* fileName,
+                                              const float* points, size_t numVertices,
+                                              const int* triangles, size_t numTriangles,
+                                              const VolumeGeometry* geometry)
+{
+  ReadStatus status;
+  OutputStream surfaceFile;
+  const size_t maxCount = static_cast<size_t>(std::numeric_limits<int>::max());
+  if (numVertices > maxCount || numTriangles > maxCount / FS_NUM_VERTS_IN_TRI_FACE)
+    {
+    std::ostringstream message;
+    message << "Too many vertices (" << numVertices << ") or faces (" << numTriangles << ") for a surface file";
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+  if (!OpenOutput(fileName, surfaceFile, status))
+    {
+    return status;
+    }
+
+  // Magic number, then a header line and an empty line, which readers
+  // skip up to the counts.
+  const int magicNumber = FS_TRIANGLE_FILE_MAGIC_NUMBER;
+  WriteInt3Array(surfaceFile, &magicNumber, 1);
+  const char header[] = "created by SlicerFreeSurfer\n\n";
+  surfaceFile.Write(header, sizeof(header) - 1);
+  WriteInt(surfaceFile, static_cast<int>(numVertices));
+  WriteInt(surfaceFile, static_cast<int>(numTriangles));
+
+  WriteFloatArray(surfaceFile, points, 3 * numVertices);
+  WriteIntArray(surfaceFile, triangles, FS_NUM_VERTS_IN_TRI_FACE * numTriangles);
+
+  if (geometry != nullptr)
+    {
+    WriteInt(surfaceFile, FS_TAG_OLD_SURF_GEOM);
+    const std::string footer = FormatVolumeGeometry(*geometry);
+    surfaceFile.Write(footer.data(), footer.size());
+    }
+  return CloseOutput(fileName, surfaceFile);
+}
+
+//-------------------------------------------------------------------------
+vtkFSIO::ReadStatus vtkFSIO::WriteScalarFile(const char* fileName,
+                                             const float* values, size_t numValues,
+                                             int numFaces)
+{
+  ReadStatus status;
+  OutputStream scalarFile;
+  if (numValues == 0 || numValues > static_cast<size_t>(std::numeric_limits<int>::max()))
+    {
+    std::ostringstream message;
+    message << "Can't write " << numValues << " values to a scalar file";
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+  if (!OpenOutput(fileName, scalarFile, status))
+    {
+    return status;
+    }
+
+  // New style header: magic number, number of values and faces, and one
+  // value per vertex.
+  const int magicNumber = FS_NEW_SCALAR_MAGIC_NUMBER;
+  const int header[3] = { static_cast<int>(numValues), numFaces, 1 };
+  WriteInt3Array(scalarFile, &magicNumber, 1);
+  WriteIntArray(scalarFile, header, 3);
+  WriteFloatArray(scalarFile, values, numValues);
+  return CloseOutput(fileName, scalarFile);
+}
+
+//-------------------------------------------------------------------------
+vtkFSIO::ReadStatus vtkFSIO::WriteWFile(const char* fileName,
+                                        const int* indices, const float* values, size_t count)
+{
+  ReadStatus status;
+  OutputStream wFile;
+  if (count > FS_MAX_INT3)
+    {
+    std::ostringstream message;
+    message << "Too many values (" << count << ") for a w-file";
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+  if (!OpenOutput(fileName, wFile, status))
+    {
+    return status;
+    }
+
+  // The latency, which readers ignore, then the pairs.
+  const short latency = 0;
+  const int numValues = static_cast<int>(count);
+  WriteShortArray(wFile, &latency, 1);
+  WriteInt3Array(wFile, &numValues, 1);
+  WriteInt3FloatPairs(wFile, indices, values, count);
+  return CloseOutput(fileName, wFile);
+}
+
+//-------------------------------------------------------------------------
+vtkFSIO::ReadStatus vtkFSIO::WriteLabelFile(const char* fileName,
+                                            const int* indices, const float* coordinates,
+                                            const float* weights, size_t count,
+                                            const char* subjectName)
+{
+  ReadStatus status;
+  OutputStream labelFile;
+  if (count > static_cast<size_t>(std::numeric_limits<int>::max()))
+    {
+    std::ostringstream message;
+    message << "Too many rows (" << count << ") for a label file";
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+  if (!OpenOutput(fileName, labelFile, status))
+    {
+    return status;
+    }
+
+  std::string header = "#!ascii label  , from subject ";
+  header += subjectName != nullptr ? subjectName : "";
+  header += " vox2ras=TkReg\n";
+  header += std::to_string(count);
+  header += "\n";
+  labelFile.Write(header.data(), header.size());
+
+  // Rows are formatted concurrently, a chunk at a time, in the same
+  // "%d  %.3f  %.3f  %.3f %.10f" layout as FreeSurfer.
+  const size_t numChunks = (count + FS_LABEL_FORMAT_CHUNK_SIZE - 1) / FS_LABEL_FORMAT_CHUNK_SIZE;
+  std::vector<std::string> chunks(numChunks);
+  std::string* chunkText = chunks.data();
+  vtkSMPTools::For(0, static_cast<vtkIdType>(numChunks), 1,
+    [=](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType chunk = begin; chunk < end; chunk++)
+      {
+      const size_t first = static_cast<size_t>(chunk) * FS_LABEL_FORMAT_CHUNK_SIZE;
+      const size_t last = std::min(first + FS_LABEL_FORMAT_CHUNK_SIZE, count);
+      std::string& text = chunkText[chunk];
+      text.reserve((last - first) * 48);
+      for (size_t row = first; row < last; row++)
+        {
+        text += std::to_string(indices[row]);
+        for (int i = 0; i < 3; i++)
+          {
+          text += "  ";
+          AppendFixed(text, coordinates != nullptr ? coordinates[3 * row + i] : 0.0, 3);
+          }
+        text += " ";
+        AppendFixed(text, weights != nullptr ? weights[row] : 0.0, 10);
+        text += "\n";
+        }
+      }
+    });
+  for (const std::string& text : chunks)
+    {
+    labelFile.Write(text.data(), text.size());
+    }
+  return CloseOutput(fileName, labelFile);
+}
+
+//-------------------------------------------------------------------------
+vtkFSIO::ReadStatus vtkFSIO::WriteAnnotationFile(const char* fileName,
+                                                 const int* labels, size_t numVertices,
+                                                 const ColorTable& colorTable)
+{
+  ReadStatus status;
+  OutputStream annotFile;
+  if (numVertices > static_cast<size_t>(std::numeric_limits<int>::max()))
+    {
+    std::ostringstream message;
+    message << "Too many vertices (" << numVertices << ") for an annotation file";
+    return MakeError(FS_READ_ERROR_NUM_VALUES, message.str());
+    }
+  if (!OpenOutput(fileName, annotFile, status))
+    {
+    return status;
+    }
+
+  // Number of vertices, then a vertex index and rgb pair per vertex,
+  // encoded in place a chunk at a time.
+  WriteInt(annotFile, static_cast<int>(numVertices));
+  std::vector<int> pairs(2 * std::min(numVertices, FS_WRITE_CHUNK_SIZE));
+  size_t numUnassigned = 0;
+  for (size_t first = 0; first < numVertices; first += FS_WRITE_CHUNK_SIZE)
+    {
+    const size_t last = std::min(first + FS_WRITE_CHUNK_SIZE, numVertices);
+    for (size_t vertex = first; vertex < last; vertex++)
+      {
+      const int* rgb = colorTable.GetRGB(labels[vertex]);
+      if (rgb == nullptr)
+        {
+        numUnassigned++;
+        }
+      pairs[2 * (vertex - first)] = static_cast<int>(vertex);
+      pairs[2 * (vertex - first) + 1] = rgb != nullptr ? PackRGB(rgb) : 0;
+      }
+    EncodeIntArray(pairs.data(), pairs.data(), 2 * (last - first));
+    annotFile.Write(pairs.data(), 2 * (last - first) * sizeof(int));
+    }
+
+  // Embedded color table, version 2: the size of the table, its name and
+  // the structure number, name and rgb and a flag of each used entry.
+  int numUsedEntries = 0;
+  for (int entry = 0; entry < colorTable.GetNumberOfEntries(); entry++)
+    {
+    numUsedEntries += colorTable.IsEntryUsed(entry) ? 1 : 0;
+    }
+  const int tableHeader[3] = { FS_ANNOTATION_COLOR_TABLE_TAG, -2, colorTable.GetNumberOfEntries() };
+  WriteIntArray(annotFile, tableHeader, 3);
+  WriteString(annotFile, "NOFILE");
+  WriteInt(annotFile, numUsedEntries);
+  for (int entry = 0; entry < colorTable.GetNumberOfEntries(); entry++)
+    {
+    const int* rgb = colorTable.GetRGB(entry);
+    if (rgb == nullptr)
+      {
+      continue;
+      }
+    WriteInt(annotFile, entry);
+    WriteString(annotFile, colorTable.GetName(entry));
+    const int rgbt[4] = { rgb[0], rgb[1], rgb[2], 0 };
+    WriteIntArray(annotFile, rgbt, 4);
+    }
+
+  if (numUnassigned > 0)
+    {
+    std::ostringstream message;
+    message << numUnassigned << " vertices have a label that is not in the color table, they are written with color 0";
+    status.Warnings.push_back(message.str());
+    }
+  return CloseOutput(fileName, annotFile, status);
+}
@@ -0,0 +1,66 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2006 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+=========================================================================auto=*/
+
+#ifndef __vtkFSWriterCore_h
+#define __vtkFSWriterCore_h
+
+#include "vtkFreeSurferExport.h"
+
+// FreeSurfer includes
+#include "vtkFSReaderCore.h"
+
+// STD includes
+#include <cstddef>
+
+/// \brief Encoding of the FreeSurfer surface file formats.
+///
+/// The counterparts of the Read*File functions of vtkFSReaderCore.h: each
+/// Write*File function writes one whole file from plain arrays and returns
+/// a ReadStatus. Values are byte swapped a block at a time and written
+/// through a large buffer, never one value per call. Files whose name ends
+/// with ".gz" are gzip compressed. Like the readers, they keep no state and
+/// can be called concurrently for different files.
+namespace vtkFSIO {
+
+  /// Write a triangle surface file with \a numVertices x y z \a points and
+  /// \a numTriangles vertex index triples. The volume geometry footer is
+  /// written if \a geometry is set.
+  ReadStatus VTK_FreeSurfer_EXPORT WriteSurfaceFile (const char* fileName,
+                                                     const float* points, size_t numVertices,
+                                                     const int* triangles, size_t numTriangles,
+                                                     const VolumeGeometry* geometry = nullptr);
+
+  /// Write a new style (curv format) per-vertex scalar file. \a numFaces is
+  /// only stored in the header.
+  ReadStatus VTK_FreeSurfer_EXPORT WriteScalarFile (const char* fileName,
+                                                    const float* values, size_t numValues,
+                                                    int numFaces = 0);
+
+  /// Write \a count index/value pairs as a w-file. Indices and the count
+  /// are stored as three byte ints.
+  ReadStatus VTK_FreeSurfer_EXPORT WriteWFile (const char* fileName,
+                                               const int* indices, const float* values, size_t count);
+
+  /// Write an ASCII label file with \a count rows. \a coordinates (x y z
+  /// per row) and \a weights may be null, they are then written as zeros.
+  ReadStatus VTK_FreeSurfer_EXPORT WriteLabelFile (const char* fileName,
+                                                   const int* indices, const float* coordinates,
+                                                   const float* weights, size_t count,
+                                                   const char* subjectName = nullptr);
+
+  /// Write an annotation file where vertex i has the color of entry
+  /// \a labels[i] of \a colorTable, followed by the table itself in the
+  /// version 2 embedded format. Labels that are not a used entry get color
+  /// 0, which is reported as a warning.
+  ReadStatus VTK_FreeSurfer_EXPORT WriteAnnotationFile (const char* fileName,
+                                                        const int* labels, size_t numVertices,
+                                                        const ColorTable& colorTable);
+}
+
+#endif
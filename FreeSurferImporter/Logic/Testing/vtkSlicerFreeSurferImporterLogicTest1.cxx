@@ -0,0 +1,170 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// FreeSurferImporter Logic includes
+#include "vtkSlicerFreeSurferImporterLogic.h"
+
+// FreeSurfer includes
+#include <vtkFSIO.h>
+#include <vtkFSSurfaceMGHReader.h>
+#include <vtkFSSurfaceReader.h>
+
+// MRML includes
+#include <vtkMRMLCoreTestingMacros.h>
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkCollection.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const int NUMBER_OF_FRAMES = 3;
+
+//----------------------------------------------------------------------------
+float GetFrameValue(int frame, int vertex)
+{
+  return 10.0f * frame + 0.5f * vertex;
+}
+
+//----------------------------------------------------------------------------
+// Write a float MGH volume of one voxel per vertex, gzip compressed if
+// \a compress is set. \a height and \a depth only change the header.
+bool WriteFrames(const std::string& fileName, int numberOfVertices, bool compress,
+                 int height = 1, int depth = 1)
+{
+  vtkFSIO::OutputStream stream;
+  if (!stream.Open(fileName.c_str(), compress))
+    {
+    return false;
+    }
+  // version, width, height, depth, frames, type, dof
+  const int header[7] = { vtkFSSurfaceMGHReader::FS_MGH_VERSION, numberOfVertices, height, depth,
+                          NUMBER_OF_FRAMES, vtkFSSurfaceMGHReader::FS_MGH_TYPE_FLOAT, 0 };
+  vtkFSIO::WriteIntArray(stream, header, 7);
+  std::vector<char> padding(vtkFSSurfaceMGHReader::FS_MGH_HEADER_SIZE - sizeof(header), 0);
+  stream.Write(padding.data(), padding.size());
+  std::vector<float> values(numberOfVertices);
+  for (int frame = 0; frame < NUMBER_OF_FRAMES; ++frame)
+    {
+    for (int vertex = 0; vertex < numberOfVertices; ++vertex)
+      {
+      values[vertex] = GetFrameValue(frame, vertex);
+      }
+    vtkFSIO::WriteFloatArray(stream, values.data(), values.size());
+    }
+  return stream.Close();
+}
+
+//----------------------------------------------------------------------------
+int CheckFrame(vtkFloatArray* scalars, int frame)
+{
+  CHECK_NOT_NULL(scalars);
+  for (vtkIdType vertex = 0; vertex < scalars->GetNumberOfTuples(); ++vertex)
+    {
+    CHECK_DOUBLE(scalars->GetValue(vertex), GetFrameValue(frame, vertex));
+    }
+  return EXIT_SUCCESS;
+}
+
+}
+
+// Switch the frames of multi-frame overlays, uncompressed and compressed
+int vtkSlicerFreeSurferImporterLogicTest1(int argc, char * argv[] )
+{
+  if (argc < 3)
+    {
+    std::cerr << "Usage: " << argv[0] << " <test data directory> <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string dataDirectory = argv[1];
+  const std::string tempDirectory = argv[2];
+
+  vtkNew<vtkFSSurfaceReader> surfaceReader;
+  surfaceReader->SetFileName((dataDirectory + "/lh.dart.orig").c_str());
+  surfaceReader->Update();
+  const int numberOfVertices = surfaceReader->GetOutput()->GetNumberOfPoints();
+  CHECK_BOOL(numberOfVertices > 0, true);
+
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkSlicerFreeSurferImporterLogic> logic;
+  logic->SetMRMLScene(scene);
+
+  const char* fileNames[2] = { "lh.frames.mgh", "lh.frames.mgz" };
+  for (int compress = 0; compress < 2; ++compress)
+    {
+    const std::string scalarName = fileNames[compress];
+    const std::string fileName = tempDirectory + "/" + scalarName;
+    CHECK_BOOL(WriteFrames(fileName, numberOfVertices, compress != 0), true);
+
+    vtkNew<vtkPolyData> surface;
+    surface->DeepCopy(surfaceReader->GetOutput());
+    vtkNew<vtkMRMLModelNode> modelNode;
+    modelNode->SetAndObservePolyData(surface);
+    scene->AddNode(modelNode);
+    vtkNew<vtkCollection> modelNodes;
+    modelNodes->AddItem(modelNode);
+    CHECK_BOOL(logic->LoadFreeSurferScalarOverlays(std::vector<std::string>(1, fileName), modelNodes), true);
+
+    vtkFloatArray* scalars = vtkFloatArray::SafeDownCast(surface->GetPointData()->GetArray(scalarName.c_str()));
+    CHECK_NOT_NULL(scalars);
+    CHECK_INT(scalars->GetNumberOfTuples(), numberOfVertices);
+    CHECK_INT(logic->GetScalarOverlayNumberOfFrames(modelNode, scalarName.c_str()), NUMBER_OF_FRAMES);
+    CHECK_INT(logic->GetScalarOverlayFrame(modelNode, scalarName.c_str()), 0);
+    CHECK_EXIT_SUCCESS(CheckFrame(scalars, 0));
+
+    // backwards too, a compressed file is inflated again
+    const int frames[3] = { 2, 0, 1 };
+    for (int frame : frames)
+      {
+      CHECK_BOOL(logic->SetScalarOverlayFrame(modelNode, scalarName.c_str(), frame), true);
+      CHECK_INT(logic->GetScalarOverlayFrame(modelNode, scalarName.c_str()), frame);
+      // decoded in place
+      CHECK_POINTER(surface->GetPointData()->GetArray(scalarName.c_str()), scalars);
+      CHECK_EXIT_SUCCESS(CheckFrame(scalars, frame));
+      }
+
+    TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+    CHECK_BOOL(logic->SetScalarOverlayFrame(modelNode, scalarName.c_str(), NUMBER_OF_FRAMES), false);
+    TESTING_OUTPUT_ASSERT_ERRORS_END();
+    CHECK_INT(logic->GetScalarOverlayFrame(modelNode, scalarName.c_str()), 1);
+    CHECK_EXIT_SUCCESS(CheckFrame(scalars, 1));
+    }
+
+  // dimensions that aren't positive, or whose product doesn't fit in an int
+  const int hostileDimensions[3][2] = { { 0, 1 }, { -1, 1 }, { 0x40000000, 0x40000000 } };
+  for (const int* dimensions : hostileDimensions)
+    {
+    const std::string hostileFileName = tempDirectory + "/lh.hostile.mgh";
+    CHECK_BOOL(WriteFrames(hostileFileName, numberOfVertices, false, dimensions[0], dimensions[1]), true);
+    vtkNew<vtkFSSurfaceMGHReader> reader;
+    reader->SetFileName(hostileFileName.c_str());
+    TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+    CHECK_INT(reader->ReadHeader(), vtkFSSurfaceMGHReader::FS_ERROR_MGH_HEADER);
+    TESTING_OUTPUT_ASSERT_ERRORS_END();
+    }
+
+  return EXIT_SUCCESS;
+}
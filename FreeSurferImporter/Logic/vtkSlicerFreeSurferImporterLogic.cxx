@@ -20,7 +20,7 @@
 #include "vtkSlicerFreeSurferExtrudeTool.h"
 
 // MRML includes
-#include <vtkMRMLColorTableStorageNode.h>
+#include <vtkMRMLColorTableNode.h>
 #include <vtkMRMLLinearTransformNode.h>
 #include <vtkMRMLModelNode.h>
 #include <vtkMRMLModelStorageNode.h>
@@ -40,8 +40,10 @@
 #include <vtkMRMLColorLogic.h>
 
 // FreeSurfer MRML
+#include <vtkMRMLFreeSurferLabelsColorNode.h>
 #include <vtkMRMLFreeSurferModelOverlayStorageNode.h>
 #include <vtkMRMLFreeSurferModelStorageNode.h>
+#include <vtkMRMLFreeSurferOverlayCache.h>
 #include <vtkMRMLFreeSurferProceduralColorNode.h>
 
 // VTK includes
@@ -50,6 +52,8 @@
 #include <vtkDoubleArray.h>
 #include <vtkFloatArray.h>
 #include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkCollection.h>
 #include <vtkIntArray.h>
 #include <vtkMatrix4x4.h>
 #include <vtkNew.h>
@@ -67,11 +71,13 @@
 #include <vtkSlicerDynamicModelerToolFactory.h>
 
 // FreeSurfer includes
+#include <vtkFSReaderCore.h>
 #include <vtkFSSurfaceLabelReader.h>
+#include <vtkFSSurfaceMGHReader.h>
 
 // STD includes
 #include <cassert>
-#include <regex>
+#include <memory>
 
 //----------------------------------------------------------------------------
 const static std::string DEFAULT_FREESURFER_LABEL_FILENAME = "FreeSurferColorLUT20150729.txt";
@@ -83,6 +89,7 @@ vtkStandardNewMacro(vtkSlicerFreeSurferImporterLogic);
 //----------------------------------------------------------------------------
 vtkSlicerFreeSurferImporterLogic::vtkSlicerFreeSurferImporterLogic()
 {
+  this->OverlayCache = vtkSmartPointer<vtkMRMLFreeSurferOverlayCache>::New();
 }
 
 //----------------------------------------------------------------------------
@@ -132,6 +139,7 @@ void vtkSlicerFreeSurferImporterLogic::RegisterNodes()
 {
   assert(this->GetMRMLScene() != 0);
 
+  this->GetMRMLScene()->RegisterNodeClass(vtkSmartPointer<vtkMRMLFreeSurferLabelsColorNode>::New());
   this->GetMRMLScene()->RegisterNodeClass(vtkSmartPointer<vtkMRMLFreeSurferModelOverlayStorageNode>::New());
   this->GetMRMLScene()->RegisterNodeClass(vtkSmartPointer<vtkMRMLFreeSurferModelStorageNode>::New());
   this->GetMRMLScene()->RegisterNodeClass(vtkSmartPointer<vtkMRMLFreeSurferProceduralColorNode>::New());
@@ -234,94 +242,186 @@ bool vtkSlicerFreeSurferImporterLogic::LoadFreeSurferScalarOverlay(std::string f
 //-----------------------------------------------------------------------------
 bool vtkSlicerFreeSurferImporterLogic::LoadFreeSurferScalarOverlay(std::string filePath, vtkCollection* modelNodes)
 {
-  int numberOfOverlayLoaded = 0;
-  for (int i = 0; i < modelNodes->GetNumberOfItems(); ++i)
+  // the file is decoded once for all the models with the same number of vertices
+  std::vector<std::string> filePaths(1, filePath);
+  return this->LoadFreeSurferScalarOverlays(filePaths, modelNodes);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::LoadFreeSurferScalarOverlays(const std::vector<std::string>& filePaths,
+  vtkCollection* modelNodes, std::vector<bool>* loadedOverlays)
+{
+  if (loadedOverlays)
   {
-    vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(modelNodes->GetItemAsObject(i));
-    if (!this->LoadFreeSurferScalarOverlay(filePath, modelNode))
-    {
-      continue;
-    }
-    numberOfOverlayLoaded += 1;
+    loadedOverlays->assign(filePaths.size(), false);
+  }
+  if (!modelNodes)
+  {
+    return false;
   }
 
-  if (numberOfOverlayLoaded == 0)
+  vtkMRMLFreeSurferModelOverlayStorageNode* overlayStorageNode = vtkMRMLFreeSurferModelOverlayStorageNode::SafeDownCast(
+    this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLFreeSurferModelOverlayStorageNode"));
+  if (!overlayStorageNode)
   {
+    vtkErrorMacro("LoadFreeSurferScalarOverlays: Could not add FreeSurfer overlay storage node");
     return false;
   }
-  return true;
+
+  overlayStorageNode->SetOverlayCache(this->OverlayCache);
+  int numberOfOverlaysLoaded = overlayStorageNode->ReadScalarOverlays(filePaths, modelNodes, loadedOverlays);
+
+  this->GetMRMLScene()->RemoveNode(overlayStorageNode);
+  return numberOfOverlaysLoaded > 0;
 }
 
 //-----------------------------------------------------------------------------
-struct SegmentInfo
+bool vtkSlicerFreeSurferImporterLogic::LoadFreeSurferLabels(const std::vector<std::string>& filePaths,
+  vtkMRMLModelNode* modelNode, const std::string& name, std::vector<bool>* loadedLabels)
 {
-  std::string name = "Unknown";
-  double color[3] = { 0.5 };
-};
+  if (loadedLabels)
+  {
+    loadedLabels->assign(filePaths.size(), false);
+  }
+  if (!modelNode)
+  {
+    return false;
+  }
+
+  vtkMRMLFreeSurferModelOverlayStorageNode* overlayStorageNode = vtkMRMLFreeSurferModelOverlayStorageNode::SafeDownCast(
+    this->GetMRMLScene()->AddNewNodeByClass("vtkMRMLFreeSurferModelOverlayStorageNode"));
+  if (!overlayStorageNode)
+  {
+    vtkErrorMacro("LoadFreeSurferLabels: Could not add FreeSurfer overlay storage node");
+    return false;
+  }
+
+  int numberOfLabelsLoaded = overlayStorageNode->ReadScalarOverlayLabels(filePaths, modelNode, name, loadedLabels);
+
+  this->GetMRMLScene()->RemoveNode(overlayStorageNode);
+  return numberOfLabelsLoaded > 0;
+}
 
 //-----------------------------------------------------------------------------
-void vtkSlicerFreeSurferImporterLogic::ApplyFreeSurferSegmentationLUT(vtkMRMLSegmentationNode* segmentationNode)
+vtkMRMLFreeSurferOverlayCache* vtkSlicerFreeSurferImporterLogic::GetOverlayCache()
 {
-  if (!segmentationNode)
+  return this->OverlayCache;
+}
+
+//-----------------------------------------------------------------------------
+vtkFSSurfaceMGHReader* vtkSlicerFreeSurferImporterLogic::GetScalarOverlayFrameReader(vtkMRMLModelNode* modelNode,
+  const char* scalarName, vtkFloatArray** scalars)
+{
+  if (!modelNode || !modelNode->GetPolyData() || !scalarName)
   {
-    return;
+    return nullptr;
   }
-  MRMLNodeModifyBlocker blocker(segmentationNode);
+  vtkFloatArray* floatArray = vtkFloatArray::SafeDownCast(
+    modelNode->GetPolyData()->GetPointData()->GetArray(scalarName));
+  if (!floatArray || !floatArray->HasInformation())
+  {
+    return nullptr;
+  }
+  if (scalars)
+  {
+    *scalars = floatArray;
+  }
+  return vtkFSSurfaceMGHReader::SafeDownCast(
+    floatArray->GetInformation()->Get(vtkFSSurfaceMGHReader::FRAME_READER()));
+}
 
-  std::string sharedDirectory = this->GetModuleShareDirectory();
-  std::string lutDirectory = sharedDirectory + "/" + DEFAULT_FREESURFER_LABEL_FILENAME;
+//-----------------------------------------------------------------------------
+int vtkSlicerFreeSurferImporterLogic::GetScalarOverlayNumberOfFrames(vtkMRMLModelNode* modelNode, const char* scalarName)
+{
+  vtkFSSurfaceMGHReader* reader = this->GetScalarOverlayFrameReader(modelNode, scalarName);
+  return reader ? reader->GetNumberOfFrames() : 1;
+}
 
-  std::ifstream lutFile;
-  lutFile.open(lutDirectory);
-  if (!lutFile.is_open())
+//-----------------------------------------------------------------------------
+int vtkSlicerFreeSurferImporterLogic::GetScalarOverlayFrame(vtkMRMLModelNode* modelNode, const char* scalarName)
+{
+  // copies of the array share the reader, the frame is kept by each array
+  vtkFloatArray* scalars = nullptr;
+  if (!this->GetScalarOverlayFrameReader(modelNode, scalarName, &scalars))
   {
-    return;
+    return 0;
   }
+  return scalars->GetInformation()->Get(vtkFSSurfaceMGHReader::FRAME());
+}
 
-  std::map<int, SegmentInfo> segmentInfoMap;
-
-  std::string line;
-  while (std::getline(lutFile, line))
+//-----------------------------------------------------------------------------
+bool vtkSlicerFreeSurferImporterLogic::SetScalarOverlayFrame(vtkMRMLModelNode* modelNode, const char* scalarName, int frame)
+{
+  vtkFloatArray* scalars = nullptr;
+  vtkFSSurfaceMGHReader* reader = this->GetScalarOverlayFrameReader(modelNode, scalarName, &scalars);
+  if (!reader)
   {
-    line = std::regex_replace(line, std::regex("^ +| +$|( ) +"), "$1");
-    if (line.empty())
-    {
-      continue;
-    }
-    if (line[0] == '#')
-    {
-      continue;
-    }
+    vtkErrorMacro("SetScalarOverlayFrame: " << (scalarName ? scalarName : "(null)") << " is not a multi-frame overlay");
+    return false;
+  }
+  if (scalars->GetInformation()->Get(vtkFSSurfaceMGHReader::FRAME()) == frame)
+  {
+    return true;
+  }
+  reader->SetOutput(scalars);
+  const int errorCode = reader->ReadFrame(frame);
+  reader->SetOutput(nullptr);
+  if (errorCode != vtkFSSurfaceMGHReader::FS_ERROR_MGH_NONE)
+  {
+    vtkErrorMacro("SetScalarOverlayFrame: Could not read frame " << frame << " of " << scalarName);
+    return false;
+  }
+  scalars->GetInformation()->Set(vtkFSSurfaceMGHReader::FRAME(), frame);
+  // the values changed in place, let the displays update
+  modelNode->GetPolyData()->Modified();
+  return true;
+}
 
-    std::vector<std::string> tokens;
-    std::stringstream ss(line);;
-    std::string token;
-    while (std::getline(ss, token, ' '))
-    {
-      tokens.push_back(token);
-    }
-    if (tokens.size() != 6)
-    {
-      continue;
-    }
+//-----------------------------------------------------------------------------
+std::string vtkSlicerFreeSurferImporterLogic::GetFreeSurferLabelFileName()
+{
+  std::vector<std::string> filePath;
+  filePath.emplace_back(""); // for relative path
+  filePath.push_back(this->GetModuleShareDirectory());
+  filePath.emplace_back(DEFAULT_FREESURFER_LABEL_FILENAME);
+  return vtksys::SystemTools::JoinPath(filePath);
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerFreeSurferImporterLogic::ApplyFreeSurferSegmentationLUT(vtkMRMLSegmentationNode* segmentationNode)
+{
+  if (!segmentationNode)
+  {
+    return;
+  }
 
-    int value = vtkVariant(tokens[0]).ToInt();
-    SegmentInfo info;
-    info.name = tokens[1];
-    info.color[0] = vtkVariant(tokens[2]).ToInt() / 255.0;
-    info.color[1] = vtkVariant(tokens[3]).ToInt() / 255.0;
-    info.color[2] = vtkVariant(tokens[4]).ToInt() / 255.0;
-    segmentInfoMap[value] = info;
+  // The LUT is parsed once and shared with the FreeSurferLabels color node
+  std::string lutFileName = this->GetFreeSurferLabelFileName();
+  vtkFSIO::ReadStatus status;
+  std::shared_ptr<const vtkFSIO::ColorTable> colorTable = vtkFSIO::GetSharedColorTable(lutFileName.c_str(), status);
+  if (!colorTable)
+  {
+    vtkErrorMacro("ApplyFreeSurferSegmentationLUT: " << status.Message);
+    return;
   }
-  lutFile.close();
 
+  MRMLNodeModifyBlocker blocker(segmentationNode);
   vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
   for (int i = 0; i < segmentation->GetNumberOfSegments(); ++i)
   {
     vtkSegment* segment = segmentation->GetNthSegment(i);
-    SegmentInfo info = segmentInfoMap[segment->GetLabelValue()];
-    segment->SetName(info.name.c_str());
-    segment->SetColor(info.color);
+    int labelValue = segment->GetLabelValue();
+    const char* name = colorTable->GetName(labelValue);
+    const int* rgb = colorTable->GetRGB(labelValue);
+    double color[3] = { 0.5, 0.0, 0.0 };
+    if (rgb != nullptr)
+    {
+      color[0] = rgb[0] / 255.0;
+      color[1] = rgb[1] / 255.0;
+      color[2] = rgb[2] / 255.0;
+    }
+    segment->SetName(name != nullptr ? name : "Unknown");
+    segment->SetColor(color);
   }
 }
 
@@ -374,83 +474,19 @@ vtkMRMLColorTableNode* vtkSlicerFreeSurferImporterLogic::CreateFreeSurferFileNod
     return nullptr;
   }
 
-  vtkMRMLColorTableNode* node = this->CreateFileNode(fileName);
-
-  if (!node)
-  {
-    return nullptr;
-  }
+  // The colors are read from the file when the node's table is first used
+  vtkMRMLFreeSurferLabelsColorNode* node = vtkMRMLFreeSurferLabelsColorNode::New();
+  node->SetTypeToFile();
+  node->SaveWithSceneOff();
+  node->HideFromEditorsOn();
   node->SetAttribute("Category", "FreeSurfer");
+  node->SetLabelsFileName(fileName);
   node->SetName("FreeSurferLabels");
   node->SetSingletonTag(node->GetTypeAsString());
 
   return node;
 }
 
-//--------------------------------------------------------------------------------
-vtkMRMLColorTableNode* vtkSlicerFreeSurferImporterLogic::CreateFileNode(const char* fileName)
-{
-  vtkMRMLColorTableNode* ctNode = vtkMRMLColorTableNode::New();
-  ctNode->SetTypeToFile();
-  ctNode->SaveWithSceneOff();
-  ctNode->HideFromEditorsOn();
-  ctNode->SetScene(this->GetMRMLScene());
-
-  // make a storage node
-  vtkNew<vtkMRMLColorTableStorageNode> colorStorageNode;
-  colorStorageNode->SaveWithSceneOff();
-  if (this->GetMRMLScene())
-  {
-    this->GetMRMLScene()->AddNode(colorStorageNode.GetPointer());
-    ctNode->SetAndObserveStorageNodeID(colorStorageNode->GetID());
-  }
-
-  ctNode->GetStorageNode()->SetFileName(fileName);
-  std::string basename = vtksys::SystemTools::GetFilenameWithoutExtension(fileName);
-  if (this->GetMRMLScene())
-  {
-    std::string uname(this->GetMRMLScene()->GetUniqueNameByString(basename.c_str()));
-    ctNode->SetName(uname.c_str());
-  }
-  else
-  {
-    ctNode->SetName(basename.c_str());
-  }
-  vtkDebugMacro("CreateFileNode: About to read user file " << fileName);
-
-  if (ctNode->GetStorageNode()->ReadData(ctNode) == 0)
-  {
-    vtkErrorMacro("Unable to read file as color table " << (ctNode->GetStorageNode()->GetFileName() ? ctNode->GetStorageNode()->GetFileName() : ""));
-
-    if (this->GetMRMLScene())
-    {
-      ctNode->SetAndObserveStorageNodeID(nullptr);
-      ctNode->SetScene(nullptr);
-      this->GetMRMLScene()->RemoveNode(colorStorageNode.GetPointer());
-    }
-
-    ctNode->Delete();
-    return nullptr;
-  }
-
-  // Latest version of FreeSurferLut have alpha of 0.0 for all colors.
-  // Manually assign alpha of 1.0.
-  MRMLNodeModifyBlocker blocker(ctNode);
-  for (int i = 0; i < ctNode->GetNumberOfColors(); ++i)
-  {
-    double color[4] = { 0.0, 0.0, 0.0, 0.0 };
-    ctNode->GetColor(i, color);
-    color[3] = 1.0;
-    ctNode->SetColor(i, color[0], color[1], color[2], color[3]);
-  }
-
-  vtkDebugMacro("CreateFileNode: finished reading user file " << fileName);
-  ctNode->SetSingletonTag(
-    vtkMRMLColorLogic::GetFileColorNodeSingletonTag(fileName).c_str());
-
-  return ctNode;
-}
-
 //----------------------------------------------------------------------------------------
 void vtkSlicerFreeSurferImporterLogic::AddFreeSurferNode(int type)
 {
@@ -493,6 +529,8 @@ void vtkSlicerFreeSurferImporterLogic::AddFreeSurferLabelNodeFromFile(const char
 //----------------------------------------------------------------------------------------
 void vtkSlicerFreeSurferImporterLogic::AddFreeSurferNodes()
 {
+  // This runs for every new scene: the nodes only get their colours when
+  // they are first used.
   vtkDebugMacro("AddDefaultColorNodes: Adding Freesurfer nodes");
   vtkNew<vtkMRMLFreeSurferProceduralColorNode> basicFSNode;
   vtkDebugMacro("AddDefaultColorNodes: first type = " << basicFSNode->GetFirstType() << ", last type = " << basicFSNode->GetLastType());
@@ -502,14 +540,9 @@ void vtkSlicerFreeSurferImporterLogic::AddFreeSurferNodes()
   }
 
   // add a regular colour tables holding the freesurfer volume file colours and
-  // surface colours
+  // surface colours, read when they are first used
   // get the colour file in the freesurfer share dir
-  std::vector<std::string> filePath;
-  filePath.emplace_back(""); // for relative path
-  filePath.push_back(this->GetModuleShareDirectory());
-  filePath.emplace_back(DEFAULT_FREESURFER_LABEL_FILENAME);
-  std::string lutFileName = vtksys::SystemTools::JoinPath(filePath);
-  this->AddFreeSurferLabelNodeFromFile(lutFileName.c_str());
+  this->AddFreeSurferLabelNodeFromFile(this->GetFreeSurferLabelFileName().c_str());
 }
 
 //----------------------------------------------------------------------------
@@ -28,11 +28,15 @@
 #include "vtkSlicerModuleLogic.h"
 
 // VTK includes
+#include <vtkSmartPointer.h>
 class vtkCollection;
 
 // MRML includes
 class vtkMRMLColorTableNode;
 class vtkDoubleArray;
+class vtkFloatArray;
+class vtkFSSurfaceMGHReader;
+class vtkMRMLFreeSurferOverlayCache;
 class vtkMRMLFreeSurferProceduralColorNode;
 class vtkMRMLMarkupsCurveNode;
 class vtkMRMLMarkupsPlaneNode;
@@ -44,6 +48,7 @@ class vtkMRMLVolumeNode;
 // STD includes
 #include <cstdlib>
 #include <string>
+#include <vector>
 
 #include "vtkSlicerFreeSurferImporterModuleLogicExport.h"
 
@@ -62,9 +67,35 @@ public:
   vtkMRMLSegmentationNode* LoadFreeSurferSegmentation(std::string filePath);
   bool LoadFreeSurferScalarOverlay(std::string filePath, vtkCollection* modelNodes);
   bool LoadFreeSurferScalarOverlay(std::string filePath, vtkMRMLModelNode* modelNode);
+  /// Load several overlays into each model of \a modelNodes, decoding the
+  /// files concurrently and updating each model and its display once.
+  /// If \a loadedOverlays is set, it tells for each file whether it was
+  /// loaded into at least one model. Returns true if any overlay was loaded.
+  bool LoadFreeSurferScalarOverlays(const std::vector<std::string>& filePaths, vtkCollection* modelNodes,
+                                    std::vector<bool>* loadedOverlays = nullptr);
+  /// Load several label files, such as the lh.*.label files of a subject's
+  /// label directory, into a single bitmask overlay of \a modelNode named
+  /// "<name> mask" and display them, see
+  /// vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayLabels.
+  /// Membership can be queried with the static functions of
+  /// vtkFSSurfaceMultiLabelReader. Returns true if any label was loaded.
+  bool LoadFreeSurferLabels(const std::vector<std::string>& filePaths, vtkMRMLModelNode* modelNode,
+                            const std::string& name = "labels", std::vector<bool>* loadedLabels = nullptr);
+  /// Overlays decoded by LoadFreeSurferScalarOverlays, reused while their
+  /// file doesn't change. Its memory limit can be changed.
+  vtkMRMLFreeSurferOverlayCache* GetOverlayCache();
+  /// Multi-frame volume overlays (*.mgh, *.mgz), such as time series, are
+  /// loaded with their first frame. These switch the frame shown by the
+  /// overlay array \a scalarName of \a modelNode, decoding it in place.
+  /// Other overlays have a single frame.
+  int GetScalarOverlayNumberOfFrames(vtkMRMLModelNode* modelNode, const char* scalarName);
+  int GetScalarOverlayFrame(vtkMRMLModelNode* modelNode, const char* scalarName);
+  bool SetScalarOverlayFrame(vtkMRMLModelNode* modelNode, const char* scalarName, int frame);
   vtkMRMLMarkupsCurveNode* LoadFreeSurferCurve(std::string fileName);
   vtkMRMLMarkupsPlaneNode* LoadFreeSurferPlane(std::string fileName);
 
+  /// Name and color the segments after their label value in the default
+  /// FreeSurfer LUT, which is parsed once per process.
   void ApplyFreeSurferSegmentationLUT(vtkMRMLSegmentationNode* segmentation);
 
   /// Return the default freesurfer color node id for a given type
@@ -93,12 +124,19 @@ protected:
   void AddFreeSurferNode(int type);
   void AddFreeSurferLabelNodeFromFile(const char* fileName);
   void AddFreeSurferNodes();
-  vtkMRMLColorTableNode* CreateFileNode(const char* fileName);
+  /// Path of the default FreeSurfer LUT in the module share directory
+  std::string GetFreeSurferLabelFileName();
+
+  /// Reader kept by a multi-frame overlay array, or nullptr
+  vtkFSSurfaceMGHReader* GetScalarOverlayFrameReader(vtkMRMLModelNode* modelNode, const char* scalarName,
+                                                     vtkFloatArray** scalars = nullptr);
 
   static void SortByBranchlessMinimumSpanningTreePosition(vtkPoints* points, vtkDoubleArray* parameters);
 
   static std::string TempColorNodeID;
 
+  vtkSmartPointer<vtkMRMLFreeSurferOverlayCache> OverlayCache;
+
 private:
 
   vtkSlicerFreeSurferImporterLogic(const vtkSlicerFreeSurferImporterLogic&); // Not implemented
@@ -0,0 +1,152 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include "vtkFSIO.h"
+#include "vtkFSReaderCore.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const int HOSTILE_COUNT = 0x7fffffff;
+
+//----------------------------------------------------------------------------
+// Write \a magic followed by big endian \a values
+bool WriteHeader(const std::string& fileName, const char* magic, size_t magicSize,
+                 const std::vector<int>& values, bool compress = false)
+{
+  vtkFSIO::OutputStream stream;
+  if (!stream.Open(fileName.c_str(), compress))
+    {
+    return false;
+    }
+  stream.Write(magic, magicSize);
+  vtkFSIO::WriteIntArray(stream, values.data(), values.size());
+  return stream.Close();
+}
+
+//----------------------------------------------------------------------------
+bool SameSurface(const vtkFSIO::SurfaceData& surface1, const vtkFSIO::SurfaceData& surface2)
+{
+  return surface1.NumberOfVertices == surface2.NumberOfVertices &&
+         surface1.NumberOfFaces == surface2.NumberOfFaces &&
+         surface1.Points.GetSize() == surface2.Points.GetSize() &&
+         surface1.Faces.GetSize() == surface2.Faces.GetSize() &&
+         memcmp(surface1.Points.GetData(), surface2.Points.GetData(), surface1.Points.GetSize() * sizeof(float)) == 0 &&
+         memcmp(surface1.Faces.GetData(), surface2.Faces.GetData(), surface1.Faces.GetSize() * sizeof(int)) == 0;
+}
+
+}
+
+// Read the test data from several threads, and files whose counts don't
+// fit in them
+int vtkFSReaderCoreTest1(int argc, char * argv[] )
+{
+  if (argc < 3)
+    {
+    std::cerr << "Usage: " << argv[0] << " <test data directory> <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string dataDirectory = argv[1];
+  const std::string tempDirectory = argv[2];
+  const std::string surfaceFileName = dataDirectory + "/lh.dart.orig";
+  const std::string curvFileName = dataDirectory + "/lh.dart.curv";
+
+  vtkFSIO::SurfaceReadOptions options;
+  vtkFSIO::SurfaceData surface;
+  CHECK_BOOL(vtkFSIO::ReadSurfaceFile(surfaceFileName.c_str(), options, surface).IsOk(), true);
+  CHECK_INT(surface.NumberOfVerticesPerFace, vtkFSIO::FS_NUM_VERTS_IN_TRI_FACE);
+  CHECK_INT(static_cast<int>(surface.Points.GetSize()), 3 * surface.NumberOfVertices);
+  CHECK_INT(static_cast<int>(surface.Faces.GetSize()), 3 * surface.NumberOfFaces);
+  vtkFSIO::ScalarData curv;
+  CHECK_BOOL(vtkFSIO::ReadScalarFile(curvFileName.c_str(), curv).IsOk(), true);
+  CHECK_INT(static_cast<int>(curv.Values.GetSize()), surface.NumberOfVertices);
+
+  // the same files from several threads, plain and memory mapped
+  const int numberOfReads = 16;
+  std::vector<int> sameResults(numberOfReads, 0);
+  vtkSMPTools::For(0, numberOfReads, 1,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType i = begin; i < end; ++i)
+      {
+      vtkFSIO::SurfaceReadOptions threadOptions;
+      threadOptions.UseMemoryMap = (i % 2 == 1);
+      vtkFSIO::SurfaceData threadSurface;
+      vtkFSIO::ScalarData threadCurv;
+      sameResults[i] =
+        vtkFSIO::ReadSurfaceFile(surfaceFileName.c_str(), threadOptions, threadSurface).IsOk() &&
+        vtkFSIO::ReadScalarFile(curvFileName.c_str(), threadCurv).IsOk() &&
+        SameSurface(threadSurface, surface) &&
+        threadCurv.Values.GetSize() == curv.Values.GetSize() &&
+        memcmp(threadCurv.Values.GetData(), curv.Values.GetData(), curv.Values.GetSize() * sizeof(float)) == 0;
+      }
+    });
+  for (int i = 0; i < numberOfReads; ++i)
+    {
+    CHECK_INT(sameResults[i], 1);
+    }
+
+  vtkFSIO::ScalarData missing;
+  CHECK_INT(vtkFSIO::ReadScalarFile((tempDirectory + "/lh.missing.curv").c_str(), missing).ErrorCode,
+            vtkFSIO::FS_READ_ERROR_OPEN);
+
+  // counts larger than the files are rejected before allocating for them
+  const char scalarMagic[3] = { '\xff', '\xff', '\xff' };
+  const std::string hostileCurvFileName = tempDirectory + "/lh.hostile.curv";
+  CHECK_BOOL(WriteHeader(hostileCurvFileName, scalarMagic, 3, { HOSTILE_COUNT, 0, 1 }), true);
+  vtkFSIO::ScalarData hostileCurv;
+  CHECK_INT(vtkFSIO::ReadScalarFile(hostileCurvFileName.c_str(), hostileCurv).ErrorCode, vtkFSIO::FS_READ_ERROR_EOF);
+  CHECK_INT(static_cast<int>(hostileCurv.Values.GetSize()), 0);
+
+  const char surfaceMagic[5] = { '\xff', '\xff', '\xfe', '\n', '\n' };
+  const std::string hostileSurfaceFileName = tempDirectory + "/lh.hostile.orig";
+  CHECK_BOOL(WriteHeader(hostileSurfaceFileName, surfaceMagic, 5, { HOSTILE_COUNT, HOSTILE_COUNT }), true);
+  vtkFSIO::SurfaceData hostileSurface;
+  CHECK_INT(vtkFSIO::ReadSurfaceFile(hostileSurfaceFileName.c_str(), options, hostileSurface).ErrorCode,
+            vtkFSIO::FS_READ_ERROR_EOF);
+  CHECK_INT(static_cast<int>(hostileSurface.Points.GetSize()), 0);
+
+  for (int compress = 0; compress < 2; ++compress)
+    {
+    const std::string hostileAnnotationFileName = tempDirectory + (compress ? "/lh.hostile.annot.gz" : "/lh.hostile.annot");
+    CHECK_BOOL(WriteHeader(hostileAnnotationFileName, "", 0, { HOSTILE_COUNT, 0, 0 }, compress != 0), true);
+    vtkFSIO::AnnotationData hostileAnnotation;
+    CHECK_INT(vtkFSIO::ReadAnnotationFile(hostileAnnotationFileName.c_str(), nullptr, false, hostileAnnotation).ErrorCode,
+              vtkFSIO::FS_READ_ERROR_NUM_VALUES);
+    CHECK_INT(static_cast<int>(hostileAnnotation.Labels.GetSize()), 0);
+    }
+
+  const std::string hostileLabelFileName = tempDirectory + "/lh.hostile.label";
+  FILE* labelFile = fopen(hostileLabelFileName.c_str(), "w");
+  CHECK_NOT_NULL(labelFile);
+  fputs("#!ascii label\n2000000000\n1 2.0 3.0 4.0 0.0\n", labelFile);
+  fclose(labelFile);
+  vtkFSIO::LabelData hostileLabel;
+  CHECK_INT(vtkFSIO::ReadLabelFile(hostileLabelFileName.c_str(), hostileLabel).ErrorCode,
+            vtkFSIO::FS_READ_ERROR_NUM_VALUES);
+  CHECK_INT(static_cast<int>(hostileLabel.Indices.GetSize()), 0);
+
+  return EXIT_SUCCESS;
+}
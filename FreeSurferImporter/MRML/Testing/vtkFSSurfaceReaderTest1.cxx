@@ -0,0 +1,126 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include "vtkFSReaderCore.h"
+#include "vtkFSSurfaceReader.h"
+#include "vtkFSWriterCore.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+// STD includes
+#include <string>
+
+// Read a surface in pieces, and a surface with a face out of its vertices
+int vtkFSSurfaceReaderTest1(int argc, char * argv[] )
+{
+  if (argc < 3)
+    {
+    std::cerr << "Usage: " << argv[0] << " <test data directory> <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string dataDirectory = argv[1];
+  const std::string tempDirectory = argv[2];
+  const std::string surfaceFileName = dataDirectory + "/lh.dart.orig";
+
+  vtkNew<vtkFSSurfaceReader> reader;
+  reader->SetFileName(surfaceFileName.c_str());
+  reader->Update();
+  vtkNew<vtkPolyData> surface;
+  surface->DeepCopy(reader->GetOutput());
+  CHECK_BOOL(surface->GetNumberOfCells() > 0, true);
+  CHECK_NULL(surface->GetPointData()->GetArray("vtkOriginalPointIds"));
+
+  // the pieces are contiguous ranges of faces, in order, with the
+  // vertices they use in file order
+  for (int useMemoryMap = 0; useMemoryMap < 2; ++useMemoryMap)
+    {
+    reader->SetUseMemoryMap(useMemoryMap != 0);
+    for (int numberOfPieces = 2; numberOfPieces <= 3; ++numberOfPieces)
+      {
+      vtkIdType numberOfCells = 0;
+      for (int piece = 0; piece < numberOfPieces; ++piece)
+        {
+        reader->UpdatePiece(piece, numberOfPieces, 0);
+        vtkPolyData* output = reader->GetOutput();
+        vtkIdTypeArray* originalIds = vtkIdTypeArray::SafeDownCast(output->GetPointData()->GetArray("vtkOriginalPointIds"));
+        CHECK_NOT_NULL(originalIds);
+        CHECK_INT(originalIds->GetNumberOfTuples(), output->GetNumberOfPoints());
+        for (vtkIdType pointId = 1; pointId < originalIds->GetNumberOfTuples(); ++pointId)
+          {
+          CHECK_BOOL(originalIds->GetValue(pointId) > originalIds->GetValue(pointId - 1), true);
+          }
+        for (vtkIdType cellId = 0; cellId < output->GetNumberOfCells(); ++cellId)
+          {
+          vtkIdType numberOfCellPoints = 0;
+          const vtkIdType* cellPoints = nullptr;
+          output->GetPolys()->GetCellAtId(cellId, numberOfCellPoints, cellPoints);
+          vtkIdType numberOfSurfaceCellPoints = 0;
+          const vtkIdType* surfaceCellPoints = nullptr;
+          surface->GetPolys()->GetCellAtId(numberOfCells + cellId, numberOfSurfaceCellPoints, surfaceCellPoints);
+          CHECK_INT(numberOfCellPoints, numberOfSurfaceCellPoints);
+          for (vtkIdType i = 0; i < numberOfCellPoints; ++i)
+            {
+            CHECK_INT(originalIds->GetValue(cellPoints[i]), surfaceCellPoints[i]);
+            double point[3];
+            double surfacePoint[3];
+            output->GetPoints()->GetPoint(cellPoints[i], point);
+            surface->GetPoints()->GetPoint(surfaceCellPoints[i], surfacePoint);
+            CHECK_DOUBLE(point[0], surfacePoint[0]);
+            CHECK_DOUBLE(point[1], surfacePoint[1]);
+            CHECK_DOUBLE(point[2], surfacePoint[2]);
+            }
+          }
+        numberOfCells += output->GetNumberOfCells();
+        }
+      CHECK_INT(numberOfCells, surface->GetNumberOfCells());
+      }
+    }
+
+  // a face using a vertex past the last one
+  vtkFSIO::SurfaceReadOptions options;
+  vtkFSIO::SurfaceData data;
+  CHECK_BOOL(vtkFSIO::ReadSurfaceFile(surfaceFileName.c_str(), options, data).IsOk(), true);
+  data.Faces[data.Faces.GetSize() - 1] = data.NumberOfVertices + 2;
+  const std::string badFaceFileName = tempDirectory + "/lh.badface.orig";
+  CHECK_BOOL(vtkFSIO::WriteSurfaceFile(badFaceFileName.c_str(), data.Points.GetData(), data.NumberOfVertices,
+                                       data.Faces.GetData(), data.NumberOfFaces).IsOk(), true);
+  for (int useMemoryMap = 0; useMemoryMap < 2; ++useMemoryMap)
+    {
+    for (int numberOfPieces = 1; numberOfPieces <= 2; ++numberOfPieces)
+      {
+      options.UseMemoryMap = (useMemoryMap != 0);
+      options.NumberOfPieces = numberOfPieces;
+      options.Piece = numberOfPieces - 1;
+      vtkFSIO::SurfaceData badFaceData;
+      CHECK_INT(vtkFSIO::ReadSurfaceFile(badFaceFileName.c_str(), options, badFaceData).ErrorCode,
+                vtkFSIO::FS_READ_ERROR_FORMAT);
+      }
+    }
+
+  vtkNew<vtkFSSurfaceReader> badFaceReader;
+  badFaceReader->SetFileName(badFaceFileName.c_str());
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  badFaceReader->Update();
+  TESTING_OUTPUT_ASSERT_ERRORS_END();
+  CHECK_INT(badFaceReader->GetOutput()->GetNumberOfCells(), 0);
+
+  return EXIT_SUCCESS;
+}
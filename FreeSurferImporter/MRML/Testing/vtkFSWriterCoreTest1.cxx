@@ -0,0 +1,178 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include "vtkFSIO.h"
+#include "vtkFSReaderCore.h"
+#include "vtkFSWriterCore.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// STD includes
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Write each FreeSurfer surface format, plain and compressed, and read it
+// back
+int vtkFSWriterCoreTest1(int argc, char * argv[] )
+{
+  if (argc < 3)
+    {
+    std::cerr << "Usage: " << argv[0] << " <test data directory> <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string dataDirectory = argv[1];
+  const std::string tempDirectory = argv[2];
+
+  vtkFSIO::SurfaceReadOptions options;
+  vtkFSIO::SurfaceData surface;
+  CHECK_BOOL(vtkFSIO::ReadSurfaceFile((dataDirectory + "/lh.dart.orig").c_str(), options, surface).IsOk(), true);
+  const int numberOfVertices = surface.NumberOfVertices;
+  vtkFSIO::ScalarData curv;
+  CHECK_BOOL(vtkFSIO::ReadScalarFile((dataDirectory + "/lh.dart.curv").c_str(), curv).IsOk(), true);
+  CHECK_INT(static_cast<int>(curv.Values.GetSize()), numberOfVertices);
+
+  vtkFSIO::VolumeGeometry geometry;
+  geometry.Valid = true;
+  geometry.FileName = "orig.mgz";
+  for (int i = 0; i < 3; ++i)
+    {
+    geometry.Dimensions[i] = 256;
+    geometry.VoxelSize[i] = 1.0;
+    geometry.CRAS[i] = 0.5 * (i + 1);
+    }
+  geometry.XRAS[0] = -1.0;
+  geometry.YRAS[2] = -1.0;
+  geometry.ZRAS[1] = 1.0;
+
+  // every other vertex
+  std::vector<int> indices;
+  std::vector<float> values;
+  std::vector<float> coordinates;
+  for (int vertex = 0; vertex < numberOfVertices; vertex += 2)
+    {
+    indices.push_back(vertex);
+    values.push_back(curv.Values[vertex]);
+    coordinates.insert(coordinates.end(), surface.Points.GetData() + 3 * vertex, surface.Points.GetData() + 3 * vertex + 3);
+    }
+
+  // a sparse table, entry 1 is unused
+  vtkFSIO::ColorTable colorTable;
+  CHECK_BOOL(colorTable.SetNumberOfEntries(4), true);
+  CHECK_BOOL(colorTable.SetEntry(0, "unknown", 7, 25, 5, 25), true);
+  CHECK_BOOL(colorTable.SetEntry(2, "precentral", 10, 60, 20, 220), true);
+  CHECK_BOOL(colorTable.SetEntry(3, "postcentral", 11, 220, 20, 20), true);
+  std::vector<int> labels;
+  for (int vertex = 0; vertex < numberOfVertices; ++vertex)
+    {
+    labels.push_back(vertex % 3 == 0 ? 0 : 1 + vertex % 3);
+    }
+
+  const char* suffixes[2] = { "", ".gz" };
+  for (const char* suffix : suffixes)
+    {
+    const std::string surfaceFileName = tempDirectory + "/lh.written.orig" + suffix;
+    CHECK_BOOL(vtkFSIO::WriteSurfaceFile(surfaceFileName.c_str(), surface.Points.GetData(), numberOfVertices,
+                                         surface.Faces.GetData(), surface.NumberOfFaces, &geometry).IsOk(), true);
+    vtkFSIO::SurfaceData writtenSurface;
+    CHECK_BOOL(vtkFSIO::ReadSurfaceFile(surfaceFileName.c_str(), options, writtenSurface).IsOk(), true);
+    CHECK_INT(writtenSurface.NumberOfVertices, numberOfVertices);
+    CHECK_INT(writtenSurface.NumberOfFaces, surface.NumberOfFaces);
+    CHECK_INT(memcmp(writtenSurface.Points.GetData(), surface.Points.GetData(), surface.Points.GetSize() * sizeof(float)), 0);
+    CHECK_INT(memcmp(writtenSurface.Faces.GetData(), surface.Faces.GetData(), surface.Faces.GetSize() * sizeof(int)), 0);
+    const vtkFSIO::VolumeGeometry& writtenGeometry = writtenSurface.Geometry;
+    CHECK_BOOL(writtenGeometry.Valid, true);
+    CHECK_STD_STRING(writtenGeometry.FileName, geometry.FileName);
+    for (int i = 0; i < 3; ++i)
+      {
+      CHECK_INT(writtenGeometry.Dimensions[i], geometry.Dimensions[i]);
+      CHECK_DOUBLE_TOLERANCE(writtenGeometry.VoxelSize[i], geometry.VoxelSize[i], 1e-6);
+      CHECK_DOUBLE_TOLERANCE(writtenGeometry.XRAS[i], geometry.XRAS[i], 1e-6);
+      CHECK_DOUBLE_TOLERANCE(writtenGeometry.YRAS[i], geometry.YRAS[i], 1e-6);
+      CHECK_DOUBLE_TOLERANCE(writtenGeometry.ZRAS[i], geometry.ZRAS[i], 1e-6);
+      CHECK_DOUBLE_TOLERANCE(writtenGeometry.CRAS[i], geometry.CRAS[i], 1e-6);
+      }
+
+    const std::string curvFileName = tempDirectory + "/lh.written.curv" + suffix;
+    CHECK_BOOL(vtkFSIO::WriteScalarFile(curvFileName.c_str(), curv.Values.GetData(), numberOfVertices,
+                                        surface.NumberOfFaces).IsOk(), true);
+    vtkFSIO::ScalarData writtenCurv;
+    CHECK_BOOL(vtkFSIO::ReadScalarFile(curvFileName.c_str(), writtenCurv).IsOk(), true);
+    CHECK_INT(static_cast<int>(writtenCurv.Values.GetSize()), numberOfVertices);
+    CHECK_INT(memcmp(writtenCurv.Values.GetData(), curv.Values.GetData(), numberOfVertices * sizeof(float)), 0);
+    CHECK_DOUBLE(writtenCurv.Range[0], curv.Range[0]);
+    CHECK_DOUBLE(writtenCurv.Range[1], curv.Range[1]);
+
+    const std::string wFileName = tempDirectory + "/lh.written.w" + suffix;
+    CHECK_BOOL(vtkFSIO::WriteWFile(wFileName.c_str(), indices.data(), values.data(), indices.size()).IsOk(), true);
+    vtkFSIO::WFileData writtenW;
+    CHECK_BOOL(vtkFSIO::ReadWFile(wFileName.c_str(), writtenW).IsOk(), true);
+    CHECK_INT(static_cast<int>(writtenW.Indices.GetSize()), static_cast<int>(indices.size()));
+    for (size_t i = 0; i < indices.size(); ++i)
+      {
+      CHECK_INT(writtenW.Indices[i], indices[i]);
+      CHECK_DOUBLE(writtenW.Values[i], values[i]);
+      }
+
+    // the text format rounds coordinates and weights
+    const std::string labelFileName = tempDirectory + "/lh.written.label" + suffix;
+    CHECK_BOOL(vtkFSIO::WriteLabelFile(labelFileName.c_str(), indices.data(), coordinates.data(), values.data(),
+                                       indices.size(), "bert").IsOk(), true);
+    vtkFSIO::LabelData writtenLabel;
+    CHECK_BOOL(vtkFSIO::ReadLabelFile(labelFileName.c_str(), writtenLabel).IsOk(), true);
+    CHECK_INT(writtenLabel.NumberOfValues, static_cast<int>(indices.size()));
+    CHECK_INT(writtenLabel.NumberOfRows, static_cast<int>(indices.size()));
+    for (size_t i = 0; i < indices.size(); ++i)
+      {
+      CHECK_INT(writtenLabel.Indices[i], indices[i]);
+      CHECK_DOUBLE_TOLERANCE(writtenLabel.Weights[i], values[i], 1e-4);
+      for (size_t j = 3 * i; j < 3 * i + 3; ++j)
+        {
+        CHECK_DOUBLE_TOLERANCE(writtenLabel.Coordinates[j], coordinates[j], 1e-3);
+        }
+      }
+
+    const std::string annotationFileName = tempDirectory + "/lh.written.annot" + suffix;
+    CHECK_BOOL(vtkFSIO::WriteAnnotationFile(annotationFileName.c_str(), labels.data(), numberOfVertices,
+                                            colorTable).IsOk(), true);
+    vtkFSIO::AnnotationData writtenAnnotation;
+    vtkFSIO::ReadStatus annotationStatus = vtkFSIO::ReadAnnotationFile(annotationFileName.c_str(), nullptr, false,
+                                                                       writtenAnnotation);
+    CHECK_BOOL(annotationStatus.IsOk(), true);
+    CHECK_INT(static_cast<int>(annotationStatus.Warnings.size()), 0);
+    CHECK_BOOL(writtenAnnotation.GeneratedColorTable, false);
+    CHECK_BOOL(writtenAnnotation.HasUnassignedLabels, false);
+    for (int vertex = 0; vertex < numberOfVertices; ++vertex)
+      {
+      CHECK_INT(writtenAnnotation.Labels[vertex], labels[vertex]);
+      }
+    const vtkFSIO::ColorTable& writtenColorTable = *writtenAnnotation.Colors;
+    CHECK_INT(writtenColorTable.GetNumberOfEntries(), colorTable.GetNumberOfEntries());
+    for (int entry = 0; entry < colorTable.GetNumberOfEntries(); ++entry)
+      {
+      CHECK_BOOL(writtenColorTable.IsEntryUsed(entry), colorTable.IsEntryUsed(entry));
+      if (!colorTable.IsEntryUsed(entry))
+        {
+        continue;
+        }
+      CHECK_STRING(writtenColorTable.GetName(entry), colorTable.GetName(entry));
+      for (int component = 0; component < 3; ++component)
+        {
+        CHECK_INT(writtenColorTable.GetRGB(entry)[component], colorTable.GetRGB(entry)[component]);
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLFreeSurferLabelsColorNode.h"
+#include "vtkMRMLScene.h"
+
+// VTK includes
+#include <vtkLookupTable.h>
+
+// STD includes
+#include <cstdio>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+bool WriteLabels(const std::string& fileName, const char* text)
+{
+  FILE* file = fopen(fileName.c_str(), "w");
+  if (file == nullptr)
+    {
+    return false;
+    }
+  fputs(text, file);
+  return fclose(file) == 0;
+}
+
+}
+
+// Fill the node from its labels file on first use of its table
+int vtkMRMLFreeSurferLabelsColorNodeTest1(int argc, char * argv[] )
+{
+  if (argc < 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string tempDirectory = argv[1];
+
+  // without a file the node has no colors
+  vtkNew<vtkMRMLFreeSurferLabelsColorNode> node1;
+  vtkNew<vtkMRMLScene> scene;
+  scene->AddNode(node1.GetPointer());
+  EXERCISE_ALL_BASIC_MRML_METHODS(node1.GetPointer());
+  CHECK_INT(node1->GetNumberOfColors(), 0);
+
+  // entry 1 is unused
+  const std::string labelsFileName = tempDirectory + "/FreeSurferLabelsTest1.txt";
+  CHECK_BOOL(WriteLabels(labelsFileName,
+    "#No. Label Name                R   G   B   A\n"
+    "0   Unknown                    0   0   0   0\n"
+    "2   Left-Cerebral-White-Matter 245 245 245 0\n"), true);
+
+  vtkNew<vtkMRMLFreeSurferLabelsColorNode> node2;
+  node2->SetTypeToFile();
+  node2->SetLabelsFileName(labelsFileName.c_str());
+  scene->AddNode(node2.GetPointer());
+  CHECK_STRING(node2->GetLabelsFileName(), labelsFileName.c_str());
+  // a name asked for first fills the table too
+  CHECK_STRING(node2->GetColorName(2), "Left-Cerebral-White-Matter");
+  CHECK_INT(node2->GetNumberOfColors(), 3);
+  double color[4] = { 0.0, 0.0, 0.0, 0.0 };
+  CHECK_BOOL(node2->GetColor(2, color), true);
+  CHECK_DOUBLE_TOLERANCE(color[0], 245.0 / 255.0, 1e-6);
+  CHECK_DOUBLE_TOLERANCE(color[3], 1.0, 1e-6);
+  CHECK_BOOL(node2->GetColor(1, color), true);
+  CHECK_DOUBLE_TOLERANCE(color[3], 0.0, 1e-6);
+
+  // getting the table alone fills it too
+  vtkNew<vtkMRMLFreeSurferLabelsColorNode> node3;
+  node3->SetLabelsFileName(labelsFileName.c_str());
+  CHECK_NOT_NULL(node3->GetLookupTable());
+  CHECK_INT(node3->GetLookupTable()->GetNumberOfTableValues(), 3);
+
+  // another file refills it
+  const std::string otherLabelsFileName = tempDirectory + "/FreeSurferLabelsTest1Other.txt";
+  CHECK_BOOL(WriteLabels(otherLabelsFileName,
+    "0   Unknown                    0   0   0   0\n"
+    "4   Left-Lateral-Ventricle     120 18  134 0\n"), true);
+  node3->SetLabelsFileName(otherLabelsFileName.c_str());
+  CHECK_STD_STRING(node3->GetColorNameWithoutSpaces(4, "_"), "Left-Lateral-Ventricle");
+  CHECK_INT(node3->GetNumberOfColors(), 5);
+
+  // a copy shares the filled table
+  vtkNew<vtkMRMLFreeSurferLabelsColorNode> node4;
+  node4->Copy(node3.GetPointer());
+  CHECK_STRING(node4->GetLabelsFileName(), otherLabelsFileName.c_str());
+  CHECK_INT(node4->GetNumberOfColors(), 5);
+
+  return EXIT_SUCCESS;
+}
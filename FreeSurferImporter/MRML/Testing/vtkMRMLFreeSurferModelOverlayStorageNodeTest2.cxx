@@ -0,0 +1,120 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include "vtkFSReaderCore.h"
+#include "vtkFSSurfaceReader.h"
+#include "vtkFSWriterCore.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLFreeSurferModelOverlayStorageNode.h"
+#include "vtkMRMLModelNode.h"
+#include "vtkMRMLScene.h"
+
+// VTK includes
+#include <vtkCollection.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+// Load a batch of overlays, one of them missing, into two models
+int vtkMRMLFreeSurferModelOverlayStorageNodeTest2(int argc, char * argv[] )
+{
+  if (argc < 3)
+    {
+    std::cerr << "Usage: " << argv[0] << " <test data directory> <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string dataDirectory = argv[1];
+  const std::string tempDirectory = argv[2];
+
+  vtkNew<vtkFSSurfaceReader> surfaceReader;
+  surfaceReader->SetFileName((dataDirectory + "/lh.dart.orig").c_str());
+  surfaceReader->Update();
+  const int numberOfVertices = surfaceReader->GetOutput()->GetNumberOfPoints();
+  CHECK_BOOL(numberOfVertices > 0, true);
+
+  // a second overlay with the opposite of the curvatures
+  const std::string curvFileName = dataDirectory + "/lh.dart.curv";
+  vtkFSIO::ScalarData curv;
+  CHECK_BOOL(vtkFSIO::ReadScalarFile(curvFileName.c_str(), curv).IsOk(), true);
+  CHECK_INT(static_cast<int>(curv.Values.GetSize()), numberOfVertices);
+  std::vector<float> thickness(curv.Values.GetData(), curv.Values.GetData() + numberOfVertices);
+  for (float& value : thickness)
+    {
+    value = -value;
+    }
+  const std::string thicknessFileName = tempDirectory + "/lh.dart.thickness";
+  CHECK_BOOL(vtkFSIO::WriteScalarFile(thicknessFileName.c_str(), thickness.data(), thickness.size()).IsOk(), true);
+
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkCollection> modelNodes;
+  for (int i = 0; i < 2; ++i)
+    {
+    vtkNew<vtkPolyData> surface;
+    surface->DeepCopy(surfaceReader->GetOutput());
+    vtkNew<vtkMRMLModelNode> modelNode;
+    modelNode->SetAndObservePolyData(surface);
+    scene->AddNode(modelNode);
+    modelNodes->AddItem(modelNode);
+    }
+
+  vtkNew<vtkMRMLFreeSurferModelOverlayStorageNode> storageNode;
+  scene->AddNode(storageNode);
+
+  std::vector<std::string> fileNames;
+  fileNames.push_back(curvFileName);
+  fileNames.push_back(tempDirectory + "/lh.dart.missing.sulc");
+  fileNames.push_back(thicknessFileName);
+  std::vector<bool> loaded;
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  CHECK_INT(storageNode->ReadScalarOverlays(fileNames, modelNodes, &loaded), 4);
+  TESTING_OUTPUT_ASSERT_ERRORS_END();
+  CHECK_INT(static_cast<int>(loaded.size()), 3);
+  CHECK_BOOL(loaded[0], true);
+  CHECK_BOOL(loaded[1], false);
+  CHECK_BOOL(loaded[2], true);
+
+  vtkFloatArray* sharedCurv = nullptr;
+  for (int i = 0; i < 2; ++i)
+    {
+    vtkPointData* pointData = vtkMRMLModelNode::SafeDownCast(modelNodes->GetItemAsObject(i))->GetPolyData()->GetPointData();
+    vtkFloatArray* curvArray = vtkFloatArray::SafeDownCast(pointData->GetArray("curv"));
+    vtkFloatArray* thicknessArray = vtkFloatArray::SafeDownCast(pointData->GetArray("thickness"));
+    CHECK_NOT_NULL(curvArray);
+    CHECK_NOT_NULL(thicknessArray);
+    CHECK_NULL(pointData->GetArray("sulc"));
+    CHECK_INT(curvArray->GetNumberOfTuples(), numberOfVertices);
+    CHECK_INT(thicknessArray->GetNumberOfTuples(), numberOfVertices);
+    for (int vertex = 0; vertex < numberOfVertices; ++vertex)
+      {
+      CHECK_DOUBLE(curvArray->GetValue(vertex), curv.Values[vertex]);
+      CHECK_DOUBLE(thicknessArray->GetValue(vertex), -curv.Values[vertex]);
+      }
+    // the models have the same number of vertices, the file is decoded once
+    if (i == 0)
+      {
+      sharedCurv = curvArray;
+      }
+    else
+      {
+      CHECK_POINTER(curvArray, sharedCurv);
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include "vtkFSSurfaceMultiLabelReader.h"
+#include "vtkFSSurfaceReader.h"
+#include "vtkFSWriterCore.h"
+
+// MRML includes
+#include "vtkMRMLColorTableNode.h"
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLFreeSurferModelOverlayStorageNode.h"
+#include "vtkMRMLModelNode.h"
+#include "vtkMRMLScene.h"
+
+// VTK includes
+#include <vtkIdList.h>
+#include <vtkIntArray.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkUnsignedIntArray.h>
+
+// STD includes
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// more labels than the bits of a mask component
+const int NUMBER_OF_LABELS = 40;
+
+//----------------------------------------------------------------------------
+bool IsInLabel(int label, int vertex)
+{
+  return (7 * label + vertex) % 3 == 0;
+}
+
+//----------------------------------------------------------------------------
+std::string GetLabelName(int label)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "lh.label%02d", label);
+  return name;
+}
+
+}
+
+// Load the labels of a directory into one bitmask array
+int vtkMRMLFreeSurferModelOverlayStorageNodeTest3(int argc, char * argv[] )
+{
+  if (argc < 3)
+    {
+    std::cerr << "Usage: " << argv[0] << " <test data directory> <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string dataDirectory = argv[1];
+  const std::string tempDirectory = argv[2];
+
+  vtkNew<vtkFSSurfaceReader> surfaceReader;
+  surfaceReader->SetFileName((dataDirectory + "/lh.dart.orig").c_str());
+  surfaceReader->Update();
+  const int numberOfVertices = surfaceReader->GetOutput()->GetNumberOfPoints();
+  CHECK_BOOL(numberOfVertices > 0, true);
+
+  std::vector<std::string> fileNames;
+  for (int label = 0; label < NUMBER_OF_LABELS; ++label)
+    {
+    std::vector<int> indices;
+    for (int vertex = 0; vertex < numberOfVertices; ++vertex)
+      {
+      if (IsInLabel(label, vertex))
+        {
+        indices.push_back(vertex);
+        }
+      }
+    fileNames.push_back(tempDirectory + "/" + GetLabelName(label) + ".label");
+    CHECK_BOOL(vtkFSIO::WriteLabelFile(fileNames.back().c_str(), indices.data(), nullptr, nullptr, indices.size()).IsOk(), true);
+    }
+
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkMRMLModelNode> modelNode;
+  modelNode->SetAndObservePolyData(surfaceReader->GetOutput());
+  scene->AddNode(modelNode);
+  vtkNew<vtkMRMLFreeSurferModelOverlayStorageNode> storageNode;
+  scene->AddNode(storageNode);
+
+  std::vector<bool> loaded;
+  CHECK_INT(storageNode->ReadScalarOverlayLabels(fileNames, modelNode, "labels", &loaded), NUMBER_OF_LABELS);
+  CHECK_INT(static_cast<int>(loaded.size()), NUMBER_OF_LABELS);
+  for (int label = 0; label < NUMBER_OF_LABELS; ++label)
+    {
+    CHECK_BOOL(loaded[label], true);
+    }
+
+  vtkPointData* pointData = modelNode->GetPolyData()->GetPointData();
+  vtkUnsignedIntArray* mask = vtkUnsignedIntArray::SafeDownCast(pointData->GetArray("labels mask"));
+  vtkIntArray* firstLabels = vtkIntArray::SafeDownCast(pointData->GetArray("labels"));
+  CHECK_NOT_NULL(mask);
+  CHECK_NOT_NULL(firstLabels);
+  CHECK_INT(mask->GetNumberOfComponents(), 2);
+  CHECK_INT(mask->GetNumberOfTuples(), numberOfVertices);
+  for (int vertex = 0; vertex < numberOfVertices; ++vertex)
+    {
+    int numberOfVertexLabels = 0;
+    int firstLabel = 0;
+    for (int label = 0; label < NUMBER_OF_LABELS; ++label)
+      {
+      CHECK_BOOL(vtkFSSurfaceMultiLabelReader::IsVertexInLabel(mask, vertex, label), IsInLabel(label, vertex));
+      if (IsInLabel(label, vertex))
+        {
+        ++numberOfVertexLabels;
+        firstLabel = (firstLabel == 0 ? label + 1 : firstLabel);
+        }
+      }
+    CHECK_INT(vtkFSSurfaceMultiLabelReader::GetNumberOfVertexLabels(mask, vertex), numberOfVertexLabels);
+    CHECK_INT(firstLabels->GetValue(vertex), firstLabel);
+    }
+
+  // a label stored in the second component
+  const int lastLabel = NUMBER_OF_LABELS - 1;
+  vtkNew<vtkIdList> vertices;
+  vtkFSSurfaceMultiLabelReader::GetLabelVertices(mask, lastLabel, vertices);
+  int numberOfLabelVertices = 0;
+  for (int vertex = 0; vertex < numberOfVertices; ++vertex)
+    {
+    if (IsInLabel(lastLabel, vertex))
+      {
+      CHECK_INT(vertices->GetId(numberOfLabelVertices), vertex);
+      ++numberOfLabelVertices;
+      }
+    }
+  CHECK_INT(vertices->GetNumberOfIds(), numberOfLabelVertices);
+
+  // entry 0 is for the vertices in no label
+  vtkMRMLColorTableNode* colorNode = vtkMRMLColorTableNode::SafeDownCast(scene->GetFirstNodeByName("labels"));
+  CHECK_NOT_NULL(colorNode);
+  CHECK_INT(colorNode->GetNumberOfColors(), NUMBER_OF_LABELS + 1);
+  CHECK_STD_STRING(colorNode->GetColorName(NUMBER_OF_LABELS), GetLabelName(lastLabel));
+
+  return EXIT_SUCCESS;
+}
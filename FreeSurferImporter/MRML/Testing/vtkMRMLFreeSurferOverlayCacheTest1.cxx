@@ -0,0 +1,104 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include "vtkFSReaderCore.h"
+#include "vtkFSSurfaceScalarReader.h"
+#include "vtkFSWriterCore.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLFreeSurferOverlayCache.h"
+
+// VTK includes
+#include <vtkFloatArray.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+bool DecodeOverlay(const std::string& fileName, vtkMRMLFreeSurferOverlayCache::Overlay& overlay)
+{
+  vtkNew<vtkFloatArray> scalars;
+  vtkNew<vtkFSSurfaceScalarReader> reader;
+  reader->SetFileName(fileName.c_str());
+  reader->SetOutput(scalars);
+  overlay.Scalars = scalars.GetPointer();
+  return reader->ReadFSScalars() != 0;
+}
+
+}
+
+// Check that cached overlays are dropped when their file or their arrays
+// change
+int vtkMRMLFreeSurferOverlayCacheTest1(int argc, char * argv[] )
+{
+  if (argc < 3)
+    {
+    std::cerr << "Usage: " << argv[0] << " <test data directory> <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string dataDirectory = argv[1];
+  const std::string tempDirectory = argv[2];
+
+  // a copy of the curvatures that can be touched
+  vtkFSIO::ScalarData curv;
+  CHECK_BOOL(vtkFSIO::ReadScalarFile((dataDirectory + "/lh.dart.curv").c_str(), curv).IsOk(), true);
+  const int numberOfVertices = static_cast<int>(curv.Values.GetSize());
+  const std::string fileName = tempDirectory + "/lh.cache.curv";
+  CHECK_BOOL(vtkFSIO::WriteScalarFile(fileName.c_str(), curv.Values.GetData(), curv.Values.GetSize()).IsOk(), true);
+
+  vtkNew<vtkMRMLFreeSurferOverlayCache> cache;
+  vtkMRMLFreeSurferOverlayCache::Overlay overlay;
+  CHECK_BOOL(DecodeOverlay(fileName, overlay), true);
+  cache->AddOverlay(fileName, numberOfVertices, overlay);
+  CHECK_INT(cache->GetNumberOfOverlays(), 1);
+
+  // hit, the cached array is shared
+  vtkMRMLFreeSurferOverlayCache::Overlay cached;
+  CHECK_BOOL(cache->GetOverlay(fileName, numberOfVertices, cached), true);
+  CHECK_POINTER(cached.Scalars.GetPointer(), overlay.Scalars.GetPointer());
+  // the entry is for a number of vertices
+  CHECK_BOOL(cache->GetOverlay(fileName, numberOfVertices + 1, cached), false);
+  CHECK_INT(cache->GetNumberOfOverlays(), 1);
+
+  // a model editing the shared array in place
+  vtkFloatArray::SafeDownCast(overlay.Scalars)->SetValue(0, 10.0f);
+  overlay.Scalars->Modified();
+  CHECK_BOOL(cache->GetOverlay(fileName, numberOfVertices, cached), false);
+  CHECK_INT(cache->GetNumberOfOverlays(), 0);
+
+  vtkMRMLFreeSurferOverlayCache::Overlay reloaded;
+  CHECK_BOOL(DecodeOverlay(fileName, reloaded), true);
+  CHECK_DOUBLE(vtkFloatArray::SafeDownCast(reloaded.Scalars)->GetValue(0), curv.Values[0]);
+  cache->AddOverlay(fileName, numberOfVertices, reloaded);
+  CHECK_BOOL(cache->GetOverlay(fileName, numberOfVertices, cached), true);
+  CHECK_POINTER(cached.Scalars.GetPointer(), reloaded.Scalars.GetPointer());
+
+  // the file is touched, modification times are in seconds
+  const long int fileTime = vtksys::SystemTools::ModifiedTime(fileName);
+  for (int attempt = 0; attempt < 30 && vtksys::SystemTools::ModifiedTime(fileName) == fileTime; ++attempt)
+    {
+    vtksys::SystemTools::Delay(100);
+    vtksys::SystemTools::Touch(fileName, false);
+    }
+  CHECK_BOOL(vtksys::SystemTools::ModifiedTime(fileName) != fileTime, true);
+  CHECK_BOOL(cache->GetOverlay(fileName, numberOfVertices, cached), false);
+  CHECK_INT(cache->GetNumberOfOverlays(), 0);
+  CHECK_INT(cache->GetMemorySize(), 0);
+
+  return EXIT_SUCCESS;
+}
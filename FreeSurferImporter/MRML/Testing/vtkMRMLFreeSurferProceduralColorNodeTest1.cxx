@@ -14,6 +14,8 @@
 #include "vtkMRMLFreeSurferProceduralColorNode.h"
 #include "vtkMRMLScene.h"
 
+#include "vtkFSLookupTable.h"
+
 int vtkMRMLFreeSurferProceduralColorNodeTest1(int , char * [] )
 {
   vtkNew<vtkMRMLFreeSurferProceduralColorNode> node1;
@@ -21,5 +23,16 @@ int vtkMRMLFreeSurferProceduralColorNodeTest1(int , char * [] )
   scene->AddNode(node1.GetPointer());
   node1->SetTypeToBlueRed();
   EXERCISE_ALL_BASIC_MRML_METHODS(node1.GetPointer());
+
+  // the ramp table is opt in, and set on the table built before or after
+  CHECK_INT(node1->GetUseRampTable(), 0);
+  CHECK_INT(node1->GetFSLookupTable()->GetUseRampTable(), 0);
+  node1->UseRampTableOn();
+  CHECK_INT(node1->GetFSLookupTable()->GetUseRampTable(), 1);
+  vtkNew<vtkMRMLFreeSurferProceduralColorNode> node2;
+  node2->SetTypeToHeat();
+  node2->UseRampTableOn();
+  CHECK_INT(node2->GetFSLookupTable()->GetUseRampTable(), 1);
+
   return EXIT_SUCCESS;
 }
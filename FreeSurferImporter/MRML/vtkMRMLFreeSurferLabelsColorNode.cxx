@@ -0,0 +1,203 @@
+/*=auto=========================================================================
+
+Portions (c) Copyright 2006 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+See COPYRIGHT.txt
+or http://www.slicer.org/copyright/copyright.txt for details.
+
+Program:   3D Slicer
+
+=========================================================================auto=*/
+#include <memory>
+
+#include "vtkLookupTable.h"
+#include "vtkNew.h"
+#include "vtkObjectFactory.h"
+#include "vtkUnsignedCharArray.h"
+
+#include "vtkMRMLFreeSurferLabelsColorNode.h"
+
+#include "vtkFSReaderCore.h"
+
+//------------------------------------------------------------------------------
+vtkMRMLNodeNewMacro(vtkMRMLFreeSurferLabelsColorNode);
+
+//----------------------------------------------------------------------------
+vtkMRMLFreeSurferLabelsColorNode::vtkMRMLFreeSurferLabelsColorNode()
+{
+  this->LookupTableBuilt = false;
+  this->HideFromEditors = 1;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLFreeSurferLabelsColorNode::~vtkMRMLFreeSurferLabelsColorNode() = default;
+
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferLabelsColorNode::WriteXML(ostream& of, int nIndent)
+{
+  Superclass::WriteXML(of, nIndent);
+
+  of << " labelsFileName=\"" << this->LabelsFileName << "\"";
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferLabelsColorNode::ReadXMLAttributes(const char** atts)
+{
+  Superclass::ReadXMLAttributes(atts);
+
+  const char* attName;
+  const char* attValue;
+  while (*atts != nullptr)
+    {
+    attName = *(atts++);
+    attValue = *(atts++);
+    if (!strcmp(attName, "labelsFileName"))
+      {
+      this->SetLabelsFileName(attValue);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Copy the node's attributes to this object.
+// Does NOT copy: ID, FilePrefix, Name, ID
+void vtkMRMLFreeSurferLabelsColorNode::Copy(vtkMRMLNode *anode)
+{
+  Superclass::Copy(anode);
+  vtkMRMLFreeSurferLabelsColorNode *node = vtkMRMLFreeSurferLabelsColorNode::SafeDownCast(anode);
+
+  if (node != nullptr)
+    {
+    // the superclass shares the table of the other node, filled or not
+    this->LabelsFileName = node->LabelsFileName;
+    this->LookupTableBuilt = node->LookupTableBuilt;
+    }
+  else
+    {
+    vtkErrorMacro("Copy: unable to cast a vtkMRMLNode to a vtkMRMLFreeSurferLabelsColorNode for node id = " << anode->GetID());
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferLabelsColorNode::PrintSelf(ostream& os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os,indent);
+
+  os << indent << "LabelsFileName: " << this->LabelsFileName << "\n";
+  os << indent << "LookupTableBuilt: " << this->LookupTableBuilt << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferLabelsColorNode::SetLabelsFileName(const char* fileName)
+{
+  std::string newFileName = fileName ? fileName : "";
+  if (newFileName == this->LabelsFileName)
+    {
+    return;
+    }
+  this->LabelsFileName = newFileName;
+  this->LookupTableBuilt = false;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+const char* vtkMRMLFreeSurferLabelsColorNode::GetLabelsFileName()
+{
+  return this->LabelsFileName.c_str();
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLFreeSurferLabelsColorNode::BuildLookupTable()
+{
+  // set first, the superclass methods used below get the table
+  this->LookupTableBuilt = true;
+
+  // a node without a file, as created when a scene is read, has no colours
+  if (this->LookupTable == nullptr || this->LabelsFileName.empty())
+    {
+    return;
+    }
+
+  // Fill the node from the table shared with segmentation loading, rather
+  // than parsing the file again with a color table storage node
+  vtkFSIO::ReadStatus status;
+  std::shared_ptr<const vtkFSIO::ColorTable> colorTable = vtkFSIO::GetSharedColorTable(this->LabelsFileName.c_str(), status);
+  if (!colorTable)
+    {
+    vtkErrorMacro("BuildLookupTable: unable to read file as color table " << this->LabelsFileName << ": " << status.Message);
+    return;
+    }
+
+  MRMLNodeModifyBlocker blocker(this);
+  int numberOfColors = colorTable->GetNumberOfEntries();
+  this->SetNumberOfColors(numberOfColors);
+
+  // The LUT has an alpha of 0 for all colors, use 1 for the used entries
+  vtkNew<vtkUnsignedCharArray> table;
+  table->SetNumberOfComponents(4);
+  table->SetNumberOfTuples(numberOfColors);
+  unsigned char* rgba = table->GetPointer(0);
+  for (int i = 0; i < numberOfColors; ++i, rgba += 4)
+    {
+    const int* rgb = colorTable->GetRGB(i);
+    if (rgb == nullptr)
+      {
+      rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0;
+      continue;
+      }
+    rgba[0] = static_cast<unsigned char>(rgb[0]);
+    rgba[1] = static_cast<unsigned char>(rgb[1]);
+    rgba[2] = static_cast<unsigned char>(rgb[2]);
+    rgba[3] = 255;
+    this->SetColorName(i, colorTable->GetName(i));
+    }
+  this->LookupTable->SetTable(table);
+  this->LookupTable->SetTableRange(0, numberOfColors - 1);
+  this->SetNamesInitialised(true);
+}
+
+//---------------------------------------------------------------------------
+vtkLookupTable * vtkMRMLFreeSurferLabelsColorNode::GetLookupTable()
+{
+  if (!this->LookupTableBuilt)
+    {
+    this->BuildLookupTable();
+    }
+  return this->LookupTable;
+}
+
+//---------------------------------------------------------------------------
+vtkScalarsToColors* vtkMRMLFreeSurferLabelsColorNode::GetScalarsToColors()
+{
+  return this->GetLookupTable();
+}
+
+//---------------------------------------------------------------------------
+int vtkMRMLFreeSurferLabelsColorNode::GetNumberOfColors()
+{
+  if (!this->LookupTableBuilt)
+    {
+    this->BuildLookupTable();
+    }
+  return Superclass::GetNumberOfColors();
+}
+
+//---------------------------------------------------------------------------
+bool vtkMRMLFreeSurferLabelsColorNode::GetColor(int entry, double color[4])
+{
+  if (!this->LookupTableBuilt)
+    {
+    this->BuildLookupTable();
+    }
+  return Superclass::GetColor(entry, color);
+}
+
+//---------------------------------------------------------------------------
+const char* vtkMRMLFreeSurferLabelsColorNode::GetColorName(int ind)
+{
+  if (!this->LookupTableBuilt)
+    {
+    this->BuildLookupTable();
+    }
+  return Superclass::GetColorName(ind);
+}
@@ -0,0 +1,89 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2006 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+#ifndef __vtkMRMLFreeSurferLabelsColorNode_h
+#define __vtkMRMLFreeSurferLabelsColorNode_h
+
+#include "vtkMRMLColorTableNode.h"
+#include "vtkSlicerFreeSurferImporterModuleMRMLExport.h"
+
+// STD includes
+#include <string>
+
+/// \brief MRML node holding the colours of a FreeSurfer text look up table,
+/// such as FreeSurferColorLUT.txt.
+///
+/// The node added to each new scene only knows the name of its file. Its
+/// table and colour names are filled from the file when the table is first
+/// used, whoever uses it: a segmentation, an annotation without an embedded
+/// table, or a lookup of the node by ID. The file is parsed once per process
+/// and shared with the segmentation loading, see vtkFSIO::GetSharedColorTable.
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_MRML_EXPORT vtkMRMLFreeSurferLabelsColorNode : public vtkMRMLColorTableNode
+{
+public:
+  static vtkMRMLFreeSurferLabelsColorNode *New();
+  vtkTypeMacro(vtkMRMLFreeSurferLabelsColorNode,vtkMRMLColorTableNode);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  //--------------------------------------------------------------------------
+  /// MRMLNode methods
+  //--------------------------------------------------------------------------
+
+  vtkMRMLNode* CreateNodeInstance() override;
+
+  ///
+  /// Set node attributes
+  void ReadXMLAttributes( const char** atts) override;
+
+  ///
+  /// Write this node's information to a MRML file in XML format.
+  void WriteXML(ostream& of, int indent) override;
+
+  ///
+  /// Copy the node's attributes to this object
+  void Copy(vtkMRMLNode *node) override;
+
+  ///
+  /// Get node XML tag name (like Volume, Model)
+  const char* GetNodeTagName() override {return "FreeSurferLabelsColor";};
+
+  ///
+  /// Text look up table the colours are read from. Setting another file
+  /// makes the table read again on its next use.
+  void SetLabelsFileName(const char* fileName);
+  const char* GetLabelsFileName();
+
+  ///
+  /// Get the lookup table, filled from the labels file on first use
+  vtkLookupTable *GetLookupTable() override;
+  vtkScalarsToColors* GetScalarsToColors() override;
+
+  int GetNumberOfColors() override;
+  bool GetColor(int entry, double color[4]) override;
+  /// Also used by GetColorNameWithoutSpaces
+  const char* GetColorName(int ind) override;
+
+protected:
+  vtkMRMLFreeSurferLabelsColorNode();
+  ~vtkMRMLFreeSurferLabelsColorNode() override;
+  vtkMRMLFreeSurferLabelsColorNode(const vtkMRMLFreeSurferLabelsColorNode&);
+  void operator=(const vtkMRMLFreeSurferLabelsColorNode&);
+
+  ///
+  /// Set the colours and the colour names of the table from the labels
+  /// file. A file that can't be read leaves the table empty.
+  void BuildLookupTable();
+
+  std::string LabelsFileName;
+  bool LookupTableBuilt;
+};
+
+#endif
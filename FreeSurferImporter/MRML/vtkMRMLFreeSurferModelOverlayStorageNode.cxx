@@ -17,38 +17,71 @@ Version:   $Revision: 1.2 $
 #include <vtkFSSurfaceLabelReader.h>
 #include <vtkFSSurfaceScalarReader.h>
 #include <vtkFSSurfaceAnnotationReader.h>
+#include <vtkFSSurfaceMGHReader.h>
+#include <vtkFSSurfaceMultiLabelReader.h>
+#include <vtkFSWriterCore.h>
 
 // MRML includes
 #include "vtkMRMLColorTableNode.h"
 #include "vtkMRMLFreeSurferModelOverlayStorageNode.h"
+#include "vtkMRMLFreeSurferOverlayCache.h"
 #include "vtkMRMLFreeSurferProceduralColorNode.h"
 #include "vtkMRMLModelNode.h"
 #include "vtkMRMLModelDisplayNode.h"
 #include "vtkMRMLScene.h"
 
-// VTK ITK includes
-#include "vtkITKArchetypeImageSeriesScalarReader.h"
-
 // VTK includes
 #include <vtkCollection.h>
 #include <vtkFloatArray.h>
-#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkIntArray.h>
+#include <vtkLookupTable.h>
+#include <vtkMath.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkPointData.h>
+#include <vtkPoints.h>
 #include <vtkPolyData.h>
+#include <vtkSMPTools.h>
 #include <vtkStringArray.h>
+#include <vtkUnsignedIntArray.h>
 #include <vtksys/SystemTools.hxx>
 
 // ITKSys includes
 
 // STD includes
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <vector>
 
 // Initialize static member that controls resampling --
 // old comment: "This offset will be changed to 0.5 from 0.0 per 2/8/2002 Slicer
 // development meeting, to move ijk coordinates to voxel centers."
 
 
+namespace
+{
+//----------------------------------------------------------------------------
+// Lowercase extension of an overlay file name, ignoring the .gz suffix of
+// compressed files. The FreeSurfer readers detect compression themselves.
+std::string GetUncompressedLowercaseExtension(const std::string& fullName)
+{
+  std::string fileName = vtksys::SystemTools::LowerCase(fullName);
+  const std::string gzSuffix = ".gz";
+  if (fileName.size() > gzSuffix.size() &&
+      fileName.compare(fileName.size() - gzSuffix.size(), gzSuffix.size(), gzSuffix) == 0)
+    {
+    fileName.erase(fileName.size() - gzSuffix.size());
+    }
+  return vtkMRMLStorageNode::GetLowercaseExtensionFromFileName(fileName);
+}
+
+//----------------------------------------------------------------------------
+// Value of the vertices outside of a label, see DecodeScalarOverlay
+const double LabelOffValue = 1000.0;
+}
+
 //------------------------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLFreeSurferModelOverlayStorageNode);
 
@@ -68,7 +101,7 @@ void vtkMRMLFreeSurferModelOverlayStorageNode::PrintSelf(ostream& os, vtkIndent
 std::string vtkMRMLFreeSurferModelOverlayStorageNode::GetOverlayNameFromFileName(const std::string& fullName)
 {
   std::string fileName = vtksys::SystemTools::GetFilenameName(fullName);
-  std::string extension = vtkMRMLStorageNode::GetLowercaseExtensionFromFileName(fullName);
+  std::string extension = GetUncompressedLowercaseExtension(fullName);
   if (extension[0] == '.' && extension.size() > 1)
   {
     extension = extension.substr(1, extension.length() - 1);
@@ -88,18 +121,26 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlay(const std::stri
 {
   // the array to read into
   vtkNew<vtkFloatArray> floatArray;
+  int numVertices = modelNode->GetPolyData()->GetPointData()->GetNumberOfTuples();
+  int errorCode = this->DecodeScalarOverlay(fullName, numVertices, floatArray.GetPointer());
+  return this->AddScalarOverlay(fullName, errorCode, floatArray.GetPointer(), modelNode);
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLFreeSurferModelOverlayStorageNode::DecodeScalarOverlay(const std::string& fullName,
+  int numVertices, vtkFloatArray* floatArray)
+{
   std::string scalarName = this->GetOverlayNameFromFileName(fullName);
   floatArray->SetName(scalarName.c_str());
-  int numVertices = modelNode->GetPolyData()->GetPointData()->GetNumberOfTuples();
 
-  std::string extension = vtkMRMLStorageNode::GetLowercaseExtensionFromFileName(fullName);
+  std::string extension = GetUncompressedLowercaseExtension(fullName);
   int errorCode = -1;
   if (extension == std::string(".w"))
     {
     vtkNew<vtkFSSurfaceWFileReader> reader;
     reader->SetFileName(fullName.c_str());
     reader->SetNumberOfVertices(numVertices);
-    reader->SetOutput(floatArray.GetPointer());
+    reader->SetOutput(floatArray);
     errorCode = reader->ReadWFile();
     }
   else if (extension == std::string(".label"))
@@ -107,12 +148,12 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlay(const std::stri
     vtkNew<vtkFSSurfaceLabelReader> reader;
     reader->SetFileName(fullName.c_str());
     reader->SetNumberOfVertices(numVertices);
-    reader->SetOutput(floatArray.GetPointer());
+    reader->SetOutput(floatArray);
 
     // set the scalar values for the label overlay being read in, unknown
     // for off and cerebral cortex for on, from the freesurfer labels
     // colour file
-    reader->SetLabelOff(1000.0);
+    reader->SetLabelOff(LabelOffValue);
     reader->SetLabelOn(3.0);
 
     errorCode = reader->ReadLabel();
@@ -121,11 +162,17 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlay(const std::stri
     {
     vtkNew<vtkFSSurfaceScalarReader> reader;
     reader->SetFileName(fullName.c_str());
-    reader->SetOutput(floatArray.GetPointer());
+    reader->SetOutput(floatArray);
     // reader->ReadFSScalars() returns 0 on error, 1 on success
     errorCode = (reader->ReadFSScalars() == 0 ? -1 : 0);
     }
+  return errorCode;
+}
 
+//----------------------------------------------------------------------------
+bool vtkMRMLFreeSurferModelOverlayStorageNode::AddScalarOverlay(const std::string& fullName,
+  int errorCode, vtkFloatArray* floatArray, vtkMRMLModelNode* modelNode)
+{
   if (errorCode != 0)
     {
     // Reading failed
@@ -145,10 +192,12 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlay(const std::stri
     }
 
   // Reading was successful
+  std::string scalarName = floatArray->GetName();
+  std::string extension = GetUncompressedLowercaseExtension(fullName);
   vtkDebugMacro("Finished reading FreeSurfer model scalar overlay file " << fullName.c_str()
     << "\n\tscalars called " << scalarName.c_str()
     << ", adding point scalars to model node " << modelNode->GetName());
-  modelNode->AddPointScalars(floatArray.GetPointer());
+  modelNode->AddPointScalars(floatArray);
 
   // make sure scalars are visible
   vtkMRMLModelDisplayNode *displayNode = modelNode->GetModelDisplayNode();
@@ -166,7 +215,6 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlay(const std::stri
     else // .thickness, .curv, .avg_curv, .sulc, .area, or anything else
       {
       // set the colour look up table
-      std::string extension = vtkMRMLStorageNode::GetLowercaseExtensionFromFileName(fullName);
       std::string colorNodeID = this->GetColorNodeIDFromExtension(extension);
       if (!colorNodeID.empty())
         {
@@ -201,19 +249,33 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayAnnot(const std:
     return false;
     }
 
-  // set up a look up table
-  vtkNew<vtkMRMLColorTableNode> lutNode;
-  lutNode->SetTypeToUser();
-
+  vtkNew<vtkLookupTable> colors;
   vtkNew<vtkFSSurfaceAnnotationReader> reader;
+  int errorCode = this->DecodeScalarOverlayAnnot(fullName, scalars, colors.GetPointer(), reader.GetPointer());
+  std::string colorNodeId;
+  return this->AddScalarOverlayAnnot(fullName, errorCode, scalars, colors.GetPointer(), reader.GetPointer(),
+                                     modelNode, colorNodeId);
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLFreeSurferModelOverlayStorageNode::DecodeScalarOverlayAnnot(const std::string& fullName,
+  vtkIntArray* scalars, vtkLookupTable* colors, vtkFSSurfaceAnnotationReader* reader)
+{
+  scalars->SetName(vtksys::SystemTools::GetFilenameName(fullName).c_str());
   reader->SetFileName(fullName.c_str());
   reader->SetOutput(scalars);
-  reader->SetColorTableOutput(lutNode->GetLookupTable());
+  reader->SetColorTableOutput(colors);
   //try reading an internal colour table first
   reader->UseExternalColorTableFileOff();
   reader->SetDebug(this->GetDebug());
-  int errorCode = reader->ReadFSAnnotation();
+  return reader->ReadFSAnnotation();
+}
 
+//----------------------------------------------------------------------------
+bool vtkMRMLFreeSurferModelOverlayStorageNode::AddScalarOverlayAnnot(const std::string& fullName,
+  int errorCode, vtkIntArray* scalars, vtkLookupTable* colors,
+  vtkFSSurfaceAnnotationReader* reader, vtkMRMLModelNode* modelNode, std::string& colorNodeId)
+{
   if (errorCode != 0 && errorCode != 5 /* unassigned labels warning */ && errorCode != 6 /* no internal color table */)
     {
     // Reading failed
@@ -231,9 +293,23 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayAnnot(const std:
     return false;
     }
 
-  std::string colorNodeId;
+  std::string scalarName = vtksys::SystemTools::GetFilenameName(fullName);
+  if (modelNode->GetPolyData()->GetPointData()->GetArray(scalarName.c_str()) != scalars)
+    {
+    // decoded into a new array
+    modelNode->AddPointScalars(scalars);
+    modelNode->GetPolyData()->GetPointData()->SetActiveScalars(scalarName.c_str());
+    }
 
-  if (errorCode == 6)
+  if (!colorNodeId.empty())
+    {
+    // already added for another model
+    if (errorCode != 6 && modelNode->GetModelDisplayNode())
+      {
+      modelNode->GetModelDisplayNode()->SetScalarRange(0, colors->GetNumberOfTableValues());
+      }
+    }
+  else if (errorCode == 6)
     {
     vtkDebugMacro("No Internal Color Table in " << fullName.c_str() << ", trying the default colours");
     vtkMRMLColorTableNode *cnode = nullptr;
@@ -242,8 +318,10 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayAnnot(const std:
       {
       cnode = vtkMRMLColorTableNode::SafeDownCast(labelNodes->GetItemAsObject(0));
       }
-    if (cnode == nullptr)
+    if (cnode == nullptr || cnode->GetNumberOfColors() == 0)
       {
+      // the FreeSurferLabels node reads its colours on this first use, it
+      // stays empty if its file can't be read
       vtkErrorMacro("Unable to find an internal nor an external colour look up table for " << fullName.c_str());
       return false;
       }
@@ -254,41 +332,33 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayAnnot(const std:
     {
     // no error, or just a warning about unassigned labels
 
+    // set up a look up table
+    vtkNew<vtkMRMLColorTableNode> lutNode;
+    lutNode->SetTypeToUser();
+    lutNode->GetLookupTable()->DeepCopy(colors);
+
     // set the number of colours so that can use add call to set the names
     int numColours = lutNode->GetNumberOfColors();
     lutNode->SetNumberOfColors(numColours);
 
-    std::string colorString = reader->GetColorTableNames();
-    vtkDebugMacro("Got color table names " << colorString << ", number of colours = " << numColours << endl);
+    vtkDebugMacro("Got " << reader->GetNumColorTableEntries() << " color table entries, number of colours = " << numColours << endl);
 
-    // color names are formatted as 'index {name} '
-    std::string::size_type startBracketIndex = colorString.find("{", 0);
-    std::string::size_type endBracketIndex = colorString.find( "}", 0 );
-    std::string colorIndexString = colorString.substr(0, startBracketIndex - 1);
-    int numNames = 0;
-    while (endBracketIndex != std::string::npos && numNames < reader->GetNumColorTableEntries())
+    for (int colorIndex = 0; colorIndex < reader->GetNumColorTableEntries(); ++colorIndex)
       {
-      numNames++;
-      std::string colorName = colorString.substr(startBracketIndex+1, endBracketIndex - startBracketIndex - 1);
-      vtkDebugMacro("Adding color name = " << colorName.c_str() << " at index \""
-        << colorIndexString.c_str() << "\"" << ", as int: " << atoi(colorIndexString.c_str()) <<  endl);
-      if (lutNode->SetColorName(atoi(colorIndexString.c_str()), colorName.c_str()) == 0)
+      const char* colorName = nullptr;
+      int rgb[3];
+      if (!reader->GetColorTableEntry(colorIndex, colorName, rgb))
         {
-        vtkErrorMacro("ReadData: error setting annotation color name " << colorName.c_str()
-          << " at index \"" << colorIndexString.c_str() << "\"" << ", as int: "
-          << atoi(colorIndexString.c_str()) <<", breaking the loop over " << reader->GetNumColorTableEntries() << " entries");
-        return false;
+        // unused entry in a sparse color table
+        continue;
         }
-      startBracketIndex = colorString.find("{", endBracketIndex);
-      if (startBracketIndex != std::string::npos)
-        {
-        colorIndexString = colorString.substr(endBracketIndex + 1, startBracketIndex - endBracketIndex - 1);
-        }
-      else
+      vtkDebugMacro("Adding color name = " << colorName << " at index " << colorIndex << endl);
+      if (lutNode->SetColorName(colorIndex, colorName) == 0)
         {
-        colorIndexString = colorString.substr(endBracketIndex + 1);
+        vtkErrorMacro("ReadData: error setting annotation color name " << colorName
+          << " at index " << colorIndex << ", breaking the loop over " << reader->GetNumColorTableEntries() << " entries");
+        return false;
         }
-      endBracketIndex = colorString.find( "}", startBracketIndex);
       }
     lutNode->SetNamesInitialised(true);
 
@@ -300,7 +370,7 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayAnnot(const std:
     // Set color node as the file name, including extension (.annot)
     std::string lutNodeName = vtksys::SystemTools::GetFilenameName(fullName);
     lutNode->SetName(lutNodeName.c_str());
-    this->Scene->AddNode(lutNode.GetPointer());
+    this->Scene->AddNode(lutNode);
     colorNodeId = lutNode->GetID();
     }
 
@@ -316,33 +386,114 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayAnnot(const std:
 }
 
 //----------------------------------------------------------------------------
-bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayVolume(const std::string& fullName, vtkMRMLModelNode* modelNode)
+int vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayLabels(const std::vector<std::string>& fileNames,
+  vtkMRMLModelNode* modelNode, const std::string& name, std::vector<bool>* loaded)
 {
-  // read the volume
-  vtkNew<vtkITKArchetypeImageSeriesScalarReader> reader;
-  reader->SetArchetype(fullName.c_str());
-  reader->SetOutputScalarTypeToNative();
-  reader->SetDesiredCoordinateOrientationToNative();
-  try
+  if (loaded)
     {
-    reader->Update();
+    loaded->assign(fileNames.size(), false);
     }
-  catch (...)
+  if (modelNode == nullptr ||
+      modelNode->GetPolyData() == nullptr ||
+      modelNode->GetPolyData()->GetPointData() == nullptr)
     {
-    vtkErrorMacro("vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayVolume Cannot read scalar overlay volume file "
-                  << fullName.c_str());
-    return false;
+    vtkErrorMacro("ReadScalarOverlayLabels: the model node doesn't have poly data");
+    return 0;
     }
-  vtkImageData *imageData = reader->GetOutput();
-  if (imageData == nullptr)
+  if (fileNames.empty())
+    {
+    return 0;
+    }
+
+  vtkNew<vtkFSSurfaceMultiLabelReader> reader;
+  for (const std::string& fileName : fileNames)
     {
-    vtkErrorMacro("vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayVolume Unable to get image data out of scalar overlay volume file "
+    reader->AddFileName(fileName.c_str());
+    }
+  reader->SetNumberOfVertices(modelNode->GetPolyData()->GetPointData()->GetNumberOfTuples());
+  vtkNew<vtkUnsignedIntArray> mask;
+  reader->SetOutput(mask);
+  if (reader->ReadLabels() != vtkFSSurfaceMultiLabelReader::FS_ERROR_MULTI_LABEL_NONE)
+    {
+    vtkErrorMacro("ReadScalarOverlayLabels: could not read the labels of " << modelNode->GetName());
+    return 0;
+    }
+
+  int numberOfLabelsRead = 0;
+  for (int fileIndex = 0; fileIndex < reader->GetNumberOfFileNames(); ++fileIndex)
+    {
+    int errorCode = reader->GetErrorCode(fileIndex);
+    if (errorCode != 0)
+      {
+      vtkErrorMacro("Error reading FreeSurfer label file " << fileNames[fileIndex] << " (" << errorCode << ")");
+      continue;
+      }
+    ++numberOfLabelsRead;
+    if (loaded)
+      {
+      (*loaded)[fileIndex] = true;
+      }
+    }
+  if (numberOfLabelsRead == 0)
+    {
+    return 0;
+    }
+
+  std::string maskName = name + " mask";
+  mask->SetName(maskName.c_str());
+  vtkNew<vtkIntArray> firstLabels;
+  firstLabels->SetName(name.c_str());
+  vtkFSSurfaceMultiLabelReader::ComputeFirstLabels(mask, firstLabels);
+
+  // one color per label, the label names are the color names
+  int numberOfLabels = reader->GetNumberOfFileNames();
+  vtkNew<vtkMRMLColorTableNode> lutNode;
+  lutNode->SetTypeToUser();
+  lutNode->SetNumberOfColors(numberOfLabels + 1);
+  lutNode->SetColor(0, "None", 0.5, 0.5, 0.5, 0.0);
+  for (int label = 0; label < numberOfLabels; ++label)
+    {
+    // spread the hues with the golden angle, so neighbouring labels differ
+    double hsv[3] = { std::fmod(label * 0.618033988749895, 1.0), 0.7, 0.9 };
+    double rgb[3];
+    vtkMath::HSVToRGB(hsv, rgb);
+    lutNode->SetColor(label + 1, reader->GetLabelNames()->GetValue(label).c_str(), rgb[0], rgb[1], rgb[2]);
+    }
+  lutNode->SetNamesInitialised(true);
+  lutNode->SetName(name.c_str());
+  this->Scene->AddNode(lutNode);
+
+  MRMLNodeModifyBlocker blocker(modelNode);
+  modelNode->AddPointScalars(mask);
+  modelNode->AddPointScalars(firstLabels);
+  vtkMRMLModelDisplayNode *displayNode = modelNode->GetModelDisplayNode();
+  if (displayNode)
+    {
+    MRMLNodeModifyBlocker displayBlocker(displayNode);
+    displayNode->SetAndObserveColorNodeID(lutNode->GetID());
+    displayNode->SetActiveScalarName(name.c_str());
+    displayNode->SetScalarRange(0, numberOfLabels);
+    displayNode->SetScalarVisibility(1);
+    }
+
+  return numberOfLabelsRead;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayVolume(const std::string& fullName, vtkMRMLModelNode* modelNode)
+{
+  // read the dimensions of the volume
+  vtkNew<vtkFSSurfaceMGHReader> reader;
+  reader->SetFileName(fullName.c_str());
+  if (reader->ReadHeader() != vtkFSSurfaceMGHReader::FS_ERROR_MGH_NONE)
+    {
+    vtkErrorMacro("vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayVolume Cannot read scalar overlay volume file "
                   << fullName.c_str());
     return false;
     }
 
   // only valid if volume w*h*d == num vertices
-  int numPoints = imageData->GetNumberOfPoints();
+  int numPoints = reader->GetNumberOfValues();
   int numVertices = modelNode->GetPolyData()->GetPointData()->GetNumberOfTuples();
   vtkDebugMacro("Testing volume file for scalar overlay, num vertices = " << numVertices << ", image data number of points = " << numPoints );
   if (numPoints != numVertices)
@@ -352,27 +503,35 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayVolume(const std
     return false;
     }
 
-  // transfer the volume values to the float array
+  // decode the first frame straight into the float array
   vtkNew<vtkFloatArray> floatArray;
   std::string scalarName = vtksys::SystemTools::GetFilenameName(fullName);
   floatArray->SetName(scalarName.c_str());
-  floatArray->SetNumberOfValues(numVertices);
-  float minValue = imageData->GetPointData()->GetScalars()->GetTuple1(0);
-  float maxValue = imageData->GetPointData()->GetScalars()->GetTuple1(0);
-  for (int i = 0; i < numVertices; i++)
-    {
-    float pointValue = imageData->GetPointData()->GetScalars()->GetTuple1(i);
-    floatArray->SetValue(i, pointValue);
-    if (pointValue < minValue)
-      {
-      minValue = pointValue;
-      }
-    if (pointValue > maxValue)
-      {
-      maxValue = pointValue;
-      }
+  reader->SetOutput(floatArray.GetPointer());
+  if (reader->ReadFrame(0) != vtkFSSurfaceMGHReader::FS_ERROR_MGH_NONE)
+    {
+    vtkErrorMacro("vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayVolume Cannot read the first frame of scalar overlay volume file "
+                  << fullName.c_str());
+    return false;
     }
-  vtkDebugMacro("ReadData: Setting scalar range, using min value = " << minValue << ", max value = " << maxValue);
+  if (reader->GetNumberOfFrames() > 1)
+    {
+    // the array keeps its reader to switch frames, see
+    // vtkSlicerFreeSurferImporterLogic::SetScalarOverlayFrame
+    vtkDebugMacro("ReadData: keeping the reader of " << reader->GetNumberOfFrames() << " frames");
+    floatArray->GetInformation()->Set(vtkFSSurfaceMGHReader::FRAME_READER(), reader.GetPointer());
+    floatArray->GetInformation()->Set(vtkFSSurfaceMGHReader::FRAME(), 0);
+    // copies of the array share the reader, the array to fill is set for
+    // each frame read
+    reader->SetOutput(nullptr);
+    }
+  else
+    {
+    reader->Close();
+    }
+  double range[2];
+  floatArray->GetRange(range);
+  vtkDebugMacro("ReadData: Setting scalar range, using min value = " << range[0] << ", max value = " << range[1]);
   modelNode->AddPointScalars(floatArray.GetPointer());
 
   vtkMRMLModelDisplayNode *displayNode = modelNode->GetModelDisplayNode();
@@ -382,7 +541,7 @@ bool vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlayVolume(const std
     displayNode->SetAndObserveColorNodeID(colorNodeID);
     displayNode->SetActiveScalarName(scalarName.c_str());
     displayNode->SetScalarVisibility(1);
-    displayNode->SetScalarRange(minValue, maxValue);
+    displayNode->SetScalarRange(range[0], range[1]);
     }
 
   return true;
@@ -416,8 +575,9 @@ int vtkMRMLFreeSurferModelOverlayStorageNode::ReadDataInternal(vtkMRMLNode *refN
 
   vtkDebugMacro("ReadData: reading " << fullName.c_str());
 
-  // compute file prefix
-  std::string extension = vtkMRMLStorageNode::GetLowercaseExtensionFromFileName(fullName);
+  // compute file prefix, compressed files are dispatched on the extension
+  // in front of .gz
+  std::string extension = GetUncompressedLowercaseExtension(fullName);
   vtkDebugMacro("ReadData: extension = " << extension.c_str());
 
   bool success = false;
@@ -453,6 +613,190 @@ int vtkMRMLFreeSurferModelOverlayStorageNode::ReadDataInternal(vtkMRMLNode *refN
   return (success ? 1 : 0);
 }
 
+//----------------------------------------------------------------------------
+int vtkMRMLFreeSurferModelOverlayStorageNode::ReadScalarOverlays(
+  const std::vector<std::string>& fileNames, vtkCollection* modelNodes, std::vector<bool>* loaded)
+{
+  if (loaded)
+    {
+    loaded->assign(fileNames.size(), false);
+    }
+  if (modelNodes == nullptr || this->GetScene() == nullptr)
+    {
+    vtkErrorMacro("ReadScalarOverlays: no models or no scene");
+    return 0;
+    }
+
+  // one overlay file read for the models of one number of vertices
+  struct Overlay
+    {
+    size_t FileIndex = 0;
+    std::string Extension;
+    int NumberOfVertices = 0;
+    bool IsVolume = false;
+    bool IsCached = false;
+    vtkMRMLFreeSurferOverlayCache::Overlay Decoded;
+    /// color node of an annotation, once added to the scene
+    std::string ColorNodeID;
+    };
+  std::vector<Overlay> overlays;
+  std::map<std::pair<size_t, int>, size_t> overlayIndices;
+
+  // overlays to add to each model, in the order of the files
+  std::vector<std::pair<vtkMRMLModelNode*, std::vector<size_t> > > modelOverlays;
+
+  // allocate everything that isn't thread safe to create up front
+  for (int modelIndex = 0; modelIndex < modelNodes->GetNumberOfItems(); ++modelIndex)
+    {
+    vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(modelNodes->GetItemAsObject(modelIndex));
+    if (modelNode == nullptr ||
+        modelNode->GetPolyData() == nullptr ||
+        modelNode->GetPolyData()->GetPointData() == nullptr)
+      {
+      vtkErrorMacro("ReadScalarOverlays: the model node doesn't have poly data yet, skipping it");
+      continue;
+      }
+    int numVertices = modelNode->GetPolyData()->GetPointData()->GetNumberOfTuples();
+    modelOverlays.push_back(std::make_pair(modelNode, std::vector<size_t>()));
+    for (size_t fileIndex = 0; fileIndex < fileNames.size(); ++fileIndex)
+      {
+      std::pair<size_t, int> key(fileIndex, numVertices);
+      std::map<std::pair<size_t, int>, size_t>::iterator found = overlayIndices.find(key);
+      if (found != overlayIndices.end())
+        {
+        // models with the same number of vertices share the arrays
+        modelOverlays.back().second.push_back(found->second);
+        continue;
+        }
+
+      Overlay overlay;
+      overlay.FileIndex = fileIndex;
+      overlay.Extension = GetUncompressedLowercaseExtension(fileNames[fileIndex]);
+      overlay.NumberOfVertices = numVertices;
+      overlay.IsVolume = (overlay.Extension == std::string(".mgz") ||
+                          overlay.Extension == std::string(".mgh"));
+      if (overlay.IsVolume)
+        {
+        // read while adding it, each model gets its own frame reader
+        }
+      else if (this->OverlayCache &&
+               this->OverlayCache->GetOverlay(fileNames[fileIndex], numVertices, overlay.Decoded))
+        {
+        vtkDebugMacro("ReadScalarOverlays: using the cached overlay of " << fileNames[fileIndex]);
+        overlay.IsCached = true;
+        }
+      else if (overlay.Extension == std::string(".annot"))
+        {
+        overlay.Decoded.Scalars = vtkSmartPointer<vtkIntArray>::New();
+        overlay.Decoded.Colors = vtkSmartPointer<vtkLookupTable>::New();
+        overlay.Decoded.AnnotationReader = vtkSmartPointer<vtkFSSurfaceAnnotationReader>::New();
+        }
+      else
+        {
+        overlay.Decoded.Scalars = vtkSmartPointer<vtkFloatArray>::New();
+        }
+      overlayIndices[key] = overlays.size();
+      modelOverlays.back().second.push_back(overlays.size());
+      overlays.push_back(overlay);
+      }
+    }
+
+  // decode all the surface overlay files at once
+  vtkSMPTools::For(0, static_cast<vtkIdType>(overlays.size()), 1,
+    [this, &overlays, &fileNames](vtkIdType begin, vtkIdType end)
+    {
+    for (vtkIdType i = begin; i < end; ++i)
+      {
+      Overlay& overlay = overlays[i];
+      if (overlay.IsVolume || overlay.IsCached)
+        {
+        continue;
+        }
+      const std::string& fullName = fileNames[overlay.FileIndex];
+      vtkMRMLFreeSurferOverlayCache::Overlay& decoded = overlay.Decoded;
+      if (decoded.AnnotationReader)
+        {
+        decoded.ErrorCode = this->DecodeScalarOverlayAnnot(fullName,
+          vtkIntArray::SafeDownCast(decoded.Scalars), decoded.Colors, decoded.AnnotationReader);
+        }
+      else
+        {
+        decoded.ErrorCode = this->DecodeScalarOverlay(fullName, overlay.NumberOfVertices,
+          vtkFloatArray::SafeDownCast(decoded.Scalars));
+        }
+      }
+    });
+
+  if (this->OverlayCache)
+    {
+    for (const Overlay& overlay : overlays)
+      {
+      const int errorCode = overlay.Decoded.ErrorCode;
+      if (!overlay.IsVolume && !overlay.IsCached &&
+          (errorCode == 0 ||
+           (overlay.Decoded.AnnotationReader && (errorCode == 5 || errorCode == 6))))
+        {
+        this->OverlayCache->AddOverlay(fileNames[overlay.FileIndex], overlay.NumberOfVertices, overlay.Decoded);
+        }
+      }
+    }
+
+  int numberOfOverlaysAdded = 0;
+  for (std::pair<vtkMRMLModelNode*, std::vector<size_t> >& modelOverlay : modelOverlays)
+    {
+    vtkMRMLModelNode* modelNode = modelOverlay.first;
+    MRMLNodeModifyBlocker modelBlocker(modelNode);
+    MRMLNodeModifyBlocker displayBlocker(modelNode->GetModelDisplayNode());
+    for (size_t overlayIndex : modelOverlay.second)
+      {
+      Overlay& overlay = overlays[overlayIndex];
+      const std::string& fullName = fileNames[overlay.FileIndex];
+      vtkMRMLFreeSurferOverlayCache::Overlay& decoded = overlay.Decoded;
+      bool success = false;
+      if (overlay.IsVolume)
+        {
+        success = this->ReadScalarOverlayVolume(fullName, modelNode);
+        }
+      else if (decoded.AnnotationReader)
+        {
+        success = this->AddScalarOverlayAnnot(fullName, decoded.ErrorCode,
+          vtkIntArray::SafeDownCast(decoded.Scalars), decoded.Colors, decoded.AnnotationReader,
+          modelNode, overlay.ColorNodeID);
+        }
+      else
+        {
+        success = this->AddScalarOverlay(fullName, decoded.ErrorCode,
+          vtkFloatArray::SafeDownCast(decoded.Scalars), modelNode);
+        }
+      if (!success)
+        {
+        continue;
+        }
+      vtkInfoMacro("Loaded scalar overlay from file: " << fullName
+        << ". Model node: " << modelNode->GetName() << "(" << modelNode->GetID() << ")"
+        << ".");
+      ++numberOfOverlaysAdded;
+      if (loaded)
+        {
+        (*loaded)[overlay.FileIndex] = true;
+        }
+      }
+    }
+  return numberOfOverlaysAdded;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferModelOverlayStorageNode::SetOverlayCache(vtkMRMLFreeSurferOverlayCache* cache)
+{
+  this->OverlayCache = cache;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLFreeSurferOverlayCache* vtkMRMLFreeSurferModelOverlayStorageNode::GetOverlayCache()
+{
+  return this->OverlayCache;
+}
+
 //----------------------------------------------------------------------------
 std::string vtkMRMLFreeSurferModelOverlayStorageNode
 ::GetColorNodeIDFromExtension(const std::string& extension)
@@ -510,16 +854,150 @@ std::string vtkMRMLFreeSurferModelOverlayStorageNode
 
 //----------------------------------------------------------------------------
 bool vtkMRMLFreeSurferModelOverlayStorageNode
-::CanWriteFromReferenceNode(vtkMRMLNode *vtkNotUsed(refNode))
+::CanWriteFromReferenceNode(vtkMRMLNode *refNode)
 {
-  return false;
+  vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(refNode);
+  return modelNode != nullptr && modelNode->GetPolyData() != nullptr &&
+         modelNode->GetPolyData()->GetPointData() != nullptr;
 }
 
 //----------------------------------------------------------------------------
-int vtkMRMLFreeSurferModelOverlayStorageNode::WriteDataInternal(vtkMRMLNode * vtkNotUsed(refNode))
+int vtkMRMLFreeSurferModelOverlayStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
 {
-  vtkErrorMacro("Model Writing not supported for FreeSurfer models. For RemoteIO, please see the CopyData method as a possible workaround.");
-  return 0;
+  vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(refNode);
+  if (modelNode == nullptr || modelNode->GetPolyData() == nullptr)
+    {
+    vtkErrorMacro("WriteData: reference node is not a model with a surface");
+    return 0;
+    }
+  std::string fullName = this->GetFullNameFromFileName();
+  if (fullName.empty())
+    {
+    vtkErrorMacro("WriteData: File name not specified");
+    return 0;
+    }
+
+  std::string extension = GetUncompressedLowercaseExtension(fullName);
+  if (extension == std::string(".mgz") || extension == std::string(".mgh"))
+    {
+    vtkErrorMacro("WriteData: writing MGH overlays is not supported: " << fullName.c_str());
+    return 0;
+    }
+
+  // The overlay is the array named the way it would be read back from the
+  // file, otherwise the array displayed on the model
+  vtkPointData* pointData = modelNode->GetPolyData()->GetPointData();
+  std::string arrayName = this->GetOverlayNameFromFileName(fullName);
+  if (extension == std::string(".annot"))
+    {
+    arrayName = vtksys::SystemTools::GetFilenameName(fullName);
+    }
+  vtkDataArray* array = pointData->GetArray(arrayName.c_str());
+  vtkMRMLModelDisplayNode* displayNode = modelNode->GetModelDisplayNode();
+  if (array == nullptr && displayNode != nullptr && displayNode->GetActiveScalarName() != nullptr)
+    {
+    array = pointData->GetArray(displayNode->GetActiveScalarName());
+    }
+  if (array == nullptr)
+    {
+    array = pointData->GetScalars();
+    }
+  if (array == nullptr || array->GetNumberOfComponents() != 1)
+    {
+    vtkErrorMacro("WriteData: no single component overlay to write to " << fullName.c_str());
+    return 0;
+    }
+
+  vtkIdType numVertices = array->GetNumberOfTuples();
+  vtkFSIO::ReadStatus status;
+  if (extension == std::string(".annot"))
+    {
+    vtkIntArray* labels = vtkIntArray::SafeDownCast(array);
+    vtkMRMLColorTableNode* colorNode = displayNode != nullptr ?
+      vtkMRMLColorTableNode::SafeDownCast(displayNode->GetColorNode()) : nullptr;
+    if (labels == nullptr || colorNode == nullptr || colorNode->GetLookupTable() == nullptr)
+      {
+      vtkErrorMacro("WriteData: an annotation needs integer labels displayed with a color table: " << fullName.c_str());
+      return 0;
+      }
+    // Unnamed colors are the unused entries of a sparse table
+    vtkLookupTable* lut = colorNode->GetLookupTable();
+    int numColors = lut->GetNumberOfTableValues();
+    vtkFSIO::ColorTable colorTable;
+    colorTable.SetNumberOfEntries(numColors);
+    for (int colorIndex = 0; colorIndex < numColors; ++colorIndex)
+      {
+      const char* colorName = colorNode->GetColorName(colorIndex);
+      if (colorName == nullptr || colorName[0] == '\0' ||
+          (colorNode->GetNoName() != nullptr && strcmp(colorName, colorNode->GetNoName()) == 0))
+        {
+        continue;
+        }
+      const double* rgba = lut->GetTableValue(colorIndex);
+      colorTable.SetEntry(colorIndex, colorName, strlen(colorName),
+                          static_cast<int>(rgba[0] * 255.0 + 0.5),
+                          static_cast<int>(rgba[1] * 255.0 + 0.5),
+                          static_cast<int>(rgba[2] * 255.0 + 0.5));
+      }
+    status = vtkFSIO::WriteAnnotationFile(fullName.c_str(), labels->GetPointer(0), numVertices, colorTable);
+    }
+  else if (extension == std::string(".label"))
+    {
+    // Only the vertices inside the label are listed, with their position
+    std::vector<int> indices;
+    std::vector<float> coordinates;
+    vtkPoints* points = modelNode->GetPolyData()->GetPoints();
+    for (vtkIdType vertexIndex = 0; vertexIndex < numVertices; ++vertexIndex)
+      {
+      if (array->GetTuple1(vertexIndex) == LabelOffValue)
+        {
+        continue;
+        }
+      indices.push_back(static_cast<int>(vertexIndex));
+      double point[3] = { 0.0, 0.0, 0.0 };
+      if (points != nullptr && vertexIndex < points->GetNumberOfPoints())
+        {
+        points->GetPoint(vertexIndex, point);
+        }
+      coordinates.insert(coordinates.end(), { static_cast<float>(point[0]),
+        static_cast<float>(point[1]), static_cast<float>(point[2]) });
+      }
+    status = vtkFSIO::WriteLabelFile(fullName.c_str(), indices.data(), coordinates.data(),
+                                     nullptr, indices.size());
+    }
+  else
+    {
+    std::vector<float> values(numVertices);
+    for (vtkIdType vertexIndex = 0; vertexIndex < numVertices; ++vertexIndex)
+      {
+      values[vertexIndex] = static_cast<float>(array->GetTuple1(vertexIndex));
+      }
+    if (extension == std::string(".w"))
+      {
+      std::vector<int> indices(numVertices);
+      for (vtkIdType vertexIndex = 0; vertexIndex < numVertices; ++vertexIndex)
+        {
+        indices[vertexIndex] = static_cast<int>(vertexIndex);
+        }
+      status = vtkFSIO::WriteWFile(fullName.c_str(), indices.data(), values.data(), values.size());
+      }
+    else
+      {
+      status = vtkFSIO::WriteScalarFile(fullName.c_str(), values.data(), values.size(),
+                                        modelNode->GetPolyData()->GetNumberOfCells());
+      }
+    }
+
+  if (!status.IsOk())
+    {
+    vtkErrorMacro("WriteData: error writing FreeSurfer overlay " << fullName.c_str() << ": " << status.Message);
+    return 0;
+    }
+  for (const std::string& warning : status.Warnings)
+    {
+    vtkWarningMacro("WriteData: " << fullName.c_str() << ": " << warning);
+    }
+  return 1;
 }
 
 //----------------------------------------------------------------------------
@@ -590,7 +1068,15 @@ void vtkMRMLFreeSurferModelOverlayStorageNode::InitializeSupportedReadFileTypes(
 //----------------------------------------------------------------------------
 void vtkMRMLFreeSurferModelOverlayStorageNode::InitializeSupportedWriteFileTypes()
 {
-  // Look at WriteData()
-  // Not supporting any writing currently.
+  // Look at WriteDataInternal(). MGH overlays are only read.
   // Created color table files are saved by their own storage node, in Slicer format.
+  this->SupportedWriteFileTypes->InsertNextValue("FreeSurfer W file (.w)");
+  this->SupportedWriteFileTypes->InsertNextValue("FreeSurfer Label (.label)");
+  this->SupportedWriteFileTypes->InsertNextValue("FreeSurfer Thickness (.thickness)");
+  this->SupportedWriteFileTypes->InsertNextValue("FreeSurfer Curvature (.curv)");
+  this->SupportedWriteFileTypes->InsertNextValue("FreeSurfer Avg. Curvature (.avg_curv)");
+  this->SupportedWriteFileTypes->InsertNextValue("FreeSurfer Sulcus (.sulc)");
+  this->SupportedWriteFileTypes->InsertNextValue("FreeSurfer Area (.area)");
+
+  this->SupportedWriteFileTypes->InsertNextValue("FreeSurfer Annotation (.annot)");
 }
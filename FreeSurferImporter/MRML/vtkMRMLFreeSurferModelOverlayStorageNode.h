@@ -18,6 +18,21 @@
 #include "vtkMRMLModelStorageNode.h"
 #include "vtkSlicerFreeSurferImporterModuleMRMLExport.h"
 
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+class vtkCollection;
+class vtkFloatArray;
+class vtkFSSurfaceAnnotationReader;
+class vtkIntArray;
+class vtkLookupTable;
+class vtkMRMLFreeSurferOverlayCache;
+class vtkMRMLModelNode;
+
 /// \brief MRML node for model storage on disk.
 ///
 /// Storage nodes has methods to read/write vtkPolyData to/from disk.
@@ -33,8 +48,7 @@ public:
 
   ///
   /// Copy data from a  referenced node's filename to new location.
-  /// NOTE: use this instead of Write Data in the Remote IO Pipeline
-  /// until FreeSurferModel Writers are available.
+  /// Unlike WriteData, it also copies MGH overlays.
   virtual int CopyData(vtkMRMLNode *refNode, const char *newFileName);
 
   ///
@@ -46,6 +60,37 @@ public:
 
   static std::string GetOverlayNameFromFileName(const std::string& fullName);
 
+  ///
+  /// Read the overlay files \a fileNames into each model of \a modelNodes.
+  /// The files are decoded concurrently, then the arrays are added to each
+  /// model with a single modified event for the model and its display node.
+  /// Models with the same number of vertices share the arrays of a file.
+  /// If \a loaded is set, it tells for each file whether it was added to at
+  /// least one model. Returns the number of overlays added.
+  int ReadScalarOverlays(const std::vector<std::string>& fileNames,
+                         vtkCollection* modelNodes,
+                         std::vector<bool>* loaded = nullptr);
+
+  ///
+  /// Read the label files \a fileNames, such as the labels of a subject's
+  /// label directory, concurrently into a single bitmask array of
+  /// \a modelNode, see vtkFSSurfaceMultiLabelReader, instead of one float
+  /// array per label. Bit i of the "<name> mask" array tells if a vertex is
+  /// in the i-th label. The "<name>" array holds 1 + the first label of each
+  /// vertex, or 0, and is displayed with a color table named \a name whose
+  /// entry i + 1 is named after the i-th label. If \a loaded is set, it
+  /// tells for each file whether it was read. Returns the number of labels
+  /// read.
+  int ReadScalarOverlayLabels(const std::vector<std::string>& fileNames,
+                              vtkMRMLModelNode* modelNode,
+                              const std::string& name,
+                              std::vector<bool>* loaded = nullptr);
+
+  ///
+  /// Cache of decoded overlays used by ReadScalarOverlays, none by default
+  void SetOverlayCache(vtkMRMLFreeSurferOverlayCache* cache);
+  vtkMRMLFreeSurferOverlayCache* GetOverlayCache();
+
 protected:
   vtkMRMLFreeSurferModelOverlayStorageNode();
   ~vtkMRMLFreeSurferModelOverlayStorageNode() override;
@@ -64,14 +109,40 @@ protected:
   int ReadDataInternal(vtkMRMLNode *refNode) override;
 
   ///
-  /// Write data from a  referenced node
-  /// NOTE: Subclasses should implement this method
+  /// Write the overlay of a referenced model in the format of the file
+  /// name extension: w-file, label (the vertices that are not LabelOff),
+  /// annotation with the display color table embedded, or curv format
+  /// for the other scalar extensions. MGH overlays are not written.
   int WriteDataInternal(vtkMRMLNode *refNode) override;
 
   bool ReadScalarOverlay(const std::string& fullName, vtkMRMLModelNode* modelNode);
   bool ReadScalarOverlayAnnot(const std::string& fullName, vtkMRMLModelNode* modelNode);
   bool ReadScalarOverlayVolume(const std::string& fullName, vtkMRMLModelNode* modelNode);
 
+  ///
+  /// Decode an overlay file without accessing the scene or the model, so
+  /// that several files can be decoded at once. Return 0 on success or the
+  /// error code of the reader.
+  int DecodeScalarOverlay(const std::string& fullName, int numVertices,
+                          vtkFloatArray* scalars);
+  int DecodeScalarOverlayAnnot(const std::string& fullName, vtkIntArray* scalars,
+                               vtkLookupTable* colors,
+                               vtkFSSurfaceAnnotationReader* reader);
+
+  ///
+  /// Report the error of a decoded overlay, or add it to the model and
+  /// display it. An annotation adds a color node to the scene if
+  /// \a colorNodeId is empty and sets it to its ID, otherwise it uses it.
+  bool AddScalarOverlay(const std::string& fullName, int errorCode,
+                        vtkFloatArray* scalars, vtkMRMLModelNode* modelNode);
+  bool AddScalarOverlayAnnot(const std::string& fullName, int errorCode,
+                             vtkIntArray* scalars, vtkLookupTable* colors,
+                             vtkFSSurfaceAnnotationReader* reader,
+                             vtkMRMLModelNode* modelNode,
+                             std::string& colorNodeId);
+
+  vtkSmartPointer<vtkMRMLFreeSurferOverlayCache> OverlayCache;
+
   std::string GetColorNodeIDFromExtension(const std::string& extension);
   std::string GetColorNodeIDFromType(int type);
 };
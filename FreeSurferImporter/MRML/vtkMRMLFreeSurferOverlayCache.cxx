@@ -0,0 +1,181 @@
+/*=auto=========================================================================
+
+Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+See COPYRIGHT.txt
+or http://www.slicer.org/copyright/copyright.txt for details.
+
+=========================================================================auto=*/
+
+// FreeSurfer includes
+#include <vtkFSSurfaceAnnotationReader.h>
+
+// MRML includes
+#include "vtkMRMLFreeSurferOverlayCache.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkLookupTable.h>
+#include <vtkObjectFactory.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtksys/SystemTools.hxx>
+
+//------------------------------------------------------------------------------
+vtkStandardNewMacro(vtkMRMLFreeSurferOverlayCache);
+
+//----------------------------------------------------------------------------
+vtkMRMLFreeSurferOverlayCache::vtkMRMLFreeSurferOverlayCache()
+{
+  this->MemoryLimit = 512 * 1024;
+  this->MemorySize = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLFreeSurferOverlayCache::~vtkMRMLFreeSurferOverlayCache() = default;
+
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferOverlayCache::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "NumberOfOverlays: " << this->Entries.size() << "\n";
+  os << indent << "MemoryLimit: " << this->MemoryLimit << "\n";
+  os << indent << "MemorySize: " << this->MemorySize << "\n";
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLFreeSurferOverlayCache::GetFileState(const std::string& fileName,
+  std::string& path, unsigned long& fileSize, long int& fileTime)
+{
+  if (!vtksys::SystemTools::FileExists(fileName, true))
+    {
+    return false;
+    }
+  path = vtksys::SystemTools::GetRealPath(fileName);
+  fileSize = vtksys::SystemTools::FileLength(path);
+  fileTime = vtksys::SystemTools::ModifiedTime(path);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLFreeSurferOverlayCache::IsUnmodified(const Entry& entry)
+{
+  const Overlay& overlay = entry.DecodedOverlay;
+  if (overlay.Scalars == nullptr || overlay.Scalars->GetMTime() != entry.ScalarsTime)
+    {
+    return false;
+    }
+  return overlay.Colors == nullptr || overlay.Colors->GetMTime() == entry.ColorsTime;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLFreeSurferOverlayCache::GetOverlay(const std::string& fileName,
+  int numberOfVertices, Overlay& overlay)
+{
+  std::string path;
+  unsigned long fileSize = 0;
+  long int fileTime = 0;
+  if (!this->GetFileState(fileName, path, fileSize, fileTime))
+    {
+    return false;
+    }
+  for (std::list<Entry>::iterator entry = this->Entries.begin(); entry != this->Entries.end(); ++entry)
+    {
+    if (entry->Path != path || entry->NumberOfVertices != numberOfVertices)
+      {
+      continue;
+      }
+    if (entry->FileSize != fileSize || entry->FileTime != fileTime)
+      {
+      vtkDebugMacro("GetOverlay: " << path << " changed on disk, dropping it");
+      this->MemorySize -= entry->MemorySize;
+      this->Entries.erase(entry);
+      return false;
+      }
+    if (!this->IsUnmodified(*entry))
+      {
+      // the arrays are shared with the models they were added to
+      vtkDebugMacro("GetOverlay: the arrays of " << path << " were modified, dropping them");
+      this->MemorySize -= entry->MemorySize;
+      this->Entries.erase(entry);
+      return false;
+      }
+    // most recently used first
+    this->Entries.splice(this->Entries.begin(), this->Entries, entry);
+    overlay = this->Entries.front().DecodedOverlay;
+    return true;
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferOverlayCache::AddOverlay(const std::string& fileName,
+  int numberOfVertices, const Overlay& overlay)
+{
+  Entry entry;
+  if (overlay.Scalars == nullptr ||
+      !this->GetFileState(fileName, entry.Path, entry.FileSize, entry.FileTime))
+    {
+    return;
+    }
+  entry.NumberOfVertices = numberOfVertices;
+  entry.DecodedOverlay = overlay;
+  entry.ScalarsTime = overlay.Scalars->GetMTime();
+  entry.ColorsTime = overlay.Colors ? overlay.Colors->GetMTime() : 0;
+  entry.MemorySize = static_cast<vtkIdType>(overlay.Scalars->GetActualMemorySize());
+  if (overlay.Colors && overlay.Colors->GetTable())
+    {
+    entry.MemorySize += static_cast<vtkIdType>(overlay.Colors->GetTable()->GetActualMemorySize());
+    }
+
+  // replace an older version of the same overlay
+  for (std::list<Entry>::iterator existing = this->Entries.begin(); existing != this->Entries.end(); ++existing)
+    {
+    if (existing->Path == entry.Path && existing->NumberOfVertices == numberOfVertices)
+      {
+      this->MemorySize -= existing->MemorySize;
+      this->Entries.erase(existing);
+      break;
+      }
+    }
+
+  this->MemorySize += entry.MemorySize;
+  this->Entries.push_front(entry);
+  this->Prune();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferOverlayCache::RemoveAllOverlays()
+{
+  this->Entries.clear();
+  this->MemorySize = 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLFreeSurferOverlayCache::GetNumberOfOverlays()
+{
+  return static_cast<int>(this->Entries.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferOverlayCache::SetMemoryLimit(vtkIdType limit)
+{
+  if (this->MemoryLimit == limit)
+    {
+    return;
+    }
+  this->MemoryLimit = limit;
+  this->Prune();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferOverlayCache::Prune()
+{
+  // the arrays stay valid for the models they were added to
+  while (!this->Entries.empty() && this->MemorySize > this->MemoryLimit)
+    {
+    vtkDebugMacro("Prune: dropping " << this->Entries.back().Path);
+    this->MemorySize -= this->Entries.back().MemorySize;
+    this->Entries.pop_back();
+    }
+}
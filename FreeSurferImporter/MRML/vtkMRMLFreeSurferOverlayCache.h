@@ -0,0 +1,118 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+=========================================================================auto=*/
+
+#ifndef __vtkMRMLFreeSurferOverlayCache_h
+#define __vtkMRMLFreeSurferOverlayCache_h
+
+#include "vtkSlicerFreeSurferImporterModuleMRMLExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <list>
+#include <string>
+
+class vtkDataArray;
+class vtkFSSurfaceAnnotationReader;
+class vtkLookupTable;
+
+/// \brief Decoded FreeSurfer surface overlays.
+///
+/// Keeps the arrays decoded from overlay files so that loading a file into
+/// several models, or loading it again, doesn't decode it again. The models
+/// share the cached arrays. Entries are keyed by the canonical path of the
+/// file and the number of vertices it was read for, and are dropped when
+/// the size or modification time of the file changed, or when the cached
+/// arrays were modified since they were added, for example by a model
+/// editing its scalars in place. The least recently
+/// used entries are dropped once the arrays take more than MemoryLimit.
+class VTK_SLICER_FREESURFERIMPORTER_MODULE_MRML_EXPORT vtkMRMLFreeSurferOverlayCache : public vtkObject
+{
+public:
+  static vtkMRMLFreeSurferOverlayCache *New();
+  vtkTypeMacro(vtkMRMLFreeSurferOverlayCache,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// An overlay as decoded from its file
+  struct Overlay
+  {
+    /// Error code of the reader, annotations can have warnings
+    int ErrorCode = 0;
+    /// vtkFloatArray of the scalars or vtkIntArray of the annotation labels
+    vtkSmartPointer<vtkDataArray> Scalars;
+    /// Colors and color names of an annotation, if it has a color table
+    vtkSmartPointer<vtkLookupTable> Colors;
+    vtkSmartPointer<vtkFSSurfaceAnnotationReader> AnnotationReader;
+  };
+
+  ///
+  /// Get the overlay decoded from \a fileName for a model of
+  /// \a numberOfVertices vertices. Returns false if it isn't cached, or the
+  /// file or the cached arrays changed since.
+  bool GetOverlay(const std::string& fileName, int numberOfVertices, Overlay& overlay);
+
+  ///
+  /// Cache the overlay decoded from \a fileName for a model of
+  /// \a numberOfVertices vertices.
+  void AddOverlay(const std::string& fileName, int numberOfVertices, const Overlay& overlay);
+
+  void RemoveAllOverlays();
+
+  int GetNumberOfOverlays();
+
+  ///
+  /// Memory the cached arrays can use, in kibibytes. 512 MiB by default.
+  vtkGetMacro(MemoryLimit, vtkIdType);
+  void SetMemoryLimit(vtkIdType limit);
+
+  ///
+  /// Memory the cached arrays use, in kibibytes
+  vtkGetMacro(MemorySize, vtkIdType);
+
+protected:
+  vtkMRMLFreeSurferOverlayCache();
+  ~vtkMRMLFreeSurferOverlayCache() override;
+
+  struct Entry
+  {
+    std::string Path;
+    int NumberOfVertices = 0;
+    unsigned long FileSize = 0;
+    long int FileTime = 0;
+    /// Modification times of the arrays when they were added
+    vtkMTimeType ScalarsTime = 0;
+    vtkMTimeType ColorsTime = 0;
+    vtkIdType MemorySize = 0;
+    Overlay DecodedOverlay;
+  };
+
+  /// Get the canonical path, size and modification time of a file.
+  /// Returns false if it doesn't exist.
+  static bool GetFileState(const std::string& fileName, std::string& path,
+                           unsigned long& fileSize, long int& fileTime);
+
+  /// Check that the cached arrays weren't modified since they were added
+  static bool IsUnmodified(const Entry& entry);
+
+  /// Drop the least recently used entries until the limit is respected
+  void Prune();
+
+  /// most recently used first
+  std::list<Entry> Entries;
+  vtkIdType MemoryLimit;
+  vtkIdType MemorySize;
+
+private:
+  vtkMRMLFreeSurferOverlayCache(const vtkMRMLFreeSurferOverlayCache&) = delete;
+  void operator=(const vtkMRMLFreeSurferOverlayCache&) = delete;
+};
+
+#endif
@@ -30,6 +30,8 @@ vtkMRMLNodeNewMacro(vtkMRMLFreeSurferProceduralColorNode);
 vtkMRMLFreeSurferProceduralColorNode::vtkMRMLFreeSurferProceduralColorNode()
 {
   this->LookupTable = nullptr;
+  this->LookupTableBuilt = false;
+  this->UseRampTable = 0;
   this->HideFromEditors = 1;
 }
 
@@ -49,15 +51,18 @@ void vtkMRMLFreeSurferProceduralColorNode::WriteXML(ostream& of, int nIndent)
 
   Superclass::WriteXML(of, nIndent);
 
+  of << " useRampTable=\"" << this->UseRampTable << "\"";
+
   // only print out the look up table if ?
-  if (this->LookupTable != nullptr)
+  vtkFSLookupTable* lookupTable = this->GetFSLookupTable();
+  if (lookupTable != nullptr)
     {
-    of << " numcolors=\"" << this->LookupTable->GetNumberOfColors() << "\"";
+    of << " numcolors=\"" << lookupTable->GetNumberOfColors() << "\"";
     of << " colors=\"";
-    for (int i = 0; i < this->LookupTable->GetNumberOfColors(); i++)
+    for (int i = 0; i < lookupTable->GetNumberOfColors(); i++)
       {
       double rgb[3];
-      this->LookupTable->GetColor(i, rgb);
+      lookupTable->GetColor(i, rgb);
       of <<  i << " '" << this->GetColorNameWithoutSpaces(i, "_") << "' " << rgb[0] << " " << rgb[1] << " " << rgb[2] << " 1.0 ";
       }
     of << "\"";
@@ -77,21 +82,29 @@ void vtkMRMLFreeSurferProceduralColorNode::ReadXMLAttributes(const char** atts)
     {
     attName = *(atts++);
     attValue = *(atts++);
-    if (!strcmp(attName, "numcolors"))
+    if (!strcmp(attName, "useRampTable"))
+      {
+      std::stringstream ss;
+      ss << attValue;
+      int useRampTable = 0;
+      ss >> useRampTable;
+      this->SetUseRampTable(useRampTable);
+      }
+    else if (!strcmp(attName, "numcolors"))
       {
       std::stringstream ss;
       ss << attValue;
       ss >> numColors;
       vtkDebugMacro("Setting the look up table size to " << numColors << "\n");
-      this->LookupTable->SetNumberOfColors(numColors);
+      this->GetFSLookupTable()->SetNumberOfColors(numColors);
       }
     else if (!strcmp(attName, "colors"))
       {
       std::stringstream ss;
       bool errorCondition = false;
-      for (int i = 0; i < this->LookupTable->GetNumberOfColors(); i++)
+      for (int i = 0; i < this->GetFSLookupTable()->GetNumberOfColors(); i++)
         {
-        vtkDebugMacro("Reading colour " << i << " of " << this->LookupTable->GetNumberOfColors() << endl);
+        vtkDebugMacro("Reading colour " << i << " of " << this->GetFSLookupTable()->GetNumberOfColors() << endl);
         ss << attValue;
         // index name r g b a
         int index;
@@ -128,8 +141,11 @@ void vtkMRMLFreeSurferProceduralColorNode::Copy(vtkMRMLNode *anode)
   if (node != nullptr)
     {
     this->SetName(node->Name);
+    // share the table of the other node, built or not
     this->SetLookupTable(node->LookupTable);
     this->SetType(node->Type);
+    this->LookupTableBuilt = node->LookupTableBuilt;
+    this->UseRampTable = node->UseRampTable;
     }
   else
     {
@@ -143,6 +159,8 @@ void vtkMRMLFreeSurferProceduralColorNode::PrintSelf(ostream& os, vtkIndent inde
 
   Superclass::PrintSelf(os,indent);
 
+  os << indent << "LookupTableBuilt: " << this->LookupTableBuilt << "\n";
+  os << indent << "UseRampTable: " << this->UseRampTable << "\n";
   if (this->LookupTable != nullptr)
     {
     os << indent << "Look up table:\n";
@@ -172,6 +190,21 @@ void vtkMRMLFreeSurferProceduralColorNode::UpdateScene(vtkMRMLScene *scene)
   */
 }
 
+//----------------------------------------------------------------------------
+void vtkMRMLFreeSurferProceduralColorNode::SetUseRampTable(int useRampTable)
+{
+  if (this->UseRampTable == useRampTable)
+    {
+    return;
+    }
+  this->UseRampTable = useRampTable;
+  if (this->LookupTable != nullptr)
+    {
+    this->LookupTable->SetUseRampTable(useRampTable);
+    }
+  this->Modified();
+}
+
 //----------------------------------------------------------------------------
 void vtkMRMLFreeSurferProceduralColorNode::SetTypeToHeat()
 {
@@ -268,78 +301,46 @@ void vtkMRMLFreeSurferProceduralColorNode::ProcessMRMLEvents ( vtkObject *caller
 //---------------------------------------------------------------------------
 void vtkMRMLFreeSurferProceduralColorNode::SetType(int type)
 {
-  if (this->GetLookupTable() != nullptr &&
-      this->Type == type)
+  if (this->Type == type)
     {
     vtkDebugMacro("SetType: type is already set to " << type <<  " = " << this->GetTypeAsString());
     return;
     }
 
+    if (type < this->Heat || type > this->Custom)
+      {
+      vtkErrorMacro ("vtkMRMLFreeSurferProceduralColorNode: SetType ERROR, unknown type " << type << endl);
+      return;
+      }
     this->Type = type;
 
     vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting Type to " << type << " = " << this->GetTypeAsString());
 
-    //this->LookupTable->Delete();
-    if (this->GetLookupTable() == nullptr)
-      {
-      vtkDebugMacro("vtkMRMLFreeSurferProceduralColorNode::SetType Creating a new lookup table (was null) of type " << this->GetTypeAsString() << "\n");
-      vtkFSLookupTable * table = vtkFSLookupTable::New();
-      if (table != nullptr)
-        {
-        this->SetLookupTable(table);
-        table->Delete();
-        // as a default, set the table range to 255
-        this->GetFSLookupTable()->SetRange(0, 255);
-        }
-      else
-        {
-        vtkErrorMacro("SetType: Failed to make a new vtkFSLookupTable!");
-        return;
-        }
-      }
-
     if (this->Type == this->Heat)
       {
-      this->GetFSLookupTable()->SetLutTypeToHeat();
-      this->SetNamesFromColors();
       this->SetDescription("The Heat FreeSurfer colour table, shows hot spots with high activation");
       }
     else if (this->Type == this->BlueRed)
       {
-      this->GetFSLookupTable()->SetLutTypeToBlueRed();
-      this->SetNamesFromColors();
       this->SetDescription("A FreeSurfer color scale, 256 colours, from blue to red");
       }
-
     else if (this->Type == this->RedBlue)
       {
-      this->GetFSLookupTable()->SetLutTypeToRedBlue();
-      this->SetNamesFromColors();
       this->SetDescription("A FreeSurfer color scale, 256 colours, from red to blue");
       }
-
     else if (this->Type == this->RedGreen)
       {
-      this->GetFSLookupTable()->SetLutTypeToRedGreen();
-      this->SetNamesFromColors();
       this->SetDescription("A FreeSurfer color scale, 256 colours, from red to green, used to highlight sulcal curvature");
       }
     else if (this->Type == this->GreenRed)
       {
-      this->GetFSLookupTable()->SetLutTypeToGreenRed();
-      this->SetNamesFromColors();
       this->SetDescription("A FreeSurfer color scale, 256 colours, from green to red, used to highlight sulcal curvature");
       }
-    else if (this->Type == this->Labels ||
-             this->Type == this->Custom)
-      {
-      // do nothing
-      }
-    else
-      {
-      vtkErrorMacro ("vtkMRMLFreeSurferProceduralColorNode: SetType ERROR, unknown type " << type << endl);
-      return;
-      }
+
+    // The colours and their names are computed when the table is first
+    // used, so that the default nodes added to each new scene stay cheap.
+    this->LookupTableBuilt = false;
+
     // invoke a modified event
     this->Modified();
 
@@ -347,6 +348,56 @@ void vtkMRMLFreeSurferProceduralColorNode::SetType(int type)
     this->InvokeEvent(vtkMRMLFreeSurferProceduralColorNode::TypeModifiedEvent);
 }
 
+//---------------------------------------------------------------------------
+void vtkMRMLFreeSurferProceduralColorNode::BuildLookupTable()
+{
+  // set first, the names are computed from the table
+  this->LookupTableBuilt = true;
+
+  if (this->LookupTable == nullptr)
+    {
+    vtkDebugMacro("vtkMRMLFreeSurferProceduralColorNode::BuildLookupTable Creating a new lookup table (was null) of type " << this->GetTypeAsString() << "\n");
+    vtkFSLookupTable * table = vtkFSLookupTable::New();
+    if (table == nullptr)
+      {
+      vtkErrorMacro("BuildLookupTable: Failed to make a new vtkFSLookupTable!");
+      return;
+      }
+    this->SetLookupTable(table);
+    table->Delete();
+    // as a default, set the table range to 255
+    this->LookupTable->SetRange(0, 255);
+    }
+  this->LookupTable->SetUseRampTable(this->UseRampTable);
+
+  if (this->Type == this->Heat)
+    {
+    this->LookupTable->SetLutTypeToHeat();
+    }
+  else if (this->Type == this->BlueRed)
+    {
+    this->LookupTable->SetLutTypeToBlueRed();
+    }
+  else if (this->Type == this->RedBlue)
+    {
+    this->LookupTable->SetLutTypeToRedBlue();
+    }
+  else if (this->Type == this->RedGreen)
+    {
+    this->LookupTable->SetLutTypeToRedGreen();
+    }
+  else if (this->Type == this->GreenRed)
+    {
+    this->LookupTable->SetLutTypeToGreenRed();
+    }
+  else
+    {
+    // Labels and Custom: info not held in this node
+    return;
+    }
+  this->SetNamesFromColors();
+}
+
 //---------------------------------------------------------------------------
 bool vtkMRMLFreeSurferProceduralColorNode::SetNameFromColor(int index)
 {
@@ -356,24 +407,29 @@ bool vtkMRMLFreeSurferProceduralColorNode::SetNameFromColor(int index)
 //---------------------------------------------------------------------------
 vtkFSLookupTable *vtkMRMLFreeSurferProceduralColorNode::GetFSLookupTable()
 {
+  if (!this->LookupTableBuilt)
+    {
+    this->BuildLookupTable();
+    }
   return this->LookupTable;
 }
 
 //---------------------------------------------------------------------------
 vtkLookupTable * vtkMRMLFreeSurferProceduralColorNode::GetLookupTable()
 {
-  if (this->LookupTable == nullptr)
+  vtkFSLookupTable* lookupTable = this->GetFSLookupTable();
+  if (lookupTable == nullptr)
     {
     return nullptr;
     }
 
   // otherwise have to cast it
   // return (vtkLookupTable *)(this->LookupTable);
-  if (vtkLookupTable::SafeDownCast(this->LookupTable) == nullptr)
+  if (vtkLookupTable::SafeDownCast(lookupTable) == nullptr)
     {
     vtkErrorMacro("GetLookupTable: error converting fs lookup table to vtk look up table.\n");
     }
-  return vtkLookupTable::SafeDownCast(this->LookupTable);
+  return vtkLookupTable::SafeDownCast(lookupTable);
 }
 
 //---------------------------------------------------------------------------
@@ -22,10 +22,11 @@ class vtkFSLookupTable;
 
 /// \brief MRML node to represent FreeSurfer color information.
 ///
-/// Color nodes describe colour look up tables. The tables are pre-generated by
+/// Color nodes describe colour look up tables. The tables are generated by
 /// this node to provide the default FS look up tables (heat, red/green,
 /// blue/red etc). More than one model or label volume or editor can access the prebuilt
-/// nodes.
+/// nodes. A table and its colour names are only built when the table is
+/// first used, not when the type is set.
 class VTK_SLICER_FREESURFERIMPORTER_MODULE_MRML_EXPORT vtkMRMLFreeSurferProceduralColorNode : public vtkMRMLProceduralColorNode
 {
 public:
@@ -123,6 +124,14 @@ public:
 
   vtkLookupTable* CreateLookupTableCopy() override;
 
+  ///
+  /// Map scalars through a precomputed colour ramp instead of computing the
+  /// colour of each value, faster but approximate, see
+  /// vtkFSLookupTable::UseRampTable. Off by default.
+  vtkGetMacro(UseRampTable, int);
+  void SetUseRampTable(int useRampTable);
+  vtkBooleanMacro(UseRampTable, int);
+
 protected:
   vtkMRMLFreeSurferProceduralColorNode();
   ~vtkMRMLFreeSurferProceduralColorNode() override;
@@ -134,9 +143,17 @@ protected:
   /// table
   bool SetNameFromColor(int index) override;
 
+  ///
+  /// Create the lookup table if needed and set its colours and the colour
+  /// names according to Type
+  void BuildLookupTable();
+
   ///
   /// a lookup table tailored with FreeSurfer colours, constructed according to Type
+  /// on first use
   vtkFSLookupTable *LookupTable;
+  bool LookupTableBuilt;
+  int UseRampTable;
 };
 
 #endif
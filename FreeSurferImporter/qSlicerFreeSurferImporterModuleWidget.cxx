@@ -260,12 +260,22 @@ bool qSlicerFreeSurferImporterModuleWidget::loadSelectedFiles()
   }
 
   QModelIndexList selectedScalarOverlays = d->scalarOverlaySelectorBox->checkedIndexes();
+  std::vector<std::string> scalarOverlayPaths;
   for (QModelIndex selectedScalarOverlay : selectedScalarOverlays)
   {
     QString scalarOverlayName = d->scalarOverlaySelectorBox->itemText(selectedScalarOverlay.row());
-    bool success = logic->LoadFreeSurferScalarOverlay((surfDirectory + scalarOverlayName).toStdString(), modelNodeCollection);
-    if (!success)
+    scalarOverlayPaths.push_back((surfDirectory + scalarOverlayName).toStdString());
+  }
+
+  // decode all the overlays at once
+  std::vector<bool> loadedScalarOverlays;
+  logic->LoadFreeSurferScalarOverlays(scalarOverlayPaths, modelNodeCollection, &loadedScalarOverlays);
+  for (int i = 0; i < selectedScalarOverlays.size(); ++i)
+  {
+    QModelIndex selectedScalarOverlay = selectedScalarOverlays[i];
+    if (!loadedScalarOverlays[i])
     {
+      QString scalarOverlayName = d->scalarOverlaySelectorBox->itemText(selectedScalarOverlay.row());
       d->updateStatus(true, "Could not load scalar overlay " + scalarOverlayName + "!");
       continue;
     }
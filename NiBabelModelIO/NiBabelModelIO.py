@@ -142,24 +142,29 @@ class NiBabelModelIOLogic(ScriptedLoadableModuleLogic):
     def onReadDataRequested(self, storageNode, event, modelNode):
         self.readData(storageNode, modelNode)
     
-    def createAndReadModelNode(self, filepath, baseName="", calculateNormals=True):
+    def createAndReadModelNode(self, filepath, baseName="", calculateNormals=True, assumeConsistentOrientation=False):
         """
         Reads the FreeSurfer surface data, and adds it to a new model node.
+        See readModelNode for the options.
         """
         if len(baseName) == 0:
             nameAndExtension = os.path.splitext(os.path.basename(filepath))
             baseName = f"{nameAndExtension[0]}_{nameAndExtension[1][1:]}"
         baseName = slicer.mrmlScene.GenerateUniqueName(baseName)
         modelNode = slicer.mrmlScene.AddNewNodeByClass("vtkMRMLModelNode", baseName)
-        success = self.readModelNode(filepath, modelNode, calculateNormals)
+        success = self.readModelNode(filepath, modelNode, calculateNormals, assumeConsistentOrientation)
         if not success:
             slicer.mrmlScene.RemoveNode(modelNode)
             return None
         return modelNode
     
-    def readModelNode(self, path, modelNode, calculateNormals=True):
+    def readModelNode(self, path, modelNode, calculateNormals=True, assumeConsistentOrientation=False):
         """
         Reads the FreeSurfer surface into the model node.
+        If assumeConsistentOrientation is set, the faces are trusted to be oriented
+        the way FreeSurfer writes them: they are reversed if the scanner transform
+        mirrors the surface, and the normals are computed without the slower
+        consistency and auto orientation passes.
         """
         import nibabel as nb
 
@@ -168,7 +173,13 @@ class NiBabelModelIOLogic(ScriptedLoadableModuleLogic):
 
             geom = VolGeom.from_surf_footer(metadata)
 
-            points = nb.affines.apply_affine(geom.tkreg2scanner(), points).astype('f4')
+            tkreg2scanner = geom.tkreg2scanner()
+            points = nb.affines.apply_affine(tkreg2scanner, points).astype('f4')
+
+            # FreeSurfer surfaces are consistently oriented. If the transform mirrors
+            # the surface, reverse the faces to keep the normals pointing outward.
+            if assumeConsistentOrientation and np.linalg.det(tkreg2scanner[:3, :3]) < 0:
+                polys = polys[:, ::-1]
         
             polyData = vtk.vtkPolyData()
             pointsVTK = vtk.vtkPoints()
@@ -187,8 +198,13 @@ class NiBabelModelIOLogic(ScriptedLoadableModuleLogic):
                 normals.SetInputData(polyData)
                 normals.ComputePointNormalsOn()
                 normals.SplittingOff()
-                normals.ConsistencyOn()
-                normals.AutoOrientNormalsOn()
+                if assumeConsistentOrientation:
+                    # Faces are already consistently oriented, skip the expensive passes
+                    normals.ConsistencyOff()
+                    normals.AutoOrientNormalsOff()
+                else:
+                    normals.ConsistencyOn()
+                    normals.AutoOrientNormalsOn()
                 normals.Update()
                 polyData = normals.GetOutput()
 